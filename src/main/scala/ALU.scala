@@ -5,7 +5,7 @@ import chisel3.util._
 import org.chipsalliance.cde.config.Parameters
 import freechips.rocketchip.tile.CoreModule
 import freechips.rocketchip.rocket.{ALUFN, MulDivParams, MulDiv}
-import vcoderocc.DataIO
+import vcoderocc.constants._
 
 /** Externally-visible properties of the ALU.
   */
@@ -48,22 +48,117 @@ object ALU {
   def FN_RED_AND = BitPat(31.U(SZ_ALU_FN.W))
   def FN_RED_OR = BitPat(32.U(SZ_ALU_FN.W))
   def FN_RED_XOR = BitPat(33.U(SZ_ALU_FN.W))
+  // 34 is taken by PermuteUnit.FN_PERMUTE
+  def FN_INDEX = BitPat(35.U(SZ_ALU_FN.W))
+  def FN_DIST = BitPat(36.U(SZ_ALU_FN.W))
+  /* Copies never enter the ALU. Fetched data is written straight back out by
+   * VCodeAccelImp, so these have no case in the ALU's switch. */
+  def FN_COPY = BitPat(37.U(SZ_ALU_FN.W))
+  def FN_COPY_STRIDED = BitPat(38.U(SZ_ALU_FN.W))
+  def FN_LESS_SIGNED = BitPat(39.U(SZ_ALU_FN.W))
+  def FN_LESS_EQUAL_SIGNED = BitPat(40.U(SZ_ALU_FN.W))
+  def FN_GREATER_SIGNED = BitPat(41.U(SZ_ALU_FN.W))
+  def FN_GREATER_EQUAL_SIGNED = BitPat(42.U(SZ_ALU_FN.W))
+  def FN_MIN = BitPat(43.U(SZ_ALU_FN.W))
+  def FN_MAX = BitPat(44.U(SZ_ALU_FN.W))
+  def FN_MIN_UNSIGNED = BitPat(45.U(SZ_ALU_FN.W))
+  def FN_MAX_UNSIGNED = BitPat(46.U(SZ_ALU_FN.W))
+  def FN_ARSHIFT = BitPat(47.U(SZ_ALU_FN.W))
+  // 48-63 are taken by the FloatUnit
+  def FN_DOT = BitPat(64.U(SZ_ALU_FN.W))
+  // 65 is taken by FloatUnit.FN_FDOT
+  def FN_POPCOUNT = BitPat(66.U(SZ_ALU_FN.W))
+  def FN_CLZ = BitPat(67.U(SZ_ALU_FN.W))
+  def FN_CTZ = BitPat(68.U(SZ_ALU_FN.W))
+  def FN_BIT_REVERSE = BitPat(69.U(SZ_ALU_FN.W))
+  def FN_RED_POPCOUNT = BitPat(70.U(SZ_ALU_FN.W))
+  // 71-72 are taken by PermuteUnit, 73-74 by SortUnit
+  def FN_RAND = BitPat(75.U(SZ_ALU_FN.W))
+  def FN_EXTRACT = BitPat(76.U(SZ_ALU_FN.W))
+  def FN_REPLACE = BitPat(77.U(SZ_ALU_FN.W))
+  def FN_READ_ACCUMULATOR = BitPat(78.U(SZ_ALU_FN.W))
+  // 79 is taken by PerfCounters, 80 by TraceBuffer
+
+  /** Is this function a copy, which skips the execution stage entirely? */
+  def isCopy(fn: UInt): Bool = fn === FN_COPY || fn === FN_COPY_STRIDED
+
+  /** Does this function take long enough that batches should be spread over
+    * several ALU clusters? Only element-wise operations without any state
+    * carried between batches qualify. */
+  def isClusterable(fn: UInt): Bool = fn === FN_MUL || fn === FN_DIV || fn === FN_MOD
+
+  /** Can this function work on words packed with 8, 16, or 32-bit elements?
+    * Every other function on vectors is decoded as illegal while a narrower
+    * element width is configured. */
+  def supportsSubword(fn: UInt): Bool =
+    fn === FN_ADD || fn === FN_SUB || fn === FN_NOT || fn === FN_AND ||
+    fn === FN_OR || fn === FN_XOR || fn === FN_DIST || fn === FN_COPY
+
+  /** Number of accumulators integer reductions can be kept in. */
+  val NUM_ACCUMULATORS = 4
+  /** Width of an accumulator selection: the accumulator's number plus 1, or
+    * 0 for none. */
+  val SZ_ACCUMULATOR = log2Ceil(NUM_ACCUMULATORS + 1)
+}
+
+/** How an operation's boolean vectors are laid out in memory. */
+object BoolPacking {
+  /** The size of the bit pattern for boolean packing. */
+  val SZ_BOOL_PACKING = 2.W
+  /** Unknown packing. Intended for accelerator control instructions. */
+  def BOOL_X = BitPat("b??")
+  /** Every element, boolean or not, takes a whole 64-bit word. */
+  def BOOL_UNPACKED = BitPat("b00")
+  /** Elements are read as 64-bit words, but boolean results are packed 1 bit
+    * per element. */
+  def BOOL_PACK_RESULT = BitPat("b01")
+  /** Operands and results are all packed booleans. Each fetched word holds 64
+    * flags, so the operation runs over ceil(numOperands / 64) words. */
+  def BOOL_PACKED = BitPat("b10")
 }
 
 /** Implementation of an ALU.
-  * @param p Implicit parameter passed by the build system.
+  * @param compareStages Number of pipeline stages in each comparator.
+  * @param numAccumulators Number of accumulators reductions can be kept in
+  * between instructions.
   */
-class ALU(val xLen: Int)(val batchSize: Int) extends Module {
+class ALU(val xLen: Int)(val batchSize: Int, val compareStages: Int = 1,
+  val numAccumulators: Int = ALU.NUM_ACCUMULATORS) extends Module {
   import ALU._ // Import ALU object, so we do not have to fully-qualify names
+  // Words of SELECT flags or packed comparison results one batch needs.
+  val flagWords = math.max(1, batchSize / xLen)
   val io = IO(new Bundle {
     val fn = Input(Bits(SZ_ALU_FN.W))
     // The two register content values passed over the RoCCCommand are xLen wide
-    val in1 = Input(Vec(batchSize, new DataIO(xLen)))
-    val in2 = Input(Vec(batchSize, new DataIO(xLen)))
-    val in3 = Input(new DataIO(xLen))
+    val in1 = Input(Vec(batchSize, UInt(xLen.W)))
+    val in2 = Input(Vec(batchSize, UInt(xLen.W)))
+    /** SELECT's flags, 1 per lane. Batches of xLen or more elements get
+      * batchSize flags, smaller ones a whole word shared by several batches. */
+    val in3 = Input(UInt((flagWords * xLen).W))
+    /** Lanes of in1 & in2 holding elements of the vector this round. */
+    val mask = Input(UInt(batchSize.W))
+    /** The last lane of in1 holds the last word of a packed boolean vector,
+      * and only these bits of it are flags of the vector. */
+    val lastWordMask = Input(Valid(UInt(xLen.W)))
+    /* Register contents of the RoCC command. Used by operations that take
+     * scalar arguments rather than vectors, like INDEX and DIST. */
+    val rs1 = Input(Bits(xLen.W))
+    val rs2 = Input(Bits(xLen.W))
     val identityVal = Input(Bits(xLen.W))
-    val out = Output(Valid(Vec(batchSize, new DataIO(xLen))))
-    val baseAddress = Input(UInt(xLen.W))
+    /** Width of the elements packed in each lane, as a MemorySizeConstants
+      * MTxx encoding. */
+    val elementWidth = Input(UInt(3.W))
+    /** Pack comparison results 1 bit per element instead of 1 word each. */
+    val packResult = Input(Bool())
+    /** Accumulator that reductions start from & are kept in, plus 1. 0 means
+      * reductions start from their identity as normal. */
+    val accumulator = Input(UInt(log2Ceil(numAccumulators + 1).W))
+    /** Set accumulator rs1 to the value in rs2. */
+    val clearAccumulator = Input(Bool())
+    /** Value of accumulator rs1, for READ_ACCUMULATOR. */
+    val accumulatorOut = Output(UInt(xLen.W))
+    /** Result of the batch. Where it goes is up to the control unit. */
+    val out = Output(Valid(Vec(batchSize, UInt(xLen.W))))
     val execute = Input(Bool())
     val accelIdle = Input(Bool())
   })
@@ -79,15 +174,20 @@ class ALU(val xLen: Int)(val batchSize: Int) extends Module {
    * which is pretty much exactly what we want. */
   /* FIXME: Explode the bools, then dynamically slice the resulting vector. */
   val selectFlags = WireInit(VecInit(Seq.fill(batchSize)(false.B)))
-  for (i <- 0 until batchSize) {
-    selectFlags(i) := io.in3.data(i.U + selectFlagsCounter)
+  if (batchSize >= xLen) {
+    // Every batch has flag words of its own.
+    selectFlags := io.in3.asBools
+  } else {
+    for (i <- 0 until batchSize) {
+      selectFlags(i) := io.in3(i.U + selectFlagsCounter)
+    }
   }
 
   /* XXX: If we allow a pipelined divider to exit early, then workingSpace
-   * should have type Vec(Valid(DataIO)). Then io.out.valid will need to be an
+   * should have type Vec(Valid(UInt)). Then io.out.valid will need to be an
    * andR across all elements's valid flag in workingSpace. */
   val workingSpace = withReset(io.accelIdle) {
-    RegInit((0.U).asTypeOf(Vec(batchSize, new DataIO(xLen))))
+    RegInit(VecInit(Seq.fill(batchSize)(0.U(xLen.W))))
   }
   io.out.bits := workingSpace
   io.out.valid := false.B
@@ -123,8 +223,8 @@ class ALU(val xLen: Int)(val batchSize: Int) extends Module {
     muldiv.io.req.bits.fn := ALUFN().FN_MUL
     // All VCODE operations are double-word (64-bit)
     muldiv.io.req.bits.dw := true.B
-    muldiv.io.req.bits.in1 := io.in1(i).data
-    muldiv.io.req.bits.in2 := io.in2(i).data
+    muldiv.io.req.bits.in1 := io.in1(i)
+    muldiv.io.req.bits.in2 := io.in2(i)
     /* We don't use the tag bits for anything here. */
     muldiv.io.req.bits.tag := 0.U
     /* Multiplier inputs are valid when the ALU should start executing. */
@@ -141,58 +241,180 @@ class ALU(val xLen: Int)(val batchSize: Int) extends Module {
 
   val compareBank = for (i <- 0 until batchSize) yield {
     // val comparator = Module(new Comparator[SInt](xLen))
-    val comparator = Module(new Comparator(xLen))
+    val comparator = Module(new Comparator(xLen, compareStages))
     comparator.io.req.valid := pipelineStart
     comparator.io.req.bits.fn  := DontCare
+    // Everything but the explicitly unsigned operations compares signed values.
+    comparator.io.req.bits.unsigned := false.B
     comparator.io.req.bits.in1 := DontCare
     comparator.io.req.bits.in2 := DontCare
     /* NOTE: comparator MUST BE RETURNED from this for-yield's lambda! */
     comparator
   }
 
+  /* Scans & reductions through the banks chain lane to lane, so they take
+   * time in proportion to the number of lanes. The chain ends at the last
+   * lane holding an element, so short vectors finish sooner and the empty
+   * lanes past the end of the vector are never folded into the result. */
+  val lastLane = PopCount(io.mask) - 1.U
+  /** Start lane i of a chain when lane i-1 finishes, unless it is empty. */
+  def chainValid(i: Int, prevValid: Bool): Bool = prevValid && (i - 1).U < lastLane
+  /** The result of the chain, at its last lane. */
+  def chainEnd[T <: Data](lanes: Seq[T]): T = VecInit(lanes)(lastLane)
+  val muldivChainValid = chainEnd(muldivBank.map(_.io.resp.valid))
+  val muldivChainData = chainEnd(muldivBank.map(_.io.resp.bits.data))
+  val compareChainValid = chainEnd(compareBank.map(_.io.resp.valid))
+  val compareChainData = chainEnd(compareBank.map(_.io.resp.bits.data))
+
+  /* Accumulators hold the running value of reductions across instructions,
+   * so like the RAND state they are not reset when the accelerator is idle. */
+  require(isPow2(numAccumulators) && numAccumulators > 1,
+    "ALU must have a power of 2 number of accumulators!")
+  val accumulators = RegInit(VecInit(Seq.fill(numAccumulators)(0.U(xLen.W))))
+  val accumulating = io.accumulator =/= 0.U
+  val accumulatorIndex = io.accumulator - 1.U
+  // Accumulator numbers past the last one read as 0, and cannot be cleared.
+  val accumulatorInRange = io.rs1 < numAccumulators.U
+  io.accumulatorOut := Mux(accumulatorInRange,
+    accumulators(io.rs1(log2Ceil(numAccumulators) - 1, 0)), 0.U)
+  when(io.clearAccumulator && accumulatorInRange) {
+    accumulators(io.rs1(log2Ceil(numAccumulators) - 1, 0)) := io.rs2
+  }
+
+  /* With an accumulator selected, reductions & scans carry on from the
+   * accumulator's value rather than starting again from the identity. */
   val identity = withReset(io.accelIdle) {
-    RegInit(io.identityVal)
+    RegInit(Mux(accumulating, accumulators(accumulatorIndex), io.identityVal))
+  }
+  /* identity only moves away from its starting value by being reduced into,
+   * so the accumulator can just follow it for the whole instruction. */
+  when(accumulating && !io.accelIdle) {
+    accumulators(accumulatorIndex) := identity
+  }
+
+  /* Value of the first lane of the next batch made by the INDEX generator.
+   * Starts at the start value passed in rs1 and moves forward by a whole
+   * batch worth of strides every round. */
+  val indexNext = withReset(io.accelIdle) {
+    RegInit(io.rs1)
+  }
+
+  /* Every lane has its own xorshift64 generator for RAND. The generator state
+   * is NOT reset when the accelerator goes idle, so consecutive RANDs continue
+   * the same sequences. Each lane starts from a different non-zero state. */
+  val golden = BigInt("9E3779B97F4A7C15", 16)
+  def laneSeed(i: Int): BigInt = (golden * (i + 1)) & ((BigInt(1) << xLen) - 1)
+  val randState = RegInit(VecInit((0 until batchSize).map(i => laneSeed(i).U(xLen.W))))
+  /* Goes high once RAND has taken its seed, so only the first batch reseeds. */
+  val randSeeded = withReset(io.accelIdle) {
+    RegInit(false.B)
   }
 
-  /** Perform a paired element-wise binary operation to two `DataIO` vectors.
+  /** One step of Marsaglia's xorshift64 generator. */
+  def xorshift(x: UInt): UInt = {
+    val a = x ^ (x << 13)(xLen - 1, 0)
+    val b = a ^ (a >> 7)
+    b ^ (b << 17)(xLen - 1, 0)
+  }
+
+  /* Packed comparison results are gathered here, batchSize bits at a time,
+   * until a whole word has been built and can be written back. The layout
+   * matches how SELECT reads its flags, element i of a word is bit i. */
+  val packedOffset = withReset(io.accelIdle) {
+    RegInit(0.U(log2Ceil(xLen).W))
+  }
+  val packedWord = withReset(io.accelIdle) {
+    RegInit(0.U(xLen.W))
+  }
+
+  /* Mask of the most significant bit of every sub-word element in a lane.
+   * Used to keep carries and borrows from crossing between elements (SWAR).
+   * With 64-bit elements this is just the sign bit, and the SWAR add/sub
+   * below reduce to normal addition/subtraction. */
+  def highBits(width: Int): UInt =
+    (0 until xLen by width).map(i => BigInt(1) << (i + width - 1)).sum.U(xLen.W)
+  val subwordHighBits = MuxLookup(io.elementWidth, highBits(64))(Seq(
+    MT8.value.U -> highBits(8),
+    MT16.value.U -> highBits(16),
+    MT32.value.U -> highBits(32)))
+
+  /** Add every sub-word element of x to the matching one of y. */
+  def subwordAdd(x: UInt, y: UInt): UInt = {
+    val h = subwordHighBits
+    ((x & ~h) + (y & ~h)) ^ ((x ^ y) & h)
+  }
+
+  /** Subtract every sub-word element of y from the matching one of x. */
+  def subwordSub(x: UInt, y: UInt): UInt = {
+    val h = subwordHighBits
+    ((x | h) - (y & ~h)) ^ ((x ^ ~y) & h)
+  }
+
+  /** Number of zero bits below the lowest set bit of x. A zero x has xLen. */
+  def countTrailingZeros(x: UInt): UInt =
+    Mux(x === 0.U, xLen.U, PriorityEncoder(x))
+
+  /** Perform a paired element-wise binary operation to two vectors.
+    * The addresses the results go to are generated when they are written.
     */
-  def elementWiseMap(xs: Vec[DataIO], ys: Vec[DataIO],
-                     op: (UInt, UInt) => UInt): Vec[DataIO] = {
-    val indexedPairs = xs.zip(ys).zipWithIndex
-    val results = WireInit((0.U).asTypeOf(Vec(batchSize, new DataIO(xLen))))
-    /* The address calculation should be a completely parallel indexed map.
-     * (i) = thisBatchBaseAddr + (i * 8), where thisBatchBaseAddr comes from
-     * some part of the control unit to control where this batch should
-     * output */
-    results := indexedPairs.map{ case ((x, y), i) => {
-      val result = Wire(new DataIO(xLen))
-      result.addr := io.baseAddress + (i.U * 8.U)
-      result.data := op(x.data, y.data)
-      result
+  def elementWiseMap(xs: Vec[UInt], ys: Vec[UInt],
+                     op: (UInt, UInt) => UInt): Vec[UInt] =
+    VecInit(xs.zip(ys).map{ case (x, y) => op(x, y) })
+
+  /** Perform a paired element-wise operation through the comparator bank.
+    * The result is valid once every comparator in the bank has responded.
+    */
+  def compareBankMap(fn: ComparatorOp.Type, unsigned: Bool): Unit = {
+    for (i <- 0 until batchSize) {
+      compareBank(i).io.req.bits.fn := fn
+      compareBank(i).io.req.bits.unsigned := unsigned
+      compareBank(i).io.req.bits.in1 := io.in1(i).asSInt
+      compareBank(i).io.req.bits.in2 := io.in2(i).asSInt
+      workingSpace(i) := compareBank(i).io.resp.bits.data.asUInt
+    }
+    io.out.valid := VecInit(compareBank.map { _.io.resp.valid }).reduce(_ & _)
+  }
+
+  /** Perform an element-wise comparison of two vectors through the comparator
+    * bank. Each result is either written as its own 0/1 word, or packed into
+    * the next batchSize bits of the word being built in packedWord.
+    */
+  def comparison(fn: ComparatorOp.Type, unsigned: Bool): Unit = {
+    compareBankMap(fn, unsigned)
+    when(io.packResult) {
+      val flags = VecInit(compareBank.map(_.io.resp.bits.data(0))).asUInt
+      if (batchSize >= xLen) {
+        // A batch fills whole words of flags, which go out in the first lanes.
+        for (k <- 0 until flagWords) {
+          workingSpace(k) := flags(xLen * (k + 1) - 1, xLen * k)
+        }
+      } else {
+        // Only take the flags once, when the bank responds.
+        when(io.out.valid) {
+          // A word that just started must not keep the flags of the previous word.
+          val word = Mux(packedOffset === 0.U, 0.U, packedWord) | (flags << packedOffset)
+          packedWord := word
+          // Wraps back to 0 once the word is full.
+          packedOffset := packedOffset + batchSize.U
+          lastBatchResult := word
+        }
       }
     }
-    results
   }
 
   /** Perform a reduction on a vector.
    *
    * TODO: This function is well-suited to pipelining between elements in the
    * batch! */
-  def reduction(xs: Vec[DataIO], op: (UInt, UInt) => UInt): DataIO = {
-    val xsData = xs.map(_.data)
+  def reduction(xs: Seq[UInt], op: (UInt, UInt) => UInt): UInt =
     // NOTE: .reduce could be replaced by reduceTree
-    val result = op(identity, xsData.reduce(op))
-    val retData = Wire(new DataIO(xLen))
-    retData.addr := io.baseAddress
-    retData.data := result
-    retData
-  }
+    op(identity, xs.reduce(op))
 
   when(io.execute) {
     switch(io.fn) {
       is(0.U) {
         // ADD
-        workingSpace := elementWiseMap(io.in1, io.in2, _ + _)
+        workingSpace := elementWiseMap(io.in1, io.in2, subwordAdd)
         // Addition/Subtraction only take 1 clock cycle to complete.
         // Or at least the + operator is not too terrible in synthesis.
         io.out.valid := true.B
@@ -201,102 +423,66 @@ class ALU(val xLen: Int)(val batchSize: Int) extends Module {
         // +_REDUCE INT
         val result = reduction(io.in1, _ + _)
         lastBatchResult := result
-        identity := result.data
+        identity := result
         io.out.valid := true.B
       }
       is(2.U) { // +_SCAN INT
-        val batchData = io.in1.map{ case d => d.data }
-        val scanTmp = batchData.scan(identity)(_ + _)
         // NOTE .scan has .scanLeft & .scanRight variants
         /* NOTE: Technically we compute an extra index for the element
          * we pull out. */
-        val scanResults = scanTmp.zipWithIndex.map{ case (d, idx) => {
-          val result = Wire(new DataIO(xLen))
-          result.addr := io.baseAddress + (idx.U * 8.U)
-          result.data := d
-          result
-          }
-        }
+        val scanResults = io.in1.scan(identity)(_ + _)
         // .slice(from, to) is [from, to). to is EXCLUSIVE
         workingSpace := scanResults.slice(0, batchSize)
         // Grab the last bit, the end of the vector.
-        identity := scanResults(batchSize).data
+        identity := scanResults(batchSize)
         io.out.valid := true.B
       }
       is(3.U){
         // SUB
-        workingSpace := elementWiseMap(io.in1, io.in2, _ - _)
+        workingSpace := elementWiseMap(io.in1, io.in2, subwordSub)
         io.out.valid := true.B
       }
       is(4.U){
         // MUL
-        val indexedPairs = io.in1.zip(io.in2).zipWithIndex
-        workingSpace := indexedPairs.map{ case ((x, y), i) => {
-          val muldivBankReady = VecInit(muldivBank.map { _.io.req.ready }).reduce(_ & _)
-          muldivBank(i).io.req.bits.fn := ALUFN().FN_MUL
-          val result = Wire(new DataIO(xLen))
-          result.addr := io.baseAddress + (i.U * 8.U)
-          result.data := muldivBank(i).io.resp.bits.data
-          result
-          }
-        }
+        muldivBank.foreach { _.io.req.bits.fn := ALUFN().FN_MUL }
+        workingSpace := muldivBank.map { _.io.resp.bits.data }
         io.out.valid := VecInit(muldivBank.map { _.io.resp.valid }).reduce(_ & _)
       }
       is(7.U){
         // DIV
-        val indexedPairs = io.in1.zip(io.in2).zipWithIndex
-        workingSpace := indexedPairs.map{ case ((x, y), i) => {
-          muldivBank(i).io.req.bits.fn := ALUFN().FN_DIV
-          val result = Wire(new DataIO(xLen))
-          result.addr := io.baseAddress + (i.U * 8.U)
-          result.data := muldivBank(i).io.resp.bits.data
-          result
-          }
-        }
+        muldivBank.foreach { _.io.req.bits.fn := ALUFN().FN_DIV }
+        workingSpace := muldivBank.map { _.io.resp.bits.data }
         io.out.valid := VecInit(muldivBank.map { _.io.resp.valid }).reduce(_ & _)
       }
       is(8.U){
         // MOD
-        val indexedPairs = io.in1.zip(io.in2).zipWithIndex
-        workingSpace := indexedPairs.map{ case ((x, y), i) => {
-          muldivBank(i).io.req.bits.fn := ALUFN().FN_REM
-          val result = Wire(new DataIO(xLen))
-          result.addr := io.baseAddress + (i.U * 8.U)
-          result.data := muldivBank(i).io.resp.bits.data
-          result
-          }
-        }
+        muldivBank.foreach { _.io.req.bits.fn := ALUFN().FN_REM }
+        workingSpace := muldivBank.map { _.io.resp.bits.data }
         io.out.valid := VecInit(muldivBank.map { _.io.resp.valid }).reduce(_ & _)
       }
       is(9.U){
-        // LESS
-        workingSpace := elementWiseMap(io.in1, io.in2, _ < _)
-        io.out.valid := true.B
+        // LESS (unsigned)
+        comparison(ComparatorOp.lt, true.B)
       }
       is(10.U){
-        // LESS OR EQUAL
-        workingSpace := elementWiseMap(io.in1, io.in2, _ <= _)
-        io.out.valid := true.B
+        // LESS OR EQUAL (unsigned)
+        comparison(ComparatorOp.le, true.B)
       }
       is(11.U){
-        // GREATER
-        workingSpace := elementWiseMap(io.in1, io.in2, _ > _)
-        io.out.valid := true.B
+        // GREATER (unsigned)
+        comparison(ComparatorOp.gt, true.B)
       }
       is(12.U){
-        // GREATER OR EQUAL
-        workingSpace := elementWiseMap(io.in1, io.in2, _ >= _)
-        io.out.valid := true.B
+        // GREATER OR EQUAL (unsigned)
+        comparison(ComparatorOp.ge, true.B)
       }
       is(13.U){
         // EQUAL
-        workingSpace := elementWiseMap(io.in1, io.in2, _ === _)
-        io.out.valid := true.B
+        comparison(ComparatorOp.eq, true.B)
       }
       is(14.U){
         // UNEQUAL
-        workingSpace := elementWiseMap(io.in1, io.in2, _ =/= _)
-        io.out.valid := true.B
+        comparison(ComparatorOp.ne, true.B)
       }
       is(15.U){
         // LEFT SHIFT
@@ -331,138 +517,97 @@ class ALU(val xLen: Int)(val batchSize: Int) extends Module {
       is(21.U){
         // SELECT
         val selectData = selectFlags.lazyZip(io.in1).lazyZip(io.in2).toVector
-        workingSpace := selectData.zipWithIndex.map{ case((s, t, f), i) => {
-          val result = Wire(new DataIO(xLen))
-          result.addr := io.baseAddress + (i.U * 8.U)
-          result.data := Mux(s, t.data, f.data)
-          result
-          }
-        }
+        workingSpace := selectData.map{ case (s, t, f) => Mux(s, t, f) }
         selectFlagsCounter := selectFlagsCounter + batchSize.U;
         io.out.valid := true.B
       }
       is(22.U){
         // *_SCAN INT
-        val batchData = io.in1.map{ case d => d.data }
-        /* First, hook up working space addresses, because those are easy. */
-        for (i <- 0 until batchSize) {
-          workingSpace(i).addr := io.baseAddress + (i.U * 8.U)
-        }
-
-        /* Now wire the muldiv bank up to perform the scan. */
+        val batchData = io.in1
+        /* Wire the muldiv bank up to perform the scan. */
         muldivBank(0).io.req.bits.in1 := identity
         muldivBank(0).io.req.bits.in2 := batchData(0)
         muldivBank(0).io.req.bits.fn := ALUFN().FN_MUL
-        workingSpace(0).data := identity
+        workingSpace(0) := identity
         for (i <- 1 until batchSize) {
           muldivBank(i).io.req.bits.in1 := muldivBank(i-1).io.resp.bits.data
           muldivBank(i).io.req.bits.in2 := batchData(i)
           muldivBank(i).io.req.bits.fn := ALUFN().FN_MUL
-          muldivBank(i).io.req.valid := muldivBank(i-1).io.resp.valid
-          workingSpace(i).data := muldivBank(i-1).io.resp.bits.data
+          muldivBank(i).io.req.valid := chainValid(i, muldivBank(i-1).io.resp.valid)
+          workingSpace(i) := muldivBank(i-1).io.resp.bits.data
         }
 
-        when (muldivBank(batchSize-1).io.resp.valid) {
-          identity := muldivBank(batchSize-1).io.resp.bits.data
+        when (muldivChainValid) {
+          identity := muldivChainData
         }
-        io.out.valid := muldivBank(batchSize-1).io.resp.valid
+        io.out.valid := muldivChainValid
       }
       is(23.U){
         // MAX SCAN INT
-        val batchData = io.in1.map{ case d => d.data.asSInt }
-        for (i <- 0 until batchSize) {
-          workingSpace(i).addr := io.baseAddress + (i.U * 8.U)
-        }
+        val batchData = io.in1.map{ case d => d.asSInt }
 
         compareBank(0).io.req.bits.in1 := identity.asSInt
         compareBank(0).io.req.bits.in2 := batchData(0)
         compareBank(0).io.req.bits.fn := ComparatorOp.max
-        workingSpace(0).data := identity
+        workingSpace(0) := identity
         for (i <- 1 until batchSize) {
           compareBank(i).io.req.bits.in1 := compareBank(i-1).io.resp.bits.data
           compareBank(i).io.req.bits.in2 := batchData(i)
           compareBank(i).io.req.bits.fn := ComparatorOp.max
-          compareBank(i).io.req.valid := compareBank(i-1).io.resp.valid
-          workingSpace(i).data := compareBank(i-1).io.resp.bits.data.asUInt
+          compareBank(i).io.req.valid := chainValid(i, compareBank(i-1).io.resp.valid)
+          workingSpace(i) := compareBank(i-1).io.resp.bits.data.asUInt
         }
 
-        when (compareBank(batchSize-1).io.resp.valid) {
-          identity := compareBank(batchSize-1).io.resp.bits.data.asUInt
+        when (compareChainValid) {
+          identity := compareChainData.asUInt
         }
-        io.out.valid := compareBank(batchSize-1).io.resp.valid
+        io.out.valid := compareChainValid
       }
       is(24.U){
         // MIN SCAN INT
-        val batchData = io.in1.map{ case d => d.data.asSInt }
-        for (i <- 0 until batchSize) {
-          workingSpace(i).addr := io.baseAddress + (i.U * 8.U)
-        }
+        val batchData = io.in1.map{ case d => d.asSInt }
 
         compareBank(0).io.req.bits.in1 := identity.asSInt
         compareBank(0).io.req.bits.in2 := batchData(0)
         compareBank(0).io.req.bits.fn := ComparatorOp.min
-        workingSpace(0).data := identity
+        workingSpace(0) := identity
         for (i <- 1 until batchSize) {
           compareBank(i).io.req.bits.in1 := compareBank(i-1).io.resp.bits.data
           compareBank(i).io.req.bits.in2 := batchData(i)
           compareBank(i).io.req.bits.fn := ComparatorOp.min
-          compareBank(i).io.req.valid := compareBank(i-1).io.resp.valid
-          workingSpace(i).data := compareBank(i-1).io.resp.bits.data.asUInt
+          compareBank(i).io.req.valid := chainValid(i, compareBank(i-1).io.resp.valid)
+          workingSpace(i) := compareBank(i-1).io.resp.bits.data.asUInt
         }
 
-        when (compareBank(batchSize-1).io.resp.valid) {
-          identity := compareBank(batchSize-1).io.resp.bits.data.asUInt
+        when (compareChainValid) {
+          identity := compareChainData.asUInt
         }
-        io.out.valid := compareBank(batchSize-1).io.resp.valid
+        io.out.valid := compareChainValid
       }
       is(25.U){
         // AND SCAN INT
-        val batchData = io.in1.map{ case d => d.data }
-        val scanTmp = batchData.scan(identity)(_ & _)
-        val results = scanTmp.zipWithIndex.map{ case(d, idx) => {
-          val result = Wire(new DataIO(xLen))
-          result.addr := io.baseAddress + (idx.U * 8.U)
-          result.data := d
-          result
-          }
-        }
+        val results = io.in1.scan(identity)(_ & _)
         workingSpace := results.slice(0, batchSize)
-        identity := results(batchSize).data
+        identity := results(batchSize)
         io.out.valid := true.B
       }
       is(26.U){
         // OR SCAN INT
-        val batchData = io.in1.map { case d => d.data }
-        val scanTmp = batchData.scan(identity)(_ | _)
-        val results = scanTmp.zipWithIndex.map{ case(d, idx) => {
-          val result = Wire(new DataIO(xLen))
-          result.addr := io.baseAddress + (idx.U * 8.U)
-          result.data := d
-          result
-          }
-        }
+        val results = io.in1.scan(identity)(_ | _)
         workingSpace := results.slice(0, batchSize)
-        identity := results(batchSize).data
+        identity := results(batchSize)
         io.out.valid := true.B
       }
       is(27.U){
         // XOR SCAN INT
-        val batchData = io.in1.map { case d => d.data }
-        val scanTmp = batchData.scan(identity)(_ ^ _)
-        val results = scanTmp.zipWithIndex.map{ case(d, idx) => {
-          val result = Wire(new DataIO(xLen))
-          result.addr := io.baseAddress + (idx.U * 8.U)
-          result.data := d
-          result
-          }
-        }
+        val results = io.in1.scan(identity)(_ ^ _)
         workingSpace := results.slice(0, batchSize)
-        identity := results(batchSize).data
+        identity := results(batchSize)
         io.out.valid := true.B
       }
       is(28.U) {
         // *_REDUCE INT
-        val batchData = io.in1.map{ case d => d.data }
+        val batchData = io.in1
         muldivBank(0).io.req.bits.in1 := identity
         muldivBank(0).io.req.bits.in2 := batchData(0)
         muldivBank(0).io.req.bits.fn := ALUFN().FN_MUL
@@ -470,17 +615,16 @@ class ALU(val xLen: Int)(val batchSize: Int) extends Module {
           muldivBank(i).io.req.bits.in1 := muldivBank(i-1).io.resp.bits.data
           muldivBank(i).io.req.bits.in2 := batchData(i)
           muldivBank(i).io.req.bits.fn := ALUFN().FN_MUL
-          muldivBank(i).io.req.valid := muldivBank(i-1).io.resp.valid
+          muldivBank(i).io.req.valid := chainValid(i, muldivBank(i-1).io.resp.valid)
         }
 
-        lastBatchResult.addr := io.baseAddress
-        lastBatchResult.data := muldivBank(batchSize-1).io.resp.bits.data
-        identity := muldivBank(batchSize-1).io.resp.bits.data
-        io.out.valid := muldivBank(batchSize-1).io.resp.valid
+        lastBatchResult := muldivChainData
+        identity := muldivChainData
+        io.out.valid := muldivChainValid
       }
       is(29.U) {
         // MAX_REDUCE INT
-        val batchData = io.in1.map{ case d => d.data.asSInt }
+        val batchData = io.in1.map{ case d => d.asSInt }
         compareBank(0).io.req.bits.in1 := identity.asSInt
         compareBank(0).io.req.bits.in2 := batchData(0)
         compareBank(0).io.req.bits.fn := ComparatorOp.max
@@ -489,17 +633,16 @@ class ALU(val xLen: Int)(val batchSize: Int) extends Module {
           compareBank(i).io.req.bits.in1 := compareBank(i-1).io.resp.bits.data
           compareBank(i).io.req.bits.in2 := batchData(i)
           compareBank(i).io.req.bits.fn := ComparatorOp.max
-          compareBank(i).io.req.valid := compareBank(i-1).io.resp.valid
+          compareBank(i).io.req.valid := chainValid(i, compareBank(i-1).io.resp.valid)
         }
 
-        lastBatchResult.addr := io.baseAddress
-        lastBatchResult.data := compareBank(batchSize-1).io.resp.bits.data.asUInt
-        identity := compareBank(batchSize-1).io.resp.bits.data.asUInt
-        io.out.valid := compareBank(batchSize-1).io.resp.valid
+        lastBatchResult := compareChainData.asUInt
+        identity := compareChainData.asUInt
+        io.out.valid := compareChainValid
       }
       is(30.U) {
         // MIN_REDUCE INT
-        val batchData = io.in1.map{ case d => d.data.asSInt }
+        val batchData = io.in1.map{ case d => d.asSInt }
         compareBank(0).io.req.bits.in1 := identity.asSInt
         compareBank(0).io.req.bits.in2 := batchData(0)
         compareBank(0).io.req.bits.fn := ComparatorOp.min
@@ -508,33 +651,169 @@ class ALU(val xLen: Int)(val batchSize: Int) extends Module {
           compareBank(i).io.req.bits.in1 := compareBank(i-1).io.resp.bits.data
           compareBank(i).io.req.bits.in2 := batchData(i)
           compareBank(i).io.req.bits.fn := ComparatorOp.min
-          compareBank(i).io.req.valid := compareBank(i-1).io.resp.valid
+          compareBank(i).io.req.valid := chainValid(i, compareBank(i-1).io.resp.valid)
         }
 
-        lastBatchResult.addr := io.baseAddress
-        lastBatchResult.data := compareBank(batchSize-1).io.resp.bits.data.asUInt
-        identity := compareBank(batchSize-1).io.resp.bits.data.asUInt
-        io.out.valid := compareBank(batchSize-1).io.resp.valid
+        lastBatchResult := compareChainData.asUInt
+        identity := compareChainData.asUInt
+        io.out.valid := compareChainValid
       }
       is(31.U) {
         // AND_REDUCE INT
         val result = reduction(io.in1, _ & _)
         lastBatchResult := result
-        identity := result.data
+        identity := result
         io.out.valid := true.B
       }
       is(32.U) {
         // OR_REDUCE INT
         val result = reduction(io.in1, _ | _)
         lastBatchResult := result
-        identity := result.data
+        identity := result
         io.out.valid := true.B
       }
       is(33.U) {
         // XOR_REDUCE INT
         val result = reduction(io.in1, _ ^ _)
         lastBatchResult := result
-        identity := result.data
+        identity := result
+        io.out.valid := true.B
+      }
+      is(35.U) {
+        // INDEX INT
+        /* Lane i gets start + (i * stride). Nothing is read from memory, so
+         * the values are generated directly into the working space. */
+        for (i <- 0 until batchSize) {
+          workingSpace(i) := indexNext + (io.rs2 * i.U)
+        }
+        // Move forward batchSize strides. batchSize is always a power of 2.
+        indexNext := indexNext + (io.rs2 << log2Ceil(batchSize))
+        io.out.valid := true.B
+      }
+      is(36.U) {
+        // DIST INT
+        // Narrow elements are replicated across the whole lane.
+        val distValue = MuxLookup(io.elementWidth, io.rs1)(Seq(
+          MT8.value.U -> Fill(8, io.rs1(7, 0)),
+          MT16.value.U -> Fill(4, io.rs1(15, 0)),
+          MT32.value.U -> Fill(2, io.rs1(31, 0))))
+        for (i <- 0 until batchSize) {
+          workingSpace(i) := distValue
+        }
+        io.out.valid := true.B
+      }
+      is(39.U) {
+        // LESS (signed)
+        comparison(ComparatorOp.lt, false.B)
+      }
+      is(40.U) {
+        // LESS OR EQUAL (signed)
+        comparison(ComparatorOp.le, false.B)
+      }
+      is(41.U) {
+        // GREATER (signed)
+        comparison(ComparatorOp.gt, false.B)
+      }
+      is(42.U) {
+        // GREATER OR EQUAL (signed)
+        comparison(ComparatorOp.ge, false.B)
+      }
+      is(43.U) {
+        // MIN INT
+        compareBankMap(ComparatorOp.min, false.B)
+      }
+      is(44.U) {
+        // MAX INT
+        compareBankMap(ComparatorOp.max, false.B)
+      }
+      is(45.U) {
+        // MIN INT (unsigned)
+        compareBankMap(ComparatorOp.min, true.B)
+      }
+      is(46.U) {
+        // MAX INT (unsigned)
+        compareBankMap(ComparatorOp.max, true.B)
+      }
+      is(47.U) {
+        // ARITHMETIC RIGHT SHIFT
+        workingSpace := elementWiseMap(io.in1, io.in2, (x, y) => (x.asSInt >> y(5, 0)).asUInt)
+        io.out.valid := true.B
+      }
+      is(64.U) {
+        // DOT INT
+        /* Every lane multiplies its pair at the same time, like MUL. The
+         * products are then summed straight into the running total, like
+         * +_REDUCE, so the product vector never goes back out to memory. */
+        val productsValid = VecInit(muldivBank.map { _.io.resp.valid }).reduce(_ & _)
+        val result = identity + muldivBank.map(_.io.resp.bits.data).reduce(_ + _)
+        lastBatchResult := result
+        when(productsValid) {
+          identity := result
+        }
+        io.out.valid := productsValid
+      }
+      is(66.U) {
+        // POPCOUNT INT
+        workingSpace := elementWiseMap(io.in1, io.in2, (x, _y) => PopCount(x))
+        io.out.valid := true.B
+      }
+      is(67.U) {
+        // COUNT LEADING ZEROS INT
+        workingSpace := elementWiseMap(io.in1, io.in2, (x, _y) => countTrailingZeros(Reverse(x)))
+        io.out.valid := true.B
+      }
+      is(68.U) {
+        // COUNT TRAILING ZEROS INT
+        workingSpace := elementWiseMap(io.in1, io.in2, (x, _y) => countTrailingZeros(x))
+        io.out.valid := true.B
+      }
+      is(69.U) {
+        // BIT REVERSE INT
+        workingSpace := elementWiseMap(io.in1, io.in2, (x, _y) => Reverse(x))
+        io.out.valid := true.B
+      }
+      is(70.U) {
+        // POPCOUNT_REDUCE INT
+        // Bits past the last flag of the vector are not counted.
+        val flags = io.in1.zipWithIndex.map { case (x, i) =>
+          Mux(io.lastWordMask.valid && i.U === lastLane, x & io.lastWordMask.bits, x) }
+        // Chisel's + keeps the wider width, so widen the counts before summing.
+        val result = reduction(flags.map(PopCount(_).pad(xLen)), _ + _)
+        lastBatchResult := result
+        identity := result
+        io.out.valid := true.B
+      }
+      is(75.U) {
+        // RAND INT
+        /* A non-zero seed in rs1 restarts every lane's sequence. Zero keeps
+         * going from where the last RAND stopped. A lane's state never
+         * becomes zero, because xorshift maps non-zero states to non-zero
+         * states. */
+        for (i <- 0 until batchSize) {
+          val lanesSeed = io.rs1 ^ laneSeed(i).U(xLen.W)
+          val seeded = Mux(lanesSeed === 0.U, laneSeed(i).U(xLen.W), lanesSeed)
+          val current = Mux(!randSeeded && io.rs1 =/= 0.U, seeded, randState(i))
+          val next = xorshift(current)
+          when(pipelineStart) {
+            randState(i) := next
+          }
+          /* A non-zero bound in rs2 scales the value into [0, bound) by
+           * keeping the upper half of (value * bound). */
+          muldivBank(i).io.req.bits.fn := ALUFN().FN_MULHU
+          muldivBank(i).io.req.bits.in1 := next
+          muldivBank(i).io.req.bits.in2 := io.rs2
+          workingSpace(i) := Mux(io.rs2 === 0.U, randState(i), muldivBank(i).io.resp.bits.data)
+        }
+        when(pipelineStart) {
+          randSeeded := true.B
+        }
+        io.out.valid := VecInit(muldivBank.map { _.io.resp.valid }).reduce(_ & _)
+      }
+      is(77.U) {
+        // REPLACE INT
+        /* Only the one element at index rs2 of the destination is written.
+         * The control unit points the write at it. */
+        lastBatchResult := io.rs1
         io.out.valid := true.B
       }
     }
@@ -542,13 +821,15 @@ class ALU(val xLen: Int)(val batchSize: Int) extends Module {
 }
 
 object ComparatorOp extends ChiselEnum {
-  val min, max = Value
+  val min, max, lt, le, gt, ge, eq, ne = Value
 }
 
 /* TODO: Get proper subtyping on the comparator classes. We can only compare
  * classes T that are subclasses of Num, namely T <: Num */
 final class ComparatorReq(dataBits: Int) extends Bundle {
   val fn = ComparatorOp()
+  /** Compare in1 & in2 as unsigned integers rather than signed ones. */
+  val unsigned = Bool()
   val in1 = SInt(dataBits.W)
   val in2 = SInt(dataBits.W)
 }
@@ -557,9 +838,11 @@ final class ComparatorResp(dataBits: Int) extends Bundle {
   val data = SInt(dataBits.W)
 }
 
-/** A simple comparator that produces its value one clock cycle delayed.
-* This is intended for pipelining. */
-final class Comparator(val xLen: Int) extends Module {
+/** A comparator that produces its value `stages` clock cycles later, with a
+* register between each stage of the comparison. This is intended for
+* pipelining. */
+final class Comparator(val xLen: Int, val stages: Int = 1) extends Module {
+  require(stages >= 1, "Comparator must have at least one pipeline stage!")
   val io = IO(new Bundle {
     val req = Input(Valid(new ComparatorReq(xLen)))
     val resp = Output(Valid(new ComparatorResp(xLen)))
@@ -583,16 +866,69 @@ final class Comparator(val xLen: Int) extends Module {
    * results are combined later. Different platforms that have native HW
    * support for this, will have different native widths, which will affect how
    * you have to pipeline your design. */
+  /* The comparison is split into 2^(stages-1) chunks of bits, each compared on
+   * its own in the first stage. Every following stage merges pairs of
+   * neighbouring chunks, a higher chunk deciding unless its halves are equal,
+   * until one chunk is left. So each stage only holds a fraction of the carry
+   * chain. Signed values are compared as unsigned ones with their sign bits
+   * flipped. */
+  val chunks = 1 << (stages - 1)
+  require(chunks <= xLen && xLen % chunks == 0,
+    "Comparator cannot have more stages than its operands have bit levels!")
+  val chunkBits = xLen / chunks
+  val signFlip = Mux(io.req.bits.unsigned, 0.U, (BigInt(1) << (xLen - 1)).U(xLen.W))
+  val xu = x.asUInt ^ signFlip
+  val yu = y.asUInt ^ signFlip
+  def chunk(v: UInt, k: Int): UInt = v(chunkBits * (k + 1) - 1, chunkBits * k)
+
+  /** Everything one pipeline stage passes to the next. lt & eq hold the
+    * partial comparison of every chunk still left, lowest chunk first. */
+  case class Stage(valid: Bool, fn: ComparatorOp.Type, x: SInt, y: SInt,
+    lt: Seq[Bool], eq: Seq[Bool])
+  val first = Stage(io.req.valid, io.req.bits.fn, x, y,
+    (0 until chunks).map(k => chunk(xu, k) < chunk(yu, k)),
+    (0 until chunks).map(k => chunk(xu, k) === chunk(yu, k)))
+  val last = (1 until stages).foldLeft(first) { (prev, _) =>
+    val lt = prev.lt.map(RegNext(_))
+    val eq = prev.eq.map(RegNext(_))
+    val pairs = lt.zip(eq).grouped(2).toSeq
+    Stage(RegNext(prev.valid, false.B), RegNext(prev.fn), RegNext(prev.x), RegNext(prev.y),
+      pairs.map { case Seq((ltLow, _), (ltHigh, eqHigh)) => ltHigh || (eqHigh && ltLow) },
+      pairs.map { case Seq((_, eqLow), (_, eqHigh)) => eqHigh && eqLow })
+  }
+  val less = last.lt.head
+  val equal = last.eq.head
+  val greater = !less && !equal
+
   result.data := DontCare
-  switch (io.req.bits.fn) {
+  switch (last.fn) {
     is (ComparatorOp.min) {
-      result.data := x.min(y)
+      result.data := Mux(less, last.x, last.y)
     }
     is (ComparatorOp.max) {
-      result.data := x.max(y)
+      result.data := Mux(greater, last.x, last.y)
+    }
+    is (ComparatorOp.lt) {
+      result.data := less.asUInt.zext
+    }
+    is (ComparatorOp.le) {
+      result.data := (!greater).asUInt.zext
+    }
+    is (ComparatorOp.gt) {
+      result.data := greater.asUInt.zext
+    }
+    is (ComparatorOp.ge) {
+      result.data := (!less).asUInt.zext
+    }
+    is (ComparatorOp.eq) {
+      result.data := equal.asUInt.zext
+    }
+    is (ComparatorOp.ne) {
+      result.data := (!equal).asUInt.zext
     }
   }
 
-  io.resp.valid := RegNext(io.req.valid)
+  // The last stage picks the result, and registers it.
+  io.resp.valid := RegNext(last.valid, false.B)
   io.resp.bits := RegNext(result)
 }
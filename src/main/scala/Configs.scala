@@ -28,6 +28,86 @@ class WithVCodePrintf extends Config((site, here, up) => {
 })
 
 
+/** Number of pipeline stages in each of the ALU's comparators.
+  * Comparisons of wide batches are chained together, so raising this helps
+  * the design meet timing at higher clock frequencies, at the cost of latency.
+  * Each stage past the first halves the number of bits compared at once, so
+  * there can be at most log2(xLen) + 1 stages.
+  */
+case object VCodeComparatorStages extends Field[Int](1)
+
+/** Mixin to change the number of pipeline stages in the ALU's comparators.
+  * This mixin should only be used AFTER the WithVCodeAccel mixin.
+  */
+class WithVCodeComparatorStages(stages: Int) extends Config((site, here, up) => {
+  case VCodeComparatorStages => stages
+})
+
+/** Number of pipeline stages after each of the floating-point unit's FMA
+  * units. More stages let synthesis retime the FMA to a higher clock
+  * frequency, but every float operation, and every level of a float reduction
+  * or scan, takes that much longer.
+  */
+case object VCodeFmaLatency extends Field[Int](3)
+
+/** Mixin to change the number of pipeline stages after each FMA unit.
+  * This mixin should only be used AFTER the WithVCodeAccel mixin.
+  */
+class WithVCodeFmaLatency(latency: Int) extends Config((site, here, up) => {
+  case VCodeFmaLatency => latency
+})
+
+/** Width, in bits, of the digit each radix sort pass (HISTOGRAM & RANK) sorts
+  * by. The permute unit has 2^bits counters, so wider digits mean fewer
+  * passes but more area.
+  */
+case object VCodeRadixBits extends Field[Int](4)
+
+/** Mixin to change the width of radix sort digits.
+  * This mixin should only be used AFTER the WithVCodeAccel mixin.
+  */
+class WithVCodeRadixBits(bits: Int) extends Config((site, here, up) => {
+  case VCodeRadixBits => bits
+})
+
+/** Number of ALU clusters. Each cluster is a whole batchSize-wide ALU, so
+  * long-latency element-wise operations (MUL, DIV, MOD) can work on this many
+  * batches at once while the next ones are fetched.
+  */
+case object VCodeAluClusters extends Field[Int](1)
+
+/** Mixin to change the number of ALU clusters.
+  * This mixin should only be used AFTER the WithVCodeAccel mixin.
+  */
+class WithVCodeAluClusters(clusters: Int) extends Config((site, here, up) => {
+  case VCodeAluClusters => clusters
+})
+
+/** Fetch both operands of a two-operand operation on a vector that fits in
+  * half a batch in a single pass, skipping the second fetch state. Only worth
+  * turning off to measure what it saves.
+  */
+case object VCodePairShortVectors extends Field[Boolean](true)
+
+/** Mixin to turn the single-pass fetch of short vectors on or off.
+  * This mixin should only be used AFTER the WithVCodeAccel mixin.
+  */
+class WithVCodePairShortVectors(enabled: Boolean) extends Config((site, here, up) => {
+  case VCodePairShortVectors => enabled
+})
+
+/** Number of records the trace buffer holds. Each record is one 64-bit
+  * register, so deeper traces cost area.
+  */
+case object VCodeTraceEntries extends Field[Int](64)
+
+/** Mixin to change the depth of the trace buffer.
+  * This mixin should only be used AFTER the WithVCodeAccel mixin.
+  */
+class WithVCodeTrace(entries: Int) extends Config((site, here, up) => {
+  case VCodeTraceEntries => entries
+})
+
 /** Adds a TileKey configuration, making the simplified testing design a part of
   * the TileLink network, allowing for the processor and accelerator to communicate
   * with the TileLink network.
@@ -4,18 +4,36 @@ import chisel3._
 import chisel3.util._
 import org.chipsalliance.cde.config.Parameters
 import freechips.rocketchip.tile.{CoreModule, RoCCCommand}
+import vcoderocc.constants._
 
 object SourceOperand extends ChiselEnum {
   val none, rs1, rs2, rs3 = Value
 }
 
+/** The configuration the next vector operation of a control unit will run
+  * with, as set up by the control instructions. */
+class ControlConfig(xLen: Int) extends Bundle {
+  val numOperands = UInt(xLen.W)
+  val destAddr = UInt(xLen.W)
+  val rs3 = UInt(xLen.W)
+  val elementWidth = UInt(3.W)
+  /** Every vector is contiguous, with no strides or 2-D shape set, and its
+    * length is known without reading a header. */
+  val contiguous = Bool()
+  val headerMode = Bool()
+}
+
 class ControlUnit(val batchSize: Int)(implicit p: Parameters) extends CoreModule()(p) {
   val io = IO(new Bundle {
     val roccCmd = Input(new RoCCCommand())
     val ctrlSigs = Input(new CtrlSigs(xLen))
     val cmdValid = Input(Bool())
+    /** A legal configuration instruction, in the cycle it is accepted. */
+    val configCmd = Input(Valid(new RoCCCommand()))
     val busy = Output(Bool())
     val accelReady = Output(Bool())
+    /** The configuration instruction in configCmd.bits can be accepted. */
+    val configReady = Output(Bool())
     // TODO: Rework these booleans to an Enum which can be "exported"
     val shouldFetch = Output(Bool())
     // FIXME: rs1Fetch is hacky work-around to distinguish rs1 vs rs2 fetching
@@ -24,7 +42,41 @@ class ControlUnit(val batchSize: Int)(implicit p: Parameters) extends CoreModule
     val rs2Fetch = Output(Bool())
     val rs3Fetch = Output(Bool())
     val baseAddress = Output(UInt(xLen.W))
+    /** Fetch rs2 alongside rs1, into the upper half of the batch. */
+    val pairAddress = Output(Valid(UInt(xLen.W)))
     val numToFetch = Output(UInt(xLen.W))
+    /** Width of the elements packed into each 64-bit word of the current
+      * operation, as a MemorySizeConstants MTxx encoding. */
+    val elementWidth = Output(UInt(3.W))
+    /** Distance in bytes between two consecutive elements being fetched. */
+    val fetchStride = Output(UInt(xLen.W))
+    /** The sort unit wants the next batch of a MERGE from the second vector. */
+    val mergeNextFromB = Input(Bool())
+    /** The batch being merged was fetched from the second vector. */
+    val mergeFromB = Output(Bool())
+    /** Both vectors of a MERGE are used up, only the carry is left. */
+    val mergeFlush = Output(Bool())
+    /** Accumulator (plus 1) integer reductions are kept in, 0 for none. */
+    val accumulator = Output(UInt(ALU.SZ_ACCUMULATOR.W))
+    /** Hand the batch in the fetch buffers to ALU cluster dispatchCluster. */
+    val clusterDispatch = Output(Bool())
+    val dispatchCluster = Output(UInt(log2Up(p(VCodeAluClusters)).W))
+    /** ALU cluster holding the oldest batch still to be written back. */
+    val writeCluster = Output(UInt(log2Up(p(VCodeAluClusters)).W))
+    /** The writeCluster has finished computing its batch. */
+    val writeClusterDone = Input(Bool())
+    /** The batch being executed holds the last word of a packed boolean
+      * vector, and only these bits of it are flags of the vector. */
+    val lastWordMask = Output(Valid(UInt(xLen.W)))
+    /** Configuration the next operation runs with. */
+    val config = Output(new ControlConfig(xLen))
+    /** Take on another control unit's configuration, instead of running
+      * configuration instructions. */
+    val loadConfig = Input(Valid(new ControlConfig(xLen)))
+    /** First word of the last batch fetched, for reading vector headers. */
+    val headerLength = Input(UInt(xLen.W))
+    /** Length to write to the destination vector's header. */
+    val headerOut = Output(Valid(UInt(xLen.W)))
     val memOpCompleted = Input(Bool())
     val shouldExecute = Output(Bool())
     val executeCompleted = Input(Bool())
@@ -32,20 +84,33 @@ class ControlUnit(val batchSize: Int)(implicit p: Parameters) extends CoreModule
     // Writeback completion is marked by mem_op_completed
     val responseReady = Output(Bool())
     val responseCompleted = Input(Bool())
+    /** The state the control unit is in, for the performance counters. */
+    val state = Output(UInt(4.W))
   })
 
   object State extends ChiselEnum {
     /* Internally (in Verilog) represented as integers. First item in list has
      * value 0, i.e. idle = 0x0. */
-    val idle, fetch1, fetch2, fetch3, exe, write, respond = Value
+    val idle, fetch1, fetch2, fetch3, exe, write, respond, readHeader, writeHeader = Value
   }
   val accelState = RegInit(State.idle) // Reset to idle state
+  io.state := accelState.asUInt
 
   // Configuration registers. Set by set-up instructions
   // TODO: Figure out better way to declare these configuration registers
   // Perhaps a separate module that handles this? class ConfigBank extends Module {}
   val numOperands = RegInit(0.U(xLen.W))
   val operandsToGo = RegInit(0.U(xLen.W))
+  val elementWidth = RegInit(MT64.value.U(3.W))
+  val accumulator = RegInit(0.U(ALU.SZ_ACCUMULATOR.W))
+  io.accumulator := accumulator
+  /* In header mode, every vector pointer points at a header word holding the
+   * vector's length, and the elements follow the header. The length of the
+   * vector in rs1 is read from its header instead of numOperands, and the
+   * length of the output is written to the destination's header. */
+  val headerMode = RegInit(false.B)
+  // Length of the output vector, for its header.
+  val outputLength = RegInit(0.U(xLen.W))
 
   /* The rsX registers hold the BASE addresses of vectors and NEVER change!
    * The currentRsX registers hold the BASE addresses of vectors during the
@@ -58,10 +123,130 @@ class ControlUnit(val batchSize: Int)(implicit p: Parameters) extends CoreModule
   val currentRs2 = RegInit(0.U(xLen.W))
   val currentRs3 = RegInit(0.U(xLen.W))
   val currentDestAddr = RegInit(0.U(xLen.W))
-  val roundCounter = RegInit(0.U(log2Ceil(64/batchSize).W)) // Round up if (64/batchSize) is not an integer
+  /* SELECT flags & packed comparison results are 1 bit per element. Batches
+   * smaller than a word share one word of them, roundsPerWord batches at a
+   * time, which roundCounter counts. Larger batches take flagWords words of
+   * their own each. */
+  val roundsPerWord = math.max(1, 64 / batchSize)
+  val flagWords = math.max(1, batchSize / 64)
+  val roundCounter = RegInit(0.U(log2Up(roundsPerWord).W))
+  // Words of packed comparison results the last batch produced.
+  val packedWords = RegInit(0.U(log2Up(flagWords + 1).W))
+
+  /* A MERGE reads its two vectors at different rates. After its first round,
+   * which reads a batch of both, each round fetches one batch from whichever
+   * vector the sort unit asks for into the rs1 fetch buffer. The last batch
+   * of a vector may be short, and the sort unit pads it out. */
+  val isMerge = io.ctrlSigs.aluFn === SortUnit.FN_MERGE
+  val mergeALeft = RegInit(0.U(xLen.W))
+  val mergeBLeft = RegInit(0.U(xLen.W))
+  val mergeStarted = RegInit(false.B)
+  val mergeFromB = RegInit(false.B)
+  io.mergeFromB := mergeFromB
+  io.mergeFlush := mergeStarted && mergeALeft === 0.U && mergeBLeft === 0.U
+  def upToBatch(n: UInt): UInt = Mux(n >= batchSize.U, batchSize.U, n)
+  val mergeFetchA = upToBatch(mergeALeft)
+  val mergeFetchB = upToBatch(mergeBLeft)
+
+  /* EXTRACT & REPLACE touch exactly one element. EXTRACT fetches it and
+   * responds with it, without executing or writing anything. */
+  val isExtract = io.ctrlSigs.aluFn === ALU.FN_EXTRACT
+  val isSingleElement = isExtract || io.ctrlSigs.aluFn === ALU.FN_REPLACE
+
+  val isReduction = io.ctrlSigs.aluFn === ALU.FN_RED_ADD ||
+    io.ctrlSigs.aluFn === ALU.FN_RED_MUL ||
+    io.ctrlSigs.aluFn === ALU.FN_RED_MAX ||
+    io.ctrlSigs.aluFn === ALU.FN_RED_MIN ||
+    io.ctrlSigs.aluFn === ALU.FN_RED_AND ||
+    io.ctrlSigs.aluFn === ALU.FN_RED_OR ||
+    io.ctrlSigs.aluFn === ALU.FN_RED_XOR ||
+    io.ctrlSigs.aluFn === FloatUnit.FN_RED_FADD ||
+    io.ctrlSigs.aluFn === FloatUnit.FN_RED_FMUL ||
+    io.ctrlSigs.aluFn === ALU.FN_DOT ||
+    io.ctrlSigs.aluFn === ALU.FN_RED_POPCOUNT ||
+    io.ctrlSigs.aluFn === FloatUnit.FN_FDOT
+
+  /* Which of rs1, rs2 & the destination are vectors, and so have headers in
+   * header mode. Only vectors written as a whole get their header written. */
+  val rs1IsVector = io.ctrlSigs.numMemFetches =/= NumOperatorOperands.MEM_OPS_ZERO
+  val rs2IsVector = io.ctrlSigs.numMemFetches === NumOperatorOperands.MEM_OPS_TWO ||
+    io.ctrlSigs.numMemFetches === NumOperatorOperands.MEM_OPS_THREE
+  /* READ_ACCUMULATOR & READ_COUNTER have nothing to fetch, compute or write.
+   * They only respond. */
+  val respondsOnly = io.ctrlSigs.aluFn === ALU.FN_READ_ACCUMULATOR ||
+    io.ctrlSigs.aluFn === PerfCounters.FN_READ_COUNTER
+  val destIsVector = !isReduction && !isExtract && !respondsOnly &&
+    io.ctrlSigs.aluFn =/= PermuteUnit.FN_HISTOGRAM
+  val readsHeader = headerMode && rs1IsVector && !isSingleElement
+  val writesHeader = headerMode && destIsVector && !isSingleElement
+  // Where an operation goes once its last result is written.
+  val finishState = Mux(writesHeader, State.writeHeader, State.respond)
+
+  /* Strides of the two source vectors & the destination (index 0, 1 & 2), in
+   * elements. With a rowLength, the vectors are also 2-D: rows of rowLength
+   * elements, each starting rowStride elements after the one before it.
+   * rowLength 0 makes every vector 1-D. */
+  val strides = RegInit(VecInit(Seq.fill(3)(1.U(xLen.W))))
+  val rowStrides = RegInit(VecInit(Seq.fill(3)(0.U(xLen.W))))
+  val rowLength = RegInit(0.U(xLen.W))
+  // Where the current row of each vector starts, and how much of it is left.
+  val rowStarts = RegInit(VecInit(Seq.fill(3)(0.U(xLen.W))))
+  val colsToGo = RegInit(0.U(xLen.W))
+  /* Only operations that step through numOperands 64-bit elements in order
+   * follow the strides & shape. Everything else ignores them. */
+  val fn = io.ctrlSigs.aluFn
+  val followsShape = !(isMerge || isSingleElement || SortUnit.isSort(fn) ||
+    fn === TraceBuffer.FN_DRAIN_TRACE ||
+    PermuteUnit.isPermuteUnit(fn) || fn === ALU.FN_SELECT || fn === ALU.FN_COPY_STRIDED ||
+    io.ctrlSigs.boolPacking =/= BoolPacking.BOOL_UNPACKED ||
+    (ALU.supportsSubword(fn) && elementWidth =/= MT64))
+  val stride = VecInit(strides.map(s => Mux(followsShape, s, 1.U)))
+  // INDEX numbers its elements a whole batch at a time, so it stays 1-D.
+  val shaped = followsShape && rowLength =/= 0.U && fn =/= ALU.FN_INDEX
 
-  // The accelerator is ready to execute if it is in the idle state
-  io.accelReady := (accelState === State.idle)
+  /* With more than one ALU cluster, long-latency element-wise operations hand
+   * each fetched batch to the next cluster in turn and go on fetching, rather
+   * than waiting in exe. Batches are dispatched and written back in the same
+   * round-robin order, so the results come out in order, and the cluster the
+   * next batch goes to is free exactly when fewer than numClusters batches are
+   * in flight. */
+  val numClusters = p(VCodeAluClusters)
+  // Batches of a 2-D vector can be cut short by the end of a row, so they run one at a time.
+  val clustered = (numClusters > 1).B && ALU.isClusterable(io.ctrlSigs.aluFn) && !shaped
+  val fetchToGo = RegInit(0.U(xLen.W))
+  val batchFetched = RegInit(false.B)
+  val inFlight = RegInit(0.U(log2Up(numClusters + 1).W))
+  val dispatchCluster = RegInit(0.U(log2Up(numClusters).W))
+  val writeCluster = RegInit(0.U(log2Up(numClusters).W))
+  io.clusterDispatch := false.B
+  io.dispatchCluster := dispatchCluster
+  io.writeCluster := writeCluster
+  /** Round-robin successor of cluster index c. */
+  def nextCluster(c: UInt): UInt =
+    if (isPow2(numClusters)) c + 1.U else Mux(c === (numClusters - 1).U, 0.U, c + 1.U)
+
+  /* Two-operand operations on vectors that fit in half a batch fetch both
+   * operands in a single pass, rs1 into the lower half of the batch and rs2
+   * into the upper half, and skip fetch2. Short vectors are common, and this
+   * saves them a whole trip to memory. */
+  val pairable = (p(VCodePairShortVectors) && batchSize >= 2).B && !clustered && !isMerge && !shaped &&
+    io.ctrlSigs.numMemFetches === NumOperatorOperands.MEM_OPS_TWO &&
+    stride(0) === stride(1)
+  val fetchPair = pairable && operandsToGo <= (batchSize / 2).U
+  io.pairAddress.valid := accelState === State.fetch1 && fetchPair
+  io.pairAddress.bits := currentRs2
+
+  /* Every round of a vector operation starts by fetching its operands. Vector
+   * generators (INDEX, DIST) have no operands in memory, so they skip all the
+   * fetch states and go straight to execution. */
+  val roundStartState = Mux(io.ctrlSigs.numMemFetches === NumOperatorOperands.MEM_OPS_ZERO,
+    State.exe, State.fetch1)
+
+  /* The accelerator is ready to execute if it is in the idle state, and is not
+   * about to leave it for the vector operation it was just handed. */
+  val starting = accelState === State.idle && io.cmdValid && io.ctrlSigs.legal && io.ctrlSigs.isMemOp
+  io.accelReady := accelState === State.idle && !starting
+  val running = !io.accelReady
 
   // We are busy if we are not idle.
   io.busy := (accelState =/= State.idle)
@@ -69,10 +254,56 @@ class ControlUnit(val batchSize: Int)(implicit p: Parameters) extends CoreModule
   // responses are being made. Perhaps make this less strict?
 
   // We should fetch when we are in fetching data state
-  io.shouldFetch := (accelState === State.fetch1 || accelState === State.fetch2 || accelState === State.fetch3)
+  io.shouldFetch := (accelState === State.fetch1 || accelState === State.fetch2 ||
+    accelState === State.fetch3 || accelState === State.readHeader)
+  /* Functions that do not support sub-word elements always see 64-bit ones. */
+  val subword = ALU.supportsSubword(io.ctrlSigs.aluFn) && elementWidth =/= MT64
+  io.elementWidth := Mux(subword, elementWidth, MT64.value.U)
+
+  /* Comparisons with packed results gather batches into one word of flags
+   * before writing it, or write a batch's own packedWords words. */
+  val packResult = io.ctrlSigs.boolPacking === BoolPacking.BOOL_PACK_RESULT
   // FIXME: This num_to_fetch is a little bit messy.
-  io.numToFetch := Mux(operandsToGo >= batchSize.U, batchSize.U, operandsToGo)
+  /* Clustered operations fetch ahead of what they write, so they count the
+   * elements still to fetch separately. */
+  val elementsToGo = Mux(clustered && accelState =/= State.write, fetchToGo, operandsToGo)
+  val batchElements = Mux(elementsToGo >= batchSize.U, batchSize.U, elementsToGo)
+  // A round of a 2-D vector stops at the end of the row.
+  val roundElements = Mux(shaped && colsToGo < batchElements, colsToGo, batchElements)
+  val roundLanes = roundElements(log2Ceil(batchSize + 1) - 1, 0)
+  val rowEnds = shaped && colsToGo <= roundElements
+  /** Address in vector k n elements on from addr, or the start of the next
+    * row if this round ends the current one. */
+  def advance(k: Int, addr: UInt, n: UInt): UInt =
+    Mux(rowEnds, rowStarts(k) + (rowStrides(k) << 3), addr + ((stride(k) * n) << 3))
+  /** Move every vector on to its next row, if this round ended the row. */
+  def nextRound(): Unit = {
+    when(shaped) {
+      colsToGo := Mux(rowEnds, rowLength, colsToGo - roundElements)
+    }
+    when(rowEnds) {
+      for (k <- 0 until 3) {
+        rowStarts(k) := rowStarts(k) + (rowStrides(k) << 3)
+      }
+    }
+  }
+  io.numToFetch := MuxCase(roundElements, Seq(
+    (accelState === State.write && packResult) -> packedWords,
+    (isMerge && accelState === State.fetch1) -> Mux(mergeFromB, mergeFetchB, mergeFetchA),
+    (isMerge && accelState === State.fetch2) -> mergeFetchB,
+    io.pairAddress.valid -> (operandsToGo << 1),
+    (accelState === State.readHeader || accelState === State.writeHeader) -> 1.U,
+    // Only the flag words this batch's elements need.
+    (accelState === State.fetch3) -> ((batchElements + 63.U) >> 6)))
   io.rs1Fetch := accelState === State.fetch1
+  /* The source of a strided copy has its stride, in elements, in rs2.
+   * Everything else uses the stride of the vector being fetched or written. */
+  val isStrided = io.ctrlSigs.aluFn === ALU.FN_COPY_STRIDED
+  io.fetchStride := MuxCase(8.U, Seq(
+    (isStrided && accelState === State.fetch1) -> (rs2 << 3),
+    (accelState === State.fetch1) -> (stride(0) << 3),
+    (accelState === State.fetch2) -> (stride(1) << 3),
+    (accelState === State.write) -> (stride(2) << 3)))
   io.rs2Fetch := accelState === State.fetch2
   io.rs3Fetch := accelState === State.fetch3
 
@@ -86,7 +317,7 @@ class ControlUnit(val batchSize: Int)(implicit p: Parameters) extends CoreModule
       io.baseAddress := 0.U
     }
     is (State.fetch1) {
-      io.baseAddress := currentRs1
+      io.baseAddress := Mux(isMerge && mergeFromB, currentRs2, currentRs1)
     }
     is (State.fetch2) {
       io.baseAddress := currentRs2
@@ -94,60 +325,210 @@ class ControlUnit(val batchSize: Int)(implicit p: Parameters) extends CoreModule
     is (State.fetch3) {
       io.baseAddress := currentRs3
     }
+    is (State.readHeader) {
+      io.baseAddress := rs1
+    }
+    is (State.writeHeader) {
+      io.baseAddress := destAddr
+    }
     is (State.exe, State.write) {
-      io.baseAddress := currentDestAddr
+      // REPLACE writes only the element at index rs2.
+      io.baseAddress := Mux(io.ctrlSigs.aluFn === ALU.FN_REPLACE, currentDestAddr + (rs2 << 3), currentDestAddr)
     }
   }
 
   io.shouldExecute := (accelState === State.exe)
 
-  io.writebackReady := (accelState === State.write)
+  io.writebackReady := (accelState === State.write || accelState === State.writeHeader)
+  io.headerOut.valid := accelState === State.writeHeader
+  io.headerOut.bits := outputLength
 
   io.responseReady := (accelState === State.respond)
 
+  // The last word of a packed boolean vector holds n % 64 flags, or 64 if 0.
+  val tailFlags = outputLength(5, 0)
+  io.lastWordMask.valid := io.ctrlSigs.boolPacking === BoolPacking.BOOL_PACKED &&
+    operandsToGo <= batchSize.U && tailFlags =/= 0.U
+  io.lastWordMask.bits := (1.U << tailFlags) - 1.U
+
   // TODO: Simplify the use of non-blocking assignments to set up the accelerator
   /* NOTE: Configuration commands do NOT change the accelerator's control unit's
    * state! This is because the control unit's FSM is meant to organize the
-   * execution of vector operations. Config commands can be handled in 1 cycle. */
-  when(io.cmdValid && io.ctrlSigs.legal &&
-       io.roccCmd.inst.funct === Instructions.SET_NUM_OPERANDS && io.roccCmd.inst.xs1) {
-    numOperands := io.roccCmd.rs1
-    operandsToGo := io.roccCmd.rs1
+   * execution of vector operations. Config commands can be handled in 1 cycle.
+   * They are applied the cycle they are accepted, so the instruction accepted
+   * right after one already sees the new configuration.
+   *
+   * While an operation runs, only the settings it no longer reads may be
+   * changed: numOperands, and outside of header mode the destination & rs3.
+   * These are staged for the next operation, so the permute lane can be set
+   * up and started behind a running operation. Nothing else is accepted, and
+   * nothing that responds. */
+  val configCmd = io.configCmd.bits
+  val stageable = !configCmd.inst.xd && !headerMode &&
+    io.ctrlSigs.aluFn =/= TraceBuffer.FN_DRAIN_TRACE &&
+    (configCmd.inst.funct === Instructions.SET_NUM_OPERANDS ||
+     configCmd.inst.funct === Instructions.SET_DEST_ADDR ||
+     configCmd.inst.funct === Instructions.SET_THIRD_OPERAND)
+  io.configReady := io.accelReady || stageable
+  // A destination or rs3 was staged, and the current one is still running.
+  val destStaged = RegInit(false.B)
+  val rs3Staged = RegInit(false.B)
+  when(io.configCmd.valid &&
+       configCmd.inst.funct === Instructions.SET_NUM_OPERANDS && configCmd.inst.xs1) {
+    numOperands := configCmd.rs1
+    when(!running) {
+      operandsToGo := configCmd.rs1
+    }
+    if(p(VCodePrintfEnable)) {
+      printf("Config\tSet numOperands to 0x%x\n", configCmd.rs1)
+    }
+  }
+
+  when(io.configCmd.valid &&
+       configCmd.inst.funct === Instructions.SET_DEST_ADDR && configCmd.inst.xs1) {
+    destAddr := configCmd.rs1
+    when(!running) {
+      currentDestAddr := configCmd.rs1
+    }
+    if(p(VCodePrintfEnable)) {
+      printf("Config\tSet destAddr to 0x%x\n", configCmd.rs1)
+    }
+  }
+
+  when(io.configCmd.valid &&
+       configCmd.inst.funct === Instructions.SET_THIRD_OPERAND && configCmd.inst.xs1) {
+    rs3 := configCmd.rs1
+    when(!running) {
+      currentRs3 := configCmd.rs1
+    }
+    if(p(VCodePrintfEnable)) {
+      printf("Config\tSet rs3 to 0x%x\n", configCmd.rs1)
+    }
+  }
+
+  when(io.configCmd.valid &&
+       configCmd.inst.funct === Instructions.SET_ELEMENT_WIDTH && configCmd.inst.xs1 &&
+       configCmd.rs1 <= MT64.value.U) {
+    elementWidth := configCmd.rs1(2, 0)
+    if(p(VCodePrintfEnable)) {
+      printf("Config\tSet elementWidth to 0x%x\n", configCmd.rs1(2, 0))
+    }
+  }
+
+  when(io.configCmd.valid &&
+       configCmd.inst.funct === Instructions.SET_ACCUMULATOR && configCmd.inst.xs1 &&
+       configCmd.rs1 <= ALU.NUM_ACCUMULATORS.U) {
+    accumulator := configCmd.rs1
+    if(p(VCodePrintfEnable)) {
+      printf("Config\tSet accumulator to 0x%x\n", configCmd.rs1)
+    }
+  }
+
+  when(io.configCmd.valid &&
+       configCmd.inst.funct === Instructions.SET_STRIDE && configCmd.inst.xs1 &&
+       configCmd.rs1 < 3.U) {
+    strides(configCmd.rs1(1, 0)) := configCmd.rs2
     if(p(VCodePrintfEnable)) {
-      printf("Config\tSet numOperands to 0x%x\n", io.roccCmd.rs1)
+      printf("Config\tSet stride %d to 0x%x\n", configCmd.rs1, configCmd.rs2)
     }
   }
 
-  when(io.cmdValid && io.ctrlSigs.legal &&
-       io.roccCmd.inst.funct === Instructions.SET_DEST_ADDR && io.roccCmd.inst.xs1) {
-    destAddr := io.roccCmd.rs1
-    currentDestAddr := io.roccCmd.rs1
+  when(io.configCmd.valid &&
+       configCmd.inst.funct === Instructions.SET_ROW_STRIDE && configCmd.inst.xs1 &&
+       configCmd.rs1 < 3.U) {
+    rowStrides(configCmd.rs1(1, 0)) := configCmd.rs2
     if(p(VCodePrintfEnable)) {
-      printf("Config\tSet destAddr to 0x%x\n", io.roccCmd.rs1)
+      printf("Config\tSet row stride %d to 0x%x\n", configCmd.rs1, configCmd.rs2)
     }
   }
 
-  when(io.cmdValid && io.ctrlSigs.legal &&
-       io.roccCmd.inst.funct === Instructions.SET_THIRD_OPERAND && io.roccCmd.inst.xs1) {
-    rs3 := io.roccCmd.rs1
-    currentRs3 := io.roccCmd.rs1
+  when(io.configCmd.valid &&
+       configCmd.inst.funct === Instructions.SET_ROW_LENGTH && configCmd.inst.xs1) {
+    rowLength := configCmd.rs1
     if(p(VCodePrintfEnable)) {
-      printf("Config\tSet rs3 to 0x%x\n", io.roccCmd.rs1)
+      printf("Config\tSet rowLength to 0x%x\n", configCmd.rs1)
     }
   }
 
+  when(io.configCmd.valid &&
+       configCmd.inst.funct === Instructions.SET_HEADER_MODE && configCmd.inst.xs1) {
+    headerMode := configCmd.rs1(0)
+    if(p(VCodePrintfEnable)) {
+      printf("Config\tSet headerMode to %d\n", configCmd.rs1(0))
+    }
+  }
+
+  when(io.loadConfig.valid) {
+    numOperands := io.loadConfig.bits.numOperands
+    operandsToGo := io.loadConfig.bits.numOperands
+    destAddr := io.loadConfig.bits.destAddr
+    currentDestAddr := io.loadConfig.bits.destAddr
+    rs3 := io.loadConfig.bits.rs3
+    currentRs3 := io.loadConfig.bits.rs3
+    elementWidth := io.loadConfig.bits.elementWidth
+    headerMode := io.loadConfig.bits.headerMode
+  }
+  io.config.numOperands := numOperands
+  // In header mode, the destination starts with its header, at destAddr.
+  io.config.destAddr := Mux(headerMode || destStaged || running, destAddr, currentDestAddr)
+  io.config.rs3 := Mux(rs3Staged || running, rs3, currentRs3)
+  io.config.elementWidth := elementWidth
+  io.config.contiguous := strides.map(_ === 1.U).reduce(_ && _) && rowLength === 0.U && !headerMode
+  io.config.headerMode := headerMode
+
+  /* Reductions kept in an accumulator do not write their result out. The
+   * float unit has no accumulators, so its reductions always write. */
+  val accumulating = accumulator =/= 0.U && !FloatUnit.isFloat(io.ctrlSigs.aluFn)
+
+  /** Set up the counters of an operation over vectors of n elements. */
+  def startVector(n: UInt): Unit = {
+    /* Packed boolean vectors hold 64 flags per word, and sub-word elements
+     * are packed 8/4/2 to a word. The rest of the accelerator only ever
+     * moves whole 64-bit words, so the operation only needs to process
+     * the words holding n elements. */
+    operandsToGo := MuxCase(n, Seq(
+      (io.ctrlSigs.boolPacking === BoolPacking.BOOL_PACKED) -> ((n + 63.U) >> 6),
+      subword -> (((n << elementWidth(1, 0)) + 7.U) >> 3),
+      // A merge of two n long vectors writes both of them out.
+      isMerge -> (n << 1),
+      isSingleElement -> 1.U))
+    outputLength := Mux(isMerge, n << 1, n)
+    mergeALeft := n; mergeBLeft := n
+    fetchToGo := n
+  }
+
   switch(accelState) {
     is(State.idle) {
       when(io.cmdValid && io.ctrlSigs.legal && io.ctrlSigs.isMemOp) {
-        accelState := State.fetch1
+        accelState := MuxCase(roundStartState, Seq(
+          respondsOnly -> State.respond,
+          readsHeader -> State.readHeader))
+        startVector(numOperands)
+        batchFetched := false.B
+        inFlight := 0.U; dispatchCluster := 0.U; writeCluster := 0.U
+        mergeStarted := false.B; mergeFromB := false.B
+        // Every operation starts at the first flag of a word.
+        roundCounter := 0.U
         // If we leave idle, we should grab the source addresses
         rs1 := io.roccCmd.rs1; rs2 := io.roccCmd.rs2
-        currentRs1 := io.roccCmd.rs1; currentRs2 := io.roccCmd.rs2;
+        // In header mode, the elements of vectors start after their header.
+        val vector1 = io.roccCmd.rs1 + Mux(headerMode && rs1IsVector, 8.U, 0.U)
+        val vector2 = io.roccCmd.rs2 + Mux(headerMode && rs2IsVector, 8.U, 0.U)
+        val destVector = Mux(headerMode && destIsVector, destAddr + 8.U,
+          Mux(destStaged, destAddr, currentDestAddr))
+        currentRs1 := Mux(isExtract, vector1 + (io.roccCmd.rs2 << 3), vector1)
+        currentRs2 := vector2
+        currentDestAddr := destVector
+        rowStarts(0) := vector1; rowStarts(1) := vector2
+        rowStarts(2) := destVector; colsToGo := rowLength
         /* NOTE: We do NOT set currentRs3 here because that particular memory
          * address needs to be given to us ahead-of-time through a control
-         * instruction! */
+         * instruction! Unless it was staged behind the last operation. */
+        when(rs3Staged) {
+          currentRs3 := rs3
+        }
         if(p(VCodePrintfEnable)) {
-          printf("Ctrl\tMoving from idle to fetch1 state\n")
+          printf("Ctrl\tMoving from idle to %d state\n", roundStartState.asUInt)
         }
       }
     }
@@ -156,7 +537,27 @@ class ControlUnit(val batchSize: Int)(implicit p: Parameters) extends CoreModule
         printf("Ctrl\tIn fetch1 state\n")
       }
       when(io.memOpCompleted) {
-        when(io.ctrlSigs.numMemFetches === NumOperatorOperands.MEM_OPS_TWO || io.ctrlSigs.numMemFetches === NumOperatorOperands.MEM_OPS_THREE) {
+        when(ALU.isCopy(io.ctrlSigs.aluFn)) {
+          // Copies have nothing to compute. Write the fetched data right back.
+          if(p(VCodePrintfEnable)) {
+            printf("Ctrl\tMoving from fetch1 to write state\n")
+          }
+          accelState := State.write
+        } .elsewhen(isExtract) {
+          // The fetched element is the response. There is nothing to write.
+          if(p(VCodePrintfEnable)) {
+            printf("Ctrl\tMoving from fetch1 to respond state\n")
+          }
+          accelState := State.respond
+        } .elsewhen(isMerge && mergeStarted) {
+          // Only the first round of a merge reads both vectors.
+          accelState := State.exe
+        } .elsewhen(fetchPair) {
+          if(p(VCodePrintfEnable)) {
+            printf("Ctrl\tFetched both operands. Moving from fetch1 to exe state\n")
+          }
+          accelState := State.exe
+        } .elsewhen(io.ctrlSigs.numMemFetches === NumOperatorOperands.MEM_OPS_TWO || io.ctrlSigs.numMemFetches === NumOperatorOperands.MEM_OPS_THREE) {
           if(p(VCodePrintfEnable)) {
             printf("Ctrl\tMoving from fetch1 to fetch2 state\n")
           }
@@ -181,6 +582,8 @@ class ControlUnit(val batchSize: Int)(implicit p: Parameters) extends CoreModule
           accelState := State.fetch3
         } .otherwise{
           accelState := State.exe
+          // All clustered operations take two operands, so their batch is now in.
+          batchFetched := clustered
           if(p(VCodePrintfEnable)) {
             printf("Ctrl\tMoving from fetch2 to exe state\n")
           }
@@ -203,31 +606,68 @@ class ControlUnit(val batchSize: Int)(implicit p: Parameters) extends CoreModule
         printf("Ctrl\tIn execution state\n")
       }
 
-      when (io.executeCompleted) {
+      when(clustered) {
+        /* Hand the fetched batch to the next cluster if it is free. Otherwise
+         * write the oldest batch back once its cluster is done, or fetch the
+         * next batch while the clusters are busy. */
+        val clusterFree = inFlight < numClusters.U
+        when(batchFetched && clusterFree) {
+          io.clusterDispatch := true.B
+          batchFetched := false.B
+          fetchToGo := Mux(fetchToGo <= batchSize.U, 0.U, fetchToGo - batchSize.U)
+          currentRs1 := advance(0, currentRs1, batchSize.U)
+          currentRs2 := advance(1, currentRs2, batchSize.U)
+          dispatchCluster := nextCluster(dispatchCluster)
+          inFlight := inFlight + 1.U
+        } .elsewhen(inFlight > 0.U && io.writeClusterDone) {
+          accelState := State.write
+        } .elsewhen(!batchFetched && fetchToGo > 0.U && clusterFree) {
+          accelState := State.fetch1
+        }
+      } .elsewhen (io.executeCompleted) {
         // Where to go once in EXE?
-        when(io.ctrlSigs.aluFn === ALU.FN_RED_ADD ||
-           io.ctrlSigs.aluFn === ALU.FN_RED_MUL ||
-           io.ctrlSigs.aluFn === ALU.FN_RED_MAX ||
-           io.ctrlSigs.aluFn === ALU.FN_RED_MIN ||
-           io.ctrlSigs.aluFn === ALU.FN_RED_AND ||
-           io.ctrlSigs.aluFn === ALU.FN_RED_OR ||
-           io.ctrlSigs.aluFn === ALU.FN_RED_XOR) {
+        when(isReduction) {
           // If this operation is a reduction, we may need to go around again
           // FIXME: Turn this into a function?
           // Decrement our "counter"
-          val remainingOperands = Mux(operandsToGo <= batchSize.U, 0.U, operandsToGo - batchSize.U)
+          val remainingOperands = operandsToGo - roundElements
           operandsToGo := remainingOperands
           when(remainingOperands > 0.U) {
             // We have not yet completed the reduction, go back.
             accelState := State.fetch1
-            // Multiply address by 8 because all values use 64 bits
-            currentRs1 := currentRs1 + (batchSize * 8).U
-            currentRs2 := currentRs2 + (batchSize * 8).U
+            currentRs1 := advance(0, currentRs1, roundLanes)
+            currentRs2 := advance(1, currentRs2, roundLanes)
+            nextRound()
           } .otherwise {
-            /* The reduction's computation is complete, write exactly 1 value. */
-            accelState := State.write
+            /* The reduction's computation is complete, write exactly 1 value,
+             * unless it stays in an accumulator. */
+            accelState := Mux(accumulating, State.respond, State.write)
             operandsToGo := 1.U
           }
+        } .elsewhen(io.ctrlSigs.aluFn === PermuteUnit.FN_HISTOGRAM) {
+          /* A histogram only fills the permute unit's counters. Nothing is
+           * written back to memory. */
+          val remainingOperands = Mux(operandsToGo <= batchSize.U, 0.U, operandsToGo - batchSize.U)
+          operandsToGo := remainingOperands
+          currentRs1 := currentRs1 + (batchSize * 8).U
+          accelState := Mux(remainingOperands > 0.U, State.fetch1, State.respond)
+        } .elsewhen(packResult) {
+          /* Packed comparisons only write once a word of flags is full, or
+           * the vector has run out. roundCounter tracks how many batches are
+           * in the current word, the same way SELECT uses it for reading. */
+          val remainingOperands = Mux(operandsToGo <= batchSize.U, 0.U, operandsToGo - batchSize.U)
+          operandsToGo := remainingOperands
+          currentRs1 := currentRs1 + (batchSize * 8).U
+          currentRs2 := currentRs2 + (batchSize * 8).U
+          packedWords := (if (flagWords == 1) 1.U
+            else (Mux(operandsToGo >= batchSize.U, batchSize.U, operandsToGo) + 63.U) >> 6)
+          when(roundCounter >= (roundsPerWord - 1).U || remainingOperands === 0.U) {
+            roundCounter := 0.U
+            accelState := State.write
+          } .otherwise {
+            roundCounter := roundCounter + 1.U
+            accelState := State.fetch1
+          }
         } .otherwise {
           // Execution completed, but this is NOT a reduction
           accelState := State.write
@@ -241,39 +681,89 @@ class ControlUnit(val batchSize: Int)(implicit p: Parameters) extends CoreModule
       if(p(VCodePrintfEnable)) {
         printf("Ctrl\tExecution done. Writeback results\n")
       }
-      when(io.memOpCompleted) {
+      when(io.memOpCompleted && packResult) {
+        /* The packed flags were written. The source addresses and operand
+         * count already moved forward in the exe state. */
+        currentDestAddr := currentDestAddr + (packedWords << 3)
+        accelState := Mux(operandsToGo > 0.U, State.fetch1, finishState)
+      } .elsewhen(io.memOpCompleted && clustered) {
+        /* The oldest batch in flight was written. The source addresses moved
+         * forward when its batch was dispatched. */
+        val remainingOperands = Mux(operandsToGo <= batchSize.U, 0.U, operandsToGo - batchSize.U)
+        operandsToGo := remainingOperands
+        currentDestAddr := advance(2, currentDestAddr, batchSize.U)
+        writeCluster := nextCluster(writeCluster)
+        inFlight := inFlight - 1.U
+        accelState := Mux(remainingOperands > 0.U, State.exe, finishState)
+      } .elsewhen(io.memOpCompleted) {
         when(io.ctrlSigs.aluFn === ALU.FN_SELECT) {
-          when(roundCounter >= (64/batchSize - 1).U) {
+          when(roundCounter >= (roundsPerWord - 1).U) {
             roundCounter := 0.U
-            currentRs3 := currentRs3 + 8.U
+            currentRs3 := currentRs3 + (flagWords * 8).U
           } .otherwise {
             roundCounter := roundCounter + 1.U
           }
         }
         // Decrement our "counter"
-        val remainingOperands = Mux(operandsToGo <= batchSize.U, 0.U, operandsToGo - batchSize.U)
+        val remainingOperands = operandsToGo - roundElements
         operandsToGo := remainingOperands
         when(remainingOperands > 0.U) {
           // We have not yet completed the vector, go back.
-          accelState := State.fetch1
-          // Multiply address by 8 because all values use 64 bits
-          currentRs1 := currentRs1 + (batchSize * 8).U
-          currentRs2 := currentRs2 + (batchSize * 8).U
-          /* Permute instructions are weird and keep their base address the
-           * same throughout their entire execution. All other instructions move
-           * their destination address forward. */
-          when (io.ctrlSigs.aluFn =/= PermuteUnit.FN_PERMUTE) {
-            currentDestAddr := currentDestAddr + (batchSize * 8).U
+          accelState := roundStartState
+          currentRs1 := Mux(isStrided, currentRs1 + (rs2 << log2Ceil(batchSize * 8)),
+            advance(0, currentRs1, roundLanes))
+          currentRs2 := advance(1, currentRs2, roundLanes)
+          nextRound()
+          /* Permute instructions (and RANK) are weird and keep their base
+           * address the same throughout their entire execution. All other
+           * instructions move their destination address forward. */
+          when (!PermuteUnit.isScatter(io.ctrlSigs.aluFn)) {
+            currentDestAddr := advance(2, currentDestAddr, roundLanes)
+          }
+          when (isMerge) {
+            /* Only move forward through the vector(s) the batch just merged
+             * came from. Once both are used up, the carry is written out
+             * without fetching anything. */
+            val takenA = Mux(mergeStarted && mergeFromB, 0.U, mergeFetchA)
+            val takenB = Mux(!mergeStarted || mergeFromB, mergeFetchB, 0.U)
+            val aLeft = Mux(io.mergeFlush, 0.U, mergeALeft - takenA)
+            val bLeft = Mux(io.mergeFlush, 0.U, mergeBLeft - takenB)
+            mergeALeft := aLeft; mergeBLeft := bLeft
+            currentRs1 := currentRs1 + (takenA << 3)
+            currentRs2 := currentRs2 + (takenB << 3)
+            mergeStarted := true.B
+            mergeFromB := Mux(aLeft === 0.U, true.B, Mux(bLeft === 0.U, false.B, io.mergeNextFromB))
+            accelState := Mux(aLeft === 0.U && bLeft === 0.U, State.exe, State.fetch1)
           }
         } .otherwise {
           // We have finished processing the vector. Move onwards.
-          accelState := State.respond
+          accelState := finishState
           if(p(VCodePrintfEnable)) {
             printf("Ctrl\tWriteback completed. Accelerator must respond to main core\n")
           }
         }
       }
     }
+    is(State.readHeader) {
+      if(p(VCodePrintfEnable)) {
+        printf("Ctrl\tIn readHeader state\n")
+      }
+      when(io.memOpCompleted) {
+        startVector(io.headerLength)
+        accelState := roundStartState
+        if(p(VCodePrintfEnable)) {
+          printf("Ctrl\tRead vector length %d from header\n", io.headerLength)
+        }
+      }
+    }
+    is(State.writeHeader) {
+      when(io.memOpCompleted) {
+        accelState := State.respond
+        if(p(VCodePrintfEnable)) {
+          printf("Ctrl\tWrote output length %d to header\n", outputLength)
+        }
+      }
+    }
     is(State.respond) {
       if(p(VCodePrintfEnable)) {
         printf("Ctrl\tWriteback done. Accelerator responding\n")
@@ -286,4 +776,19 @@ class ControlUnit(val batchSize: Int)(implicit p: Parameters) extends CoreModule
       }
     }
   }
+
+  /* Staged settings are taken up by the next operation to start. One staged
+   * in the very cycle an operation starts is left for the operation after. */
+  val setsDest = io.configCmd.valid && configCmd.inst.funct === Instructions.SET_DEST_ADDR && configCmd.inst.xs1
+  val setsRs3 = io.configCmd.valid && configCmd.inst.funct === Instructions.SET_THIRD_OPERAND && configCmd.inst.xs1
+  when(starting) {
+    destStaged := false.B
+    rs3Staged := false.B
+  }
+  when(setsDest) {
+    destStaged := running
+  }
+  when(setsRs3) {
+    rs3Staged := running
+  }
 }
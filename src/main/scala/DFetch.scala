@@ -21,11 +21,55 @@ object MemoryOperation extends ChiselEnum {
   val read, write = Value
 }
 
+/** An element together with the address it belongs at. Only the permute path
+  * needs this, because it scatters elements all over the destination. */
 class DataIO(xLen: Int) extends Bundle {
   val addr = Bits(xLen.W)
   val data = Bits(xLen.W)
 }
 
+/** A batch of elements from consecutive elements of a vector. Addresses are
+  * not stored, the address of each lane is generated when it is needed.
+  * Lanes with their mask bit clear are past the end of the vector.
+  */
+class Batch(xLen: Int, batchSize: Int) extends Bundle {
+  val mask = UInt(batchSize.W)
+  val data = Vec(batchSize, UInt(xLen.W))
+}
+
+/** Address-generation unit for batches.
+  * Generates the address of a single lane of the batch starting at base, and
+  * the mask of lanes holding one of the count elements of the batch.
+  *
+  * A paired batch holds two vectors of count elements, the one at base in the
+  * lower half of the lanes and the one at pairBase in the upper half. Its
+  * requests go through the first vector, then the second.
+  */
+class AddressGen(xLen: Int, batchSize: Int) extends Module {
+  val io = IO(new Bundle {
+    val base = Input(UInt(xLen.W))
+    /** Distance in bytes between the elements of two consecutive lanes. */
+    val stride = Input(UInt(xLen.W))
+    val pair = Input(Bool())
+    val pairBase = Input(UInt(xLen.W))
+    /** Index of the request to generate the address of. */
+    val lane = Input(UInt(log2Up(batchSize + 1).W))
+    val count = Input(UInt(xLen.W))
+    val addr = Output(UInt(xLen.W))
+    /** Lane of the batch the request's element goes in. */
+    val bufferLane = Output(UInt(log2Up(batchSize).W))
+    val mask = Output(UInt(batchSize.W))
+  })
+
+  val half = batchSize / 2
+  val inPair = io.pair && io.lane >= io.count
+  val index = Mux(inPair, io.lane - io.count, io.lane)
+  io.addr := Mux(inPair, io.pairBase, io.base) + (index * io.stride)
+  io.bufferLane := Mux(inPair, index + half.U, index)
+  io.mask := VecInit((0 until batchSize).map(i => i.U < io.count ||
+    (if (i >= half) io.pair && (i - half).U < io.count else false.B))).asUInt
+}
+
 /** Module connecting VCode accelerator to main processor's non-blocking L1 data
   * cache.
   *
@@ -39,6 +83,10 @@ class DataIO(xLen: Int) extends Bundle {
   * @param bufferEntries Ceiling of the number of elements to batch together
   *        before returning data to another component. Total size is
   *        bufferEntries * XLen.
+  * @param scatter Write every element to its own address, given by
+  *        writeAddrs, instead of to consecutive words.
+  * @param maxInFlight Most memory requests that may be outstanding at once.
+  *        Must fit in the L1 data cache's request tags.
   * @param p Implicit parameter passed by build system of top-level design parameters.
   *
   * freechips.rocketchip.rocket.constants.MemoryOpConstants provides named bit
@@ -50,20 +98,30 @@ class DataIO(xLen: Int) extends Bundle {
   * implement, but will generally have lower achievable throughput than a dedicated
   * TileLink port.
   */
-class DCacheFetcher(val bufferEntries: Int)(implicit p: Parameters) extends CoreModule()(p)
+class DCacheFetcher(val bufferEntries: Int, val scatter: Boolean = false,
+  val maxInFlight: Int = 32)(implicit p: Parameters) extends CoreModule()(p)
     with MemoryOpConstants {
+  require(isPow2(bufferEntries) && isPow2(maxInFlight),
+    "DCacheFetcher bufferEntries & maxInFlight must be powers of 2!")
   /* For now, we only support "raw" loading and storing.
    * Only using M_XRD and M_XWR */
   val io = IO(new Bundle {
     val ctrlSigs = Input(new CtrlSigs(xLen))
     /** The base address from which to operate on (load from/store to). */
     val baseAddress = Flipped(Decoupled(Bits(xLen.W)))
+    /** Read a second vector from this address into the upper half of the
+      * batch. amountData then counts the elements of both vectors. */
+    val pairAddress = Input(Valid(UInt(xLen.W)))
     val mstatus = Input(new MStatus)
+    /** Distance in bytes between two consecutive elements to read. */
+    val stride = Input(UInt(xLen.W))
     val opToPerform = Input(MemoryOperation()) // NOTE: The () is important!
     // Actual Data outputs
     // fetched_data is only of interest if a read was performed
-    val fetchedData = Output(Valid(Vec(bufferEntries, new DataIO(xLen))))
-    val dataToWrite = Input(Valid(Vec(bufferEntries, new DataIO(xLen))))
+    val fetchedData = Output(Valid(new Batch(xLen, bufferEntries)))
+    val dataToWrite = Input(Valid(Vec(bufferEntries, UInt(xLen.W))))
+    /** Address of every element of dataToWrite, when scattering. */
+    val writeAddrs = if (scatter) Some(Input(Vec(bufferEntries, UInt(xLen.W)))) else None
     /** Flag to tell DCacheFetcher to start loading/storing from/to memory. */
     val start = Input(Bool())
     /** The number of elements to fetch. */
@@ -72,6 +130,12 @@ class DCacheFetcher(val bufferEntries: Int)(implicit p: Parameters) extends Core
     val opCompleted = Output(Bool())
     val req = Decoupled(new HellaCacheReq)
     val resp = Input(Valid(new HellaCacheResp))
+    /** Cycles from each load's request being sent to its response arriving,
+      * valid for one cycle per response. For the performance counters. */
+    val loadLatency = Output(Valid(UInt(PerfCounters.LATENCY_BITS.W)))
+    /** Number of tags waiting on a response, and whether all of them are. */
+    val occupancy = Output(UInt(log2Up(maxInFlight + 1).W))
+    val tagsFull = Output(Bool())
   })
 
   /* The amount of data this module can handle in one round of fetching must
@@ -89,41 +153,55 @@ class DCacheFetcher(val bufferEntries: Int)(implicit p: Parameters) extends Core
   val state = RegInit(State.idle)
 
   // NOTE: 0.U implies a 1-bit unsigned integer. Need to explicitly state width
-  /* log2Up(bufferEntries)+1.W means amountFetched is exactly big enough to count
-   * bufferEntries number of elements and NOT wrap around. */
+  /* Both counters count from 0 up to and including bufferEntries, the most
+   * elements a single operation can handle. */
   // Number of requests that have been fulfilled.
-  val amountFetched = RegInit(0.U((log2Up(bufferEntries)+1).W))
-  /* Number of requests that have been sent.
-   * log2Down(bufferEntries)+1.@ means reqsSent can count PAST bufferEntries
-   * number of elements, allowing us to terminate the fetch cycle by detecting
-   * when we have submitted as many requests as we can.
-   *
-   * If bufferEntries = 8, then we must count 0 to 7 (to assign unique tags).
-   * This means we need 3 bits to perform this counting. But we RELY on counting
-   * one past the limit, to detect when we cannot submit any more requests. Hence,
-   * we actually count 0 to 8, requiring 4 (3+1) bits.
-   *
-   * FIXME: This should be an EXACT value, not a deliberate off-by-one.
-   * [W004] Dynamic index with width 2 is too wide for Vec of size 2 (expected
-   * index width 1). */
-  val reqsSent = RegInit(0.U((log2Down(bufferEntries)+1).W))
+  val amountFetched = RegInit(0.U(log2Up(bufferEntries + 1).W))
+  // Number of requests that have been sent. Also the lane the next request is for.
+  val reqsSent = RegInit(0.U(log2Up(bufferEntries + 1).W))
+
+  /* Only maxInFlight requests may be outstanding at once, because every one
+   * needs its own tag. Tags are handed out round-robin, and each remembers
+   * which lane its response belongs in. */
+  val inFlight = math.min(bufferEntries, maxInFlight)
+  val laneOfTag = Reg(Vec(inFlight, UInt(log2Up(bufferEntries).W)))
 
   val vals = withReset(state === State.idle) {
-    RegInit((0.U).asTypeOf(Vec(bufferEntries, new DataIO(xLen))))
+    RegInit(VecInit(Seq.fill(bufferEntries)(0.U(xLen.W))))
   }
 
-  val waitForResp = RegInit(VecInit.fill(bufferEntries)(false.B))
+  val waitForResp = RegInit(VecInit.fill(inFlight)(false.B))
   val allDone = Wire(Bool()); allDone := !(waitForResp.reduce(_ || _))
+  io.occupancy := PopCount(waitForResp)
+  io.tagsFull := waitForResp.asUInt.andR
+
+  /* Each tag also remembers when its request was sent. The clock wraps, but
+   * only has to tell apart latencies up to the histogram's last bucket. */
+  val now = RegInit(0.U(PerfCounters.LATENCY_BITS.W))
+  now := now + 1.U
+  val sentAt = Reg(Vec(inFlight, UInt(PerfCounters.LATENCY_BITS.W)))
+  val respAccepted = WireDefault(false.B)
+  io.loadLatency.valid := respAccepted && io.opToPerform === MemoryOperation.read
+  io.loadLatency.bits := now - sentAt(io.resp.bits.tag)
 
   // Operation completed when running & requests fulfilled >= amount of data requested
   io.opCompleted := (state === State.running) && (amountFetched >= io.amountData)
   // We can accept a new base address when we are idle.
   io.baseAddress.ready := (state === State.idle)
 
+  val tag = if (inFlight > 1) reqsSent(log2Ceil(inFlight) - 1, 0) else 0.U
+  val agu = Module(new AddressGen(xLen, bufferEntries))
+  agu.io.base := io.baseAddress.bits
+  agu.io.stride := io.stride
+  agu.io.lane := reqsSent
+  agu.io.pair := io.pairAddress.valid && io.opToPerform === MemoryOperation.read
+  agu.io.pairBase := io.pairAddress.bits
+  agu.io.count := Mux(agu.io.pair, io.amountData >> 1, io.amountData)
+
   io.fetchedData.valid := allDone
-  io.fetchedData.bits := vals
+  io.fetchedData.bits.mask := agu.io.mask
+  io.fetchedData.bits.data := vals
 
-  val tag = reqsSent
   io.req.bits.tag := tag
   // I am not a fan of the comparator here... But c'est la vie.
   val shouldSendRequest = io.start && !waitForResp(tag) && (reqsSent < io.amountData)
@@ -136,13 +214,13 @@ class DCacheFetcher(val bufferEntries: Int)(implicit p: Parameters) extends Core
   io.req.bits.cmd := DontCare
   switch (io.opToPerform) {
     is (MemoryOperation.read) {
-      io.req.bits.addr := io.baseAddress.bits + (reqsSent * 8.U)
+      io.req.bits.addr := agu.io.addr
       io.req.bits.data := 0.U // Does not matter what data is set to for reads
       io.req.bits.cmd := M_XRD
     }
     is (MemoryOperation.write) {
-      io.req.bits.addr := io.dataToWrite.bits(tag).addr
-      io.req.bits.data := io.dataToWrite.bits(tag).data
+      io.req.bits.addr := io.writeAddrs.map(_(reqsSent)).getOrElse(agu.io.addr)
+      io.req.bits.data := io.dataToWrite.bits(reqsSent)
       io.req.bits.cmd := M_XWR
     }
   }
@@ -190,12 +268,13 @@ class DCacheFetcher(val bufferEntries: Int)(implicit p: Parameters) extends Core
             printf("DFetch\tGot cache response for tag 0x%x!\n", io.resp.bits.tag)
             printf("DFetch\tTag 0x%x data: 0x%x\n", io.resp.bits.tag, io.resp.bits.data)
           }
-          vals(io.resp.bits.tag).data := io.resp.bits.data
+          vals(laneOfTag(io.resp.bits.tag)) := io.resp.bits.data
           when(waitForResp(io.resp.bits.tag)) {
             // If we were waiting for a response on this tag, and we now have
             // that tags response, then we increase the amount we fetch.
             amountFetched := amountFetched + 1.U
             waitForResp(io.resp.bits.tag) := false.B
+            respAccepted := true.B
             if(p(VCodePrintfEnable)) {
               printf("DFetch\tMarking tag 0x%x as done\n", io.resp.bits.tag)
               printf("DFetch\tamount_fetched: %d\tdata: 0x%x\n", amountFetched + 1.U, io.resp.bits.data)
@@ -222,6 +301,8 @@ class DCacheFetcher(val bufferEntries: Int)(implicit p: Parameters) extends Core
             // When our request is sent, we must increment number of requests made
             reqsSent := reqsSent + 1.U
             waitForResp(tag) := true.B
+            laneOfTag(tag) := agu.io.bufferLane
+            sentAt(tag) := now
             if(p(VCodePrintfEnable)) {
               printf("DFetch\tMarked tag 0x%x (request tag 0x%x) as busy\n", tag, io.req.bits.tag)
             }
@@ -4,6 +4,7 @@ import chisel3._
 import chisel3.util._
 import freechips.rocketchip.tile.{RoCCInstruction, TileKey}
 import org.chipsalliance.cde.config.Parameters
+import vcoderocc.constants._
 
 class Decoder(implicit p: Parameters) extends Module {
   val xLen = p(TileKey).core.xLen
@@ -11,6 +12,8 @@ class Decoder(implicit p: Parameters) extends Module {
   val io = IO(new Bundle {
     val roccInst = Input(new RoCCInstruction())
     val ctrlSigs = Output(new CtrlSigs(xLen))
+    /** The element width set with SET_ELEMENT_WIDTH, as an MTxx encoding. */
+    val elementWidth = Input(UInt(3.W))
   })
 
   /* Create the decode table at the top-level of the implementation
@@ -22,5 +25,17 @@ class Decoder(implicit p: Parameters) extends Module {
    * DECODE
    **************/
   // Decode instruction, yielding control signals
-  io.ctrlSigs := Wire(new CtrlSigs(xLen)).decode(io.roccInst.funct, decodeTable)
+  val sigs = Wire(new CtrlSigs(xLen)).decode(io.roccInst.funct, decodeTable)
+  io.ctrlSigs := sigs
+
+  /* Only the sub-word operations understand narrow elements. Any other
+   * operation on vectors would take a narrow vector for numOperands 64-bit
+   * words and run past its end, so it is illegal while the width is narrow.
+   * Instructions that only respond or drain the trace buffer touch no vectors. */
+  val fn = sigs.aluFn
+  val touchesVectors = sigs.isMemOp && !(fn === ALU.FN_READ_ACCUMULATOR ||
+    fn === PerfCounters.FN_READ_COUNTER || fn === TraceBuffer.FN_DRAIN_TRACE)
+  when(io.elementWidth =/= MT64.value.U && touchesVectors && !ALU.supportsSubword(fn)) {
+    io.ctrlSigs.legal := false.B
+  }
 }
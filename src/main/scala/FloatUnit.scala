@@ -0,0 +1,371 @@
+package vcoderocc
+
+import chisel3._
+import chisel3.util._
+
+/** Externally-visible properties of the floating-point unit.
+  * The function codes share the same space as the ALU's, so they must never
+  * overlap with them.
+  */
+object FloatUnit {
+  val SZ_FLOAT_FN = 7
+
+  def FN_FADD = BitPat(48.U(SZ_FLOAT_FN.W))
+  def FN_FSUB = BitPat(49.U(SZ_FLOAT_FN.W))
+  def FN_FMUL = BitPat(50.U(SZ_FLOAT_FN.W))
+  def FN_FDIV = BitPat(51.U(SZ_FLOAT_FN.W))
+  def FN_FSQRT = BitPat(52.U(SZ_FLOAT_FN.W))
+  def FN_FLESS = BitPat(53.U(SZ_FLOAT_FN.W))
+  def FN_FLESS_EQUAL = BitPat(54.U(SZ_FLOAT_FN.W))
+  def FN_FGREATER = BitPat(55.U(SZ_FLOAT_FN.W))
+  def FN_FGREATER_EQUAL = BitPat(56.U(SZ_FLOAT_FN.W))
+  def FN_FEQUAL = BitPat(57.U(SZ_FLOAT_FN.W))
+  def FN_FUNEQUAL = BitPat(58.U(SZ_FLOAT_FN.W))
+  def FN_RED_FADD = BitPat(59.U(SZ_FLOAT_FN.W))
+  def FN_RED_FMUL = BitPat(60.U(SZ_FLOAT_FN.W))
+  def FN_SCAN_FADD = BitPat(61.U(SZ_FLOAT_FN.W))
+  def FN_INT_TO_FLOAT = BitPat(62.U(SZ_FLOAT_FN.W))
+  def FN_FLOAT_TO_INT = BitPat(63.U(SZ_FLOAT_FN.W))
+  // 64 is taken by ALU.FN_DOT
+  def FN_FDOT = BitPat(65.U(SZ_FLOAT_FN.W))
+
+  /** Is this function handled by the floating-point unit? */
+  def isFloat(fn: UInt): Bool =
+    (fn >= FN_FADD.value.U && fn <= FN_FLOAT_TO_INT.value.U) || fn === FN_FDOT
+
+  /** IEEE 754 double-precision exponent & significand widths. VCODE's floats
+    * are all doubles, so these are the only ones we need. */
+  val expWidth = 11
+  val sigWidth = 53
+}
+
+/** Vector floating-point unit built from Berkeley HardFloat units.
+  *
+  * Every lane has a fused multiply-add unit, which performs addition,
+  * subtraction and multiplication, an iterative divide/square-root unit, a
+  * comparator, and integer/float converters. HardFloat works on "recoded"
+  * floats, which are one bit wider than the IEEE encoding, so all operands are
+  * recoded on the way in and converted back on the way out.
+  *
+  * Reductions and scans run through the lanes' FMA units as a tree, so a
+  * batch takes log2(batchSize) trips through the FMA pipeline rather than
+  * batchSize of them.
+  *
+  * @param fmaLatency Number of pipeline stages after each FMA unit.
+  */
+class FloatUnit(val xLen: Int)(val batchSize: Int, val fmaLatency: Int = 3) extends Module {
+  import FloatUnit._
+  require(xLen == 64, "FloatUnit only supports double-precision (64-bit) floats!")
+
+  val io = IO(new Bundle {
+    val fn = Input(Bits(SZ_FLOAT_FN.W))
+    val in1 = Input(Vec(batchSize, UInt(xLen.W)))
+    val in2 = Input(Vec(batchSize, UInt(xLen.W)))
+    val identityVal = Input(Bits(xLen.W))
+    val out = Output(Valid(Vec(batchSize, UInt(xLen.W))))
+    val execute = Input(Bool())
+    val accelIdle = Input(Bool())
+  })
+
+  def recode(x: UInt): UInt = hardfloat.recFNFromFN(expWidth, sigWidth, x)
+  def ieee(x: UInt): UInt = hardfloat.fNFromRecFN(expWidth, sigWidth, x)
+
+  val recodedOne = recode("h3FF0000000000000".U(xLen.W))
+  /* Adding -0.0 leaves every value, including +0.0, unchanged. */
+  val recodedNegZero = recode("h8000000000000000".U(xLen.W))
+
+  val workingSpace = withReset(io.accelIdle) {
+    RegInit(VecInit(Seq.fill(batchSize)(0.U(xLen.W))))
+  }
+  io.out.bits := workingSpace
+  io.out.valid := false.B
+
+  val lastBatchResult = workingSpace(0)
+
+  val identity = withReset(io.accelIdle) {
+    RegInit(io.identityVal)
+  }
+
+  // See the ALU for why this is built this way.
+  val pipelineStart = withReset(!io.execute) {
+    io.execute && !RegNext(io.execute)
+  }
+
+  val recIn1 = VecInit(io.in1.map(x => recode(x)))
+  val recIn2 = VecInit(io.in2.map(x => recode(x)))
+
+  /* The FMA bank computes (a * b) + c. Addition is done as (a * 1.0) + c and
+   * multiplication as (a * b) + (signed 0). op(0) negates c, giving subtraction.
+   * These wires are driven by the current function below. */
+  val fmaValid = WireInit(VecInit(Seq.fill(batchSize)(false.B)))
+  val fmaA = Wire(Vec(batchSize, UInt((xLen + 1).W)))
+  val fmaB = Wire(Vec(batchSize, UInt((xLen + 1).W)))
+  val fmaC = Wire(Vec(batchSize, UInt((xLen + 1).W)))
+  val fmaOp = WireInit(VecInit(Seq.fill(batchSize)(0.U(2.W))))
+  fmaA := recIn1
+  fmaB := VecInit(Seq.fill(batchSize)(recodedOne))
+  fmaC := recIn2
+
+  val fmaResp = for (i <- 0 until batchSize) yield {
+    val fma = Module(new hardfloat.MulAddRecFN(expWidth, sigWidth))
+    fma.io.op := fmaOp(i)
+    fma.io.a := fmaA(i)
+    fma.io.b := fmaB(i)
+    fma.io.c := fmaC(i)
+    fma.io.roundingMode := hardfloat.consts.round_near_even
+    fma.io.detectTininess := hardfloat.consts.tininess_afterRounding
+    /* HardFloat's FMA is purely combinational. Synthesis retimes these
+     * registers into it, the same way Rocket's FPU pipelines its FMA. */
+    Pipe(fmaValid(i), fma.io.out, fmaLatency)
+  }
+
+  /** Send x & y to lane i's FMA unit to be added (or multiplied). */
+  def fmaIssue(i: Int, x: UInt, y: UInt, multiply: Boolean): Unit = {
+    fmaA(i) := x
+    if (multiply) {
+      fmaB(i) := y
+      // A zero with the sign of the product keeps (-x * +0) = -0.
+      fmaC(i) := (x ^ y) & (BigInt(1) << xLen).U
+    } else {
+      fmaB(i) := recodedOne
+      fmaC(i) := y
+    }
+  }
+
+  /* The divide/square-root units are iterative and, for special values, can
+   * finish early. Each lane remembers whether it has produced its result. */
+  val divSqrtDone = withReset(!io.execute) {
+    RegInit(VecInit(Seq.fill(batchSize)(false.B)))
+  }
+  val divSqrtBank = for (i <- 0 until batchSize) yield {
+    val divSqrt = Module(new hardfloat.DivSqrtRecFN_small(expWidth, sigWidth, 0))
+    divSqrt.io.inValid := false.B
+    divSqrt.io.sqrtOp := false.B
+    divSqrt.io.a := recIn1(i)
+    divSqrt.io.b := recIn2(i)
+    divSqrt.io.roundingMode := hardfloat.consts.round_near_even
+    divSqrt.io.detectTininess := hardfloat.consts.tininess_afterRounding
+    divSqrt
+  }
+
+  val compareBank = for (i <- 0 until batchSize) yield {
+    val comparator = Module(new hardfloat.CompareRecFN(expWidth, sigWidth))
+    comparator.io.a := recIn1(i)
+    comparator.io.b := recIn2(i)
+    comparator.io.signaling := false.B
+    comparator
+  }
+
+  val toFloatBank = for (i <- 0 until batchSize) yield {
+    val convert = Module(new hardfloat.INToRecFN(xLen, expWidth, sigWidth))
+    convert.io.signedIn := true.B
+    convert.io.in := io.in1(i)
+    convert.io.roundingMode := hardfloat.consts.round_near_even
+    convert.io.detectTininess := hardfloat.consts.tininess_afterRounding
+    convert
+  }
+
+  val toIntBank = for (i <- 0 until batchSize) yield {
+    val convert = Module(new hardfloat.RecFNToIN(expWidth, sigWidth, xLen))
+    convert.io.in := recIn1(i)
+    // Truncate towards zero, like C's casts.
+    convert.io.roundingMode := hardfloat.consts.round_minMag
+    convert.io.signedOut := true.B
+    convert
+  }
+
+  /** Perform an element-wise operation that completes in the same clock
+    * cycle. */
+  def elementWiseMap(op: Int => UInt): Unit = {
+    for (i <- 0 until batchSize) {
+      workingSpace(i) := op(i)
+    }
+    io.out.valid := true.B
+  }
+
+  /** Perform an element-wise operation through the FMA bank. */
+  def fmaMap(op: UInt, multiply: Boolean): Unit = {
+    for (i <- 0 until batchSize) {
+      fmaValid(i) := pipelineStart
+      fmaOp(i) := op
+      fmaIssue(i, recIn1(i), recIn2(i), multiply)
+      workingSpace(i) := ieee(fmaResp(i).bits)
+    }
+    // Every lane was issued together, so they all finish together.
+    io.out.valid := fmaResp(0).valid
+  }
+
+  /** Perform an element-wise operation through the divide/square-root bank. */
+  def divSqrtMap(sqrt: Boolean): Unit = {
+    for (i <- 0 until batchSize) {
+      val divSqrt = divSqrtBank(i)
+      divSqrt.io.inValid := pipelineStart
+      divSqrt.io.sqrtOp := sqrt.B
+      when(divSqrt.io.outValid_div || divSqrt.io.outValid_sqrt) {
+        divSqrtDone(i) := true.B
+        workingSpace(i) := ieee(divSqrt.io.out)
+      }
+    }
+    io.out.valid := divSqrtDone.asUInt.andR
+  }
+
+  /* Reductions and scans pass through the FMA bank once per level of their
+   * tree. treeStage counts the levels that have completed. */
+  val treeLevels = log2Ceil(batchSize)
+  val treeStage = withReset(!io.execute) {
+    RegInit(0.U(log2Ceil(treeLevels + 2).W))
+  }
+  /* All lanes of a level are issued together, so lane 0's response marks the
+   * end of a level. Results are issued into the next level as they arrive. */
+  val levelDone = fmaResp(0).valid
+  when(io.execute && levelDone) {
+    treeStage := treeStage + 1.U
+  }
+  val issuingStage = Mux(levelDone, treeStage + 1.U, 0.U)
+
+  /** Reduce a batch as a binary tree, then combine it with the running
+    * identity. Level k pairs up the results of level k-1 into the lower half
+    * of the lanes.
+    *
+    * @param products Multiply in1 & in2 lane-wise as the first level and sum
+    * the products, for a dot product. */
+  def treeReduce(multiply: Boolean, products: Boolean = false): Unit = {
+    val levels = if (products) treeLevels + 1 else treeLevels
+    for (i <- 0 until batchSize) {
+      val (x, y) = if (2*i + 1 < batchSize) {
+        (Mux(levelDone, fmaResp(2*i).bits, recIn1(2*i)),
+          Mux(levelDone, fmaResp(2*i + 1).bits, recIn1(2*i + 1)))
+      } else {
+        // This lane never takes part in the tree. Its results are ignored.
+        (recIn1(i), recIn1(i))
+      }
+      fmaValid(i) := pipelineStart || (levelDone && treeStage < levels.U)
+      if (products) {
+        when(pipelineStart) {
+          fmaIssue(i, recIn1(i), recIn2(i), true)
+        } .otherwise {
+          fmaIssue(i, x, y, multiply)
+        }
+      } else {
+        fmaIssue(i, x, y, multiply)
+      }
+    }
+    /* The last trip through the FMA combines the whole batch with the result
+     * of all the previous batches. */
+    when(issuingStage === levels.U) {
+      val batchResult = if (levels == 0) recIn1(0) else fmaResp(0).bits
+      fmaIssue(0, batchResult, recode(identity), multiply)
+    }
+
+    when(levelDone && treeStage === levels.U) {
+      val result = ieee(fmaResp(0).bits)
+      lastBatchResult := result
+      identity := result
+      io.out.valid := true.B
+    }
+  }
+
+  /** Exclusive scan of a batch as a Kogge-Stone parallel prefix.
+    * The batch is shifted over by one lane with the running identity put in
+    * lane 0, so the inclusive prefix of that is exactly the exclusive scan.
+    * One last trip through lane 0's FMA unit adds the batch's last element to
+    * get the identity for the next batch. */
+  def treeScan(): Unit = {
+    val shifted = VecInit(recode(identity) +: recIn1.slice(0, batchSize - 1))
+    val prefix = VecInit((0 until batchSize).map { i =>
+      Mux(levelDone, fmaResp(i).bits, shifted(i))
+    })
+    for (i <- 0 until batchSize) {
+      // At level k, lane i adds the lane 2^k below it. Lower lanes add -0.0.
+      val partner = MuxLookup(issuingStage, recodedNegZero)((0 until treeLevels).map { k =>
+        k.U -> (if (i >= (1 << k)) prefix(i - (1 << k)) else recodedNegZero)
+      })
+      fmaValid(i) := pipelineStart || (levelDone && treeStage < treeLevels.U)
+      fmaIssue(i, prefix(i), partner, false)
+    }
+    when(issuingStage === treeLevels.U && (pipelineStart || levelDone)) {
+      for (i <- 0 until batchSize) {
+        workingSpace(i) := ieee(prefix(i))
+      }
+      fmaIssue(0, prefix(batchSize - 1), recIn1(batchSize - 1), false)
+    }
+
+    when(levelDone && treeStage === treeLevels.U) {
+      identity := ieee(fmaResp(0).bits)
+      io.out.valid := true.B
+    }
+  }
+
+  when(io.execute) {
+    switch(io.fn) {
+      is(48.U) {
+        // + FLOAT
+        fmaMap(0.U, false)
+      }
+      is(49.U) {
+        // - FLOAT
+        fmaMap(1.U, false)
+      }
+      is(50.U) {
+        // * FLOAT
+        fmaMap(0.U, true)
+      }
+      is(51.U) {
+        // / FLOAT
+        divSqrtMap(false)
+      }
+      is(52.U) {
+        // SQRT FLOAT
+        divSqrtMap(true)
+      }
+      is(53.U) {
+        // LESS FLOAT
+        elementWiseMap(i => compareBank(i).io.lt)
+      }
+      is(54.U) {
+        // LESS OR EQUAL FLOAT
+        elementWiseMap(i => compareBank(i).io.lt || compareBank(i).io.eq)
+      }
+      is(55.U) {
+        // GREATER FLOAT
+        elementWiseMap(i => compareBank(i).io.gt)
+      }
+      is(56.U) {
+        // GREATER OR EQUAL FLOAT
+        elementWiseMap(i => compareBank(i).io.gt || compareBank(i).io.eq)
+      }
+      is(57.U) {
+        // EQUAL FLOAT
+        elementWiseMap(i => compareBank(i).io.eq)
+      }
+      is(58.U) {
+        // UNEQUAL FLOAT
+        elementWiseMap(i => !compareBank(i).io.eq)
+      }
+      is(59.U) {
+        // +_REDUCE FLOAT
+        treeReduce(false)
+      }
+      is(60.U) {
+        // *_REDUCE FLOAT
+        treeReduce(true)
+      }
+      is(61.U) {
+        // +_SCAN FLOAT
+        treeScan()
+      }
+      is(62.U) {
+        // INT TO FLOAT
+        elementWiseMap(i => ieee(toFloatBank(i).io.out))
+      }
+      is(63.U) {
+        // FLOAT TO INT
+        elementWiseMap(i => toIntBank(i).io.out)
+      }
+      is(65.U) {
+        // DOT FLOAT
+        treeReduce(false, products = true)
+      }
+    }
+  }
+}
@@ -9,7 +9,12 @@ import Instructions._
 import vcoderocc.constants._
 import ALU._
 import PermuteUnit._
+import FloatUnit._
+import SortUnit._
+import PerfCounters._
+import TraceBuffer._
 import NumOperatorOperands._
+import BoolPacking._
 
 /** Trait holding an abstract (non-instantiated) mapping between the instruction
   * bit pattern and its control signals.
@@ -23,6 +28,9 @@ sealed trait DecodeConstants extends HasCoreParameters { // TODO: Not sure if ex
   def uIntMax(xLen: Int): UInt = ~(0.U(xLen.W))
   def sIntMin(xLen: Int): SInt = (-(BigInt(1) << (xLen - 1))).S(xLen.W)
   def sIntMax(xLen: Int): SInt = ((BigInt(1) << (xLen - 1)) - 1).S(xLen.W)
+  // IEEE 754 double-precision encodings of -0.0 and 1.0
+  def floatNegZero(xLen: Int): UInt = (BigInt(1) << (xLen - 1)).U(xLen.W)
+  def floatOne(xLen: Int): UInt = BigInt("3FF0000000000000", 16).U(xLen.W)
 }
 
 /** Control signals in the processor.
@@ -36,11 +44,12 @@ class CtrlSigs(xLen: Int) extends Bundle {
   val aluFn = Bits(SZ_ALU_FN.W)
   val identityVal = UInt(xLen.W)
   val isMemOp = Bool()
+  val boolPacking = Bits(SZ_BOOL_PACKING)
 
   /** List of default control signal values
     * @return List of default control signal values. */
   def defaultDecodeCtrlSigs: List[BitPat] =
-    List(N, MEM_OPS_X, FN_X, BitPat.dontCare(xLen), N)
+    List(N, MEM_OPS_X, FN_X, BitPat.dontCare(xLen), N, BOOL_X)
 
   /** Decodes an instruction to its control signals.
     * @param inst The instruction bit pattern to be decoded.
@@ -52,7 +61,7 @@ class CtrlSigs(xLen: Int) extends Bundle {
     val decoder = freechips.rocketchip.rocket.DecodeLogic(inst, defaultDecodeCtrlSigs, decodeTable)
     /* Make sequence ordered how signals are ordered.
      * See rocket-chip's rocket/IDecode.scala#IntCtrlSigs#decode#sigs */
-    val ctrlSigs = Seq(legal, numMemFetches, aluFn, identityVal, isMemOp)
+    val ctrlSigs = Seq(legal, numMemFetches, aluFn, identityVal, isMemOp, boolPacking)
     /* Decoder is a minimized truth-table. We partially apply the map here,
      * which allows us to apply an instruction to get its control signals back.
      * We then zip that with the sequence of names for the control signals. */
@@ -76,14 +85,15 @@ object CtrlSigs {
   def convert(signalPattern: Iterable[BitPat]): CtrlSigs = {
     // This map destructures the signalPattern and assigns the elements to each
     // name in this sequence.
-    val Seq(legal, numMemFetches, aluFn, identityVal, isMemOp) = signalPattern.map{ case (x: BitPat) => x }
+    val Seq(legal, numMemFetches, aluFn, identityVal, isMemOp, boolPacking) = signalPattern.map{ case (x: BitPat) => x }
 
     (new CtrlSigs(xLen)).Lit(
       _.legal -> BitPat.bitPatToUInt(legal).asBool,
       _.numMemFetches -> BitPat.bitPatToUInt(numMemFetches),
       _.aluFn -> aluFn.value.U, // NOTE: BitPat of unknowns BitPat("b???") will be converted to 0s by this!
       _.identityVal -> BitPat.bitPatToUInt(identityVal),
-      _.isMemOp -> BitPat.bitPatToUInt(isMemOp).asBool
+      _.isMemOp -> BitPat.bitPatToUInt(isMemOp).asBool,
+      _.boolPacking -> boolPacking.value.U
     )
   }
 }
@@ -96,60 +106,173 @@ object CtrlSigs {
   */
 final class BinOpDecode(implicit val p: Parameters) extends DecodeConstants {
   val decodeTable: Array[(BitPat, List[BitPat])] = Array(
-    PLUS_INT-> List(Y, MEM_OPS_TWO, FN_ADD, BitPat(0.U), Y),
-    SUB_INT -> List(Y, MEM_OPS_TWO, FN_SUB, BitPat(0.U), Y),
-    MUL_INT -> List(Y, MEM_OPS_TWO, FN_MUL, BitPat(1.U), Y),
-    DIV_INT -> List(Y, MEM_OPS_TWO, FN_DIV, BitPat(1.U), Y),
-    MOD_INT -> List(Y, MEM_OPS_TWO, FN_MOD, BitPat(1.U), Y),
-    LESS_INT -> List(Y, MEM_OPS_TWO, FN_LESS, BitPat(false.B), Y),
-    LESS_EQUAL_INT -> List(Y, MEM_OPS_TWO, FN_LESS_EQUAL, BitPat(false.B), Y),
-    GREATER_INT -> List(Y, MEM_OPS_TWO, FN_GREATER, BitPat(false.B), Y),
-    GREATER_EQUAL_INT -> List(Y, MEM_OPS_TWO, FN_GREATER_EQUAL, BitPat(false.B), Y),
-    EQUAL_INT -> List(Y, MEM_OPS_TWO, FN_EQUAL, BitPat(false.B), Y),
-    UNEQUAL_INT -> List(Y, MEM_OPS_TWO, FN_UNEQUAL, BitPat(false.B), Y),
-    LSHIFT_INT -> List(Y, MEM_OPS_TWO, FN_LSHIFT, BitPat(0.U), Y),
-    RSHIFT_INT -> List(Y, MEM_OPS_TWO, FN_RSHIFT, BitPat(0.U), Y),
-    NOT_INT -> List(Y, MEM_OPS_ONE, FN_NOT, BitPat(false.B), Y),
-    AND_INT -> List(Y, MEM_OPS_TWO, FN_AND, BitPat(true.B), Y),
-    OR_INT -> List(Y, MEM_OPS_TWO, FN_OR, BitPat(false.B), Y),
-    XOR_INT -> List(Y, MEM_OPS_TWO, FN_XOR, BitPat(false.B), Y))
+    PLUS_INT-> List(Y, MEM_OPS_TWO, FN_ADD, BitPat(0.U), Y, BOOL_UNPACKED),
+    SUB_INT -> List(Y, MEM_OPS_TWO, FN_SUB, BitPat(0.U), Y, BOOL_UNPACKED),
+    MUL_INT -> List(Y, MEM_OPS_TWO, FN_MUL, BitPat(1.U), Y, BOOL_UNPACKED),
+    DIV_INT -> List(Y, MEM_OPS_TWO, FN_DIV, BitPat(1.U), Y, BOOL_UNPACKED),
+    MOD_INT -> List(Y, MEM_OPS_TWO, FN_MOD, BitPat(1.U), Y, BOOL_UNPACKED),
+    LESS_INT -> List(Y, MEM_OPS_TWO, FN_LESS, BitPat(false.B), Y, BOOL_UNPACKED),
+    LESS_EQUAL_INT -> List(Y, MEM_OPS_TWO, FN_LESS_EQUAL, BitPat(false.B), Y, BOOL_UNPACKED),
+    GREATER_INT -> List(Y, MEM_OPS_TWO, FN_GREATER, BitPat(false.B), Y, BOOL_UNPACKED),
+    GREATER_EQUAL_INT -> List(Y, MEM_OPS_TWO, FN_GREATER_EQUAL, BitPat(false.B), Y, BOOL_UNPACKED),
+    EQUAL_INT -> List(Y, MEM_OPS_TWO, FN_EQUAL, BitPat(false.B), Y, BOOL_UNPACKED),
+    UNEQUAL_INT -> List(Y, MEM_OPS_TWO, FN_UNEQUAL, BitPat(false.B), Y, BOOL_UNPACKED),
+    LSHIFT_INT -> List(Y, MEM_OPS_TWO, FN_LSHIFT, BitPat(0.U), Y, BOOL_UNPACKED),
+    RSHIFT_INT -> List(Y, MEM_OPS_TWO, FN_RSHIFT, BitPat(0.U), Y, BOOL_UNPACKED),
+    NOT_INT -> List(Y, MEM_OPS_ONE, FN_NOT, BitPat(false.B), Y, BOOL_UNPACKED),
+    AND_INT -> List(Y, MEM_OPS_TWO, FN_AND, BitPat(true.B), Y, BOOL_UNPACKED),
+    OR_INT -> List(Y, MEM_OPS_TWO, FN_OR, BitPat(false.B), Y, BOOL_UNPACKED),
+    XOR_INT -> List(Y, MEM_OPS_TWO, FN_XOR, BitPat(false.B), Y, BOOL_UNPACKED),
+    LESS_SIGNED_INT -> List(Y, MEM_OPS_TWO, FN_LESS_SIGNED, BitPat(false.B), Y, BOOL_UNPACKED),
+    LESS_EQUAL_SIGNED_INT -> List(Y, MEM_OPS_TWO, FN_LESS_EQUAL_SIGNED, BitPat(false.B), Y, BOOL_UNPACKED),
+    GREATER_SIGNED_INT -> List(Y, MEM_OPS_TWO, FN_GREATER_SIGNED, BitPat(false.B), Y, BOOL_UNPACKED),
+    GREATER_EQUAL_SIGNED_INT -> List(Y, MEM_OPS_TWO, FN_GREATER_EQUAL_SIGNED, BitPat(false.B), Y, BOOL_UNPACKED),
+    MIN_INT -> List(Y, MEM_OPS_TWO, FN_MIN, BitPat.dontCare(xLen), Y, BOOL_UNPACKED),
+    MAX_INT -> List(Y, MEM_OPS_TWO, FN_MAX, BitPat.dontCare(xLen), Y, BOOL_UNPACKED),
+    MIN_UNSIGNED_INT -> List(Y, MEM_OPS_TWO, FN_MIN_UNSIGNED, BitPat.dontCare(xLen), Y, BOOL_UNPACKED),
+    MAX_UNSIGNED_INT -> List(Y, MEM_OPS_TWO, FN_MAX_UNSIGNED, BitPat.dontCare(xLen), Y, BOOL_UNPACKED),
+    ARSHIFT_INT -> List(Y, MEM_OPS_TWO, FN_ARSHIFT, BitPat(0.U), Y, BOOL_UNPACKED),
+    POPCOUNT_INT -> List(Y, MEM_OPS_ONE, FN_POPCOUNT, BitPat.dontCare(xLen), Y, BOOL_UNPACKED),
+    CLZ_INT -> List(Y, MEM_OPS_ONE, FN_CLZ, BitPat.dontCare(xLen), Y, BOOL_UNPACKED),
+    CTZ_INT -> List(Y, MEM_OPS_ONE, FN_CTZ, BitPat.dontCare(xLen), Y, BOOL_UNPACKED),
+    BIT_REVERSE_INT -> List(Y, MEM_OPS_ONE, FN_BIT_REVERSE, BitPat.dontCare(xLen), Y, BOOL_UNPACKED))
 }
 
 final class ReduceDecode(implicit val p: Parameters) extends DecodeConstants {
   val decodeTable: Array[(BitPat, List[BitPat])] = Array(
-    PLUS_RED_INT -> List(Y, MEM_OPS_ONE, FN_RED_ADD, BitPat(0.U), Y),
-    MUL_RED_INT -> List(Y, MEM_OPS_ONE, FN_RED_MUL, BitPat(1.U), Y),
+    PLUS_RED_INT -> List(Y, MEM_OPS_ONE, FN_RED_ADD, BitPat(0.U), Y, BOOL_UNPACKED),
+    MUL_RED_INT -> List(Y, MEM_OPS_ONE, FN_RED_MUL, BitPat(1.U), Y, BOOL_UNPACKED),
     MAX_RED_INT -> List(Y, MEM_OPS_ONE, FN_RED_MAX,
-      BitPat(sIntMin(xLen).asUInt), Y),
+      BitPat(sIntMin(xLen).asUInt), Y, BOOL_UNPACKED),
     MIN_RED_INT -> List(Y, MEM_OPS_ONE, FN_RED_MIN,
-      BitPat(sIntMax(xLen).asUInt), Y),
-    AND_RED_INT -> List(Y, MEM_OPS_ONE, FN_RED_AND, BitPat(true.B), Y),
-    OR_RED_INT -> List(Y, MEM_OPS_ONE, FN_RED_OR, BitPat(false.B), Y),
-    XOR_RED_INT -> List(Y, MEM_OPS_ONE, FN_RED_XOR, BitPat(false.B), Y)
+      BitPat(sIntMax(xLen).asUInt), Y, BOOL_UNPACKED),
+    AND_RED_INT -> List(Y, MEM_OPS_ONE, FN_RED_AND, BitPat(true.B), Y, BOOL_UNPACKED),
+    OR_RED_INT -> List(Y, MEM_OPS_ONE, FN_RED_OR, BitPat(false.B), Y, BOOL_UNPACKED),
+    XOR_RED_INT -> List(Y, MEM_OPS_ONE, FN_RED_XOR, BitPat(false.B), Y, BOOL_UNPACKED),
+    DOT_INT -> List(Y, MEM_OPS_TWO, FN_DOT, BitPat(0.U), Y, BOOL_UNPACKED),
+    POPCOUNT_RED_INT -> List(Y, MEM_OPS_ONE, FN_RED_POPCOUNT, BitPat(0.U), Y, BOOL_PACKED)
     )
 }
 
 final class ScanDecode(implicit val p: Parameters) extends DecodeConstants {
   val decodeTable: Array[(BitPat, List[BitPat])] = Array(
-    PLUS_SCAN_INT -> List(Y, MEM_OPS_ONE, FN_SCAN_ADD, BitPat(0.U), Y),
-    MUL_SCAN_INT -> List(Y, MEM_OPS_ONE, FN_SCAN_MUL, BitPat(1.U), Y),
+    PLUS_SCAN_INT -> List(Y, MEM_OPS_ONE, FN_SCAN_ADD, BitPat(0.U), Y, BOOL_UNPACKED),
+    MUL_SCAN_INT -> List(Y, MEM_OPS_ONE, FN_SCAN_MUL, BitPat(1.U), Y, BOOL_UNPACKED),
     MAX_SCAN_INT -> List(Y, MEM_OPS_ONE, FN_SCAN_MAX,
-      BitPat(sIntMin(xLen).asUInt), Y),
+      BitPat(sIntMin(xLen).asUInt), Y, BOOL_UNPACKED),
     MIN_SCAN_INT -> List(Y, MEM_OPS_ONE, FN_SCAN_MIN,
-      BitPat(sIntMax(xLen).asUInt), Y),
-    AND_SCAN_INT -> List(Y, MEM_OPS_ONE, FN_SCAN_AND, BitPat(true.B), Y),
-    OR_SCAN_INT -> List(Y, MEM_OPS_ONE, FN_SCAN_OR, BitPat(false.B), Y),
-    XOR_SCAN_INT -> List(Y, MEM_OPS_ONE, FN_SCAN_XOR, BitPat(false.B), Y))
+      BitPat(sIntMax(xLen).asUInt), Y, BOOL_UNPACKED),
+    AND_SCAN_INT -> List(Y, MEM_OPS_ONE, FN_SCAN_AND, BitPat(true.B), Y, BOOL_UNPACKED),
+    OR_SCAN_INT -> List(Y, MEM_OPS_ONE, FN_SCAN_OR, BitPat(false.B), Y, BOOL_UNPACKED),
+    XOR_SCAN_INT -> List(Y, MEM_OPS_ONE, FN_SCAN_XOR, BitPat(false.B), Y, BOOL_UNPACKED))
 }
 
 final class SelectDecode(implicit val p: Parameters) extends DecodeConstants {
   val decodeTable: Array[(BitPat, List[BitPat])] = Array(
-    SELECT_INT -> List(Y, MEM_OPS_THREE, FN_SELECT, BitPat.dontCare(xLen), Y))
+    SELECT_INT -> List(Y, MEM_OPS_THREE, FN_SELECT, BitPat.dontCare(xLen), Y, BOOL_UNPACKED))
 }
 
 final class PermuteDecode (implicit val p: Parameters) extends DecodeConstants {
   val decodeTable: Array[(BitPat, List[BitPat])] = Array(
-    PERMUTE_INT -> List(Y, MEM_OPS_TWO, FN_PERMUTE, BitPat.dontCare(xLen), Y))
+    PERMUTE_INT -> List(Y, MEM_OPS_TWO, FN_PERMUTE, BitPat.dontCare(xLen), Y, BOOL_UNPACKED),
+    HISTOGRAM_INT -> List(Y, MEM_OPS_ONE, FN_HISTOGRAM, BitPat.dontCare(xLen), Y, BOOL_UNPACKED),
+    RANK_INT -> List(Y, MEM_OPS_ONE, FN_RANK, BitPat.dontCare(xLen), Y, BOOL_UNPACKED))
+}
+
+/** Decode table for double-precision floating-point operations.
+  * Additive reductions and scans start from -0.0, so that -0.0 + -0.0 keeps
+  * its sign.
+  */
+final class FloatDecode(implicit val p: Parameters) extends DecodeConstants {
+  val decodeTable: Array[(BitPat, List[BitPat])] = Array(
+    PLUS_FLOAT -> List(Y, MEM_OPS_TWO, FN_FADD, BitPat.dontCare(xLen), Y, BOOL_UNPACKED),
+    SUB_FLOAT -> List(Y, MEM_OPS_TWO, FN_FSUB, BitPat.dontCare(xLen), Y, BOOL_UNPACKED),
+    MUL_FLOAT -> List(Y, MEM_OPS_TWO, FN_FMUL, BitPat.dontCare(xLen), Y, BOOL_UNPACKED),
+    DIV_FLOAT -> List(Y, MEM_OPS_TWO, FN_FDIV, BitPat.dontCare(xLen), Y, BOOL_UNPACKED),
+    SQRT_FLOAT -> List(Y, MEM_OPS_ONE, FN_FSQRT, BitPat.dontCare(xLen), Y, BOOL_UNPACKED),
+    LESS_FLOAT -> List(Y, MEM_OPS_TWO, FN_FLESS, BitPat(false.B), Y, BOOL_UNPACKED),
+    LESS_EQUAL_FLOAT -> List(Y, MEM_OPS_TWO, FN_FLESS_EQUAL, BitPat(false.B), Y, BOOL_UNPACKED),
+    GREATER_FLOAT -> List(Y, MEM_OPS_TWO, FN_FGREATER, BitPat(false.B), Y, BOOL_UNPACKED),
+    GREATER_EQUAL_FLOAT -> List(Y, MEM_OPS_TWO, FN_FGREATER_EQUAL, BitPat(false.B), Y, BOOL_UNPACKED),
+    EQUAL_FLOAT -> List(Y, MEM_OPS_TWO, FN_FEQUAL, BitPat(false.B), Y, BOOL_UNPACKED),
+    UNEQUAL_FLOAT -> List(Y, MEM_OPS_TWO, FN_FUNEQUAL, BitPat(false.B), Y, BOOL_UNPACKED),
+    PLUS_RED_FLOAT -> List(Y, MEM_OPS_ONE, FN_RED_FADD, BitPat(floatNegZero(xLen)), Y, BOOL_UNPACKED),
+    MUL_RED_FLOAT -> List(Y, MEM_OPS_ONE, FN_RED_FMUL, BitPat(floatOne(xLen)), Y, BOOL_UNPACKED),
+    PLUS_SCAN_FLOAT -> List(Y, MEM_OPS_ONE, FN_SCAN_FADD, BitPat(floatNegZero(xLen)), Y, BOOL_UNPACKED),
+    INT_TO_FLOAT -> List(Y, MEM_OPS_ONE, FN_INT_TO_FLOAT, BitPat.dontCare(xLen), Y, BOOL_UNPACKED),
+    FLOAT_TO_INT -> List(Y, MEM_OPS_ONE, FN_FLOAT_TO_INT, BitPat.dontCare(xLen), Y, BOOL_UNPACKED),
+    DOT_FLOAT -> List(Y, MEM_OPS_TWO, FN_FDOT, BitPat(floatNegZero(xLen)), Y, BOOL_UNPACKED))
+}
+
+/** Decode table for sorting operations.
+  * MERGE reads two sorted vectors, each numOperands long, and writes all
+  * 2 * numOperands elements to the destination.
+  */
+final class SortDecode(implicit val p: Parameters) extends DecodeConstants {
+  val decodeTable: Array[(BitPat, List[BitPat])] = Array(
+    SORT_BATCH_INT -> List(Y, MEM_OPS_ONE, FN_SORT_BATCH, BitPat.dontCare(xLen), Y, BOOL_UNPACKED),
+    MERGE_INT -> List(Y, MEM_OPS_TWO, FN_MERGE, BitPat.dontCare(xLen), Y, BOOL_UNPACKED))
+}
+
+/** Decode table for operations on bit-packed boolean vectors.
+  * Packed booleans hold 1 flag per bit, 64 flags per word, laid out the same
+  * way SELECT reads its flags.
+  *
+  * The packed comparisons read ordinary integer vectors, but write their
+  * results packed. The packed boolean logic operations read and write packed
+  * vectors, processing a whole word of flags per element.
+  */
+final class PackedBoolDecode(implicit val p: Parameters) extends DecodeConstants {
+  val decodeTable: Array[(BitPat, List[BitPat])] = Array(
+    LESS_PACKED_INT -> List(Y, MEM_OPS_TWO, FN_LESS, BitPat.dontCare(xLen), Y, BOOL_PACK_RESULT),
+    LESS_EQUAL_PACKED_INT -> List(Y, MEM_OPS_TWO, FN_LESS_EQUAL, BitPat.dontCare(xLen), Y, BOOL_PACK_RESULT),
+    GREATER_PACKED_INT -> List(Y, MEM_OPS_TWO, FN_GREATER, BitPat.dontCare(xLen), Y, BOOL_PACK_RESULT),
+    GREATER_EQUAL_PACKED_INT -> List(Y, MEM_OPS_TWO, FN_GREATER_EQUAL, BitPat.dontCare(xLen), Y, BOOL_PACK_RESULT),
+    EQUAL_PACKED_INT -> List(Y, MEM_OPS_TWO, FN_EQUAL, BitPat.dontCare(xLen), Y, BOOL_PACK_RESULT),
+    UNEQUAL_PACKED_INT -> List(Y, MEM_OPS_TWO, FN_UNEQUAL, BitPat.dontCare(xLen), Y, BOOL_PACK_RESULT),
+    NOT_BOOL -> List(Y, MEM_OPS_ONE, FN_NOT, BitPat.dontCare(xLen), Y, BOOL_PACKED),
+    AND_BOOL -> List(Y, MEM_OPS_TWO, FN_AND, BitPat.dontCare(xLen), Y, BOOL_PACKED),
+    OR_BOOL -> List(Y, MEM_OPS_TWO, FN_OR, BitPat.dontCare(xLen), Y, BOOL_PACKED),
+    XOR_BOOL -> List(Y, MEM_OPS_TWO, FN_XOR, BitPat.dontCare(xLen), Y, BOOL_PACKED))
+}
+
+/** Decode table for vector generators.
+  * Generators take their parameters in rs1/rs2 and have no memory operands to
+  * fetch, but still write a vector to memory.
+  */
+final class GeneratorDecode(implicit val p: Parameters) extends DecodeConstants {
+  val decodeTable: Array[(BitPat, List[BitPat])] = Array(
+    INDEX_INT -> List(Y, MEM_OPS_ZERO, FN_INDEX, BitPat.dontCare(xLen), Y, BOOL_UNPACKED),
+    DIST_INT -> List(Y, MEM_OPS_ZERO, FN_DIST, BitPat.dontCare(xLen), Y, BOOL_UNPACKED),
+    RAND_INT -> List(Y, MEM_OPS_ZERO, FN_RAND, BitPat.dontCare(xLen), Y, BOOL_UNPACKED))
+}
+
+/** Decode table for single-element accesses.
+  * EXTRACT reads element rs2 of the vector at rs1 and responds with it in rd.
+  * REPLACE writes the value in rs1 to element rs2 of the destination vector.
+  * READ_ACCUMULATOR responds with the value of accumulator rs1 in rd.
+  * READ_COUNTER responds with the value of performance counter rs1 in rd.
+  * DRAIN_TRACE writes up to numOperands trace records to the destination and
+  * responds with how many it wrote.
+  */
+final class ElementDecode(implicit val p: Parameters) extends DecodeConstants {
+  val decodeTable: Array[(BitPat, List[BitPat])] = Array(
+    EXTRACT_INT -> List(Y, MEM_OPS_ONE, FN_EXTRACT, BitPat.dontCare(xLen), Y, BOOL_UNPACKED),
+    REPLACE_INT -> List(Y, MEM_OPS_ZERO, FN_REPLACE, BitPat.dontCare(xLen), Y, BOOL_UNPACKED),
+    READ_ACCUMULATOR -> List(Y, MEM_OPS_ZERO, FN_READ_ACCUMULATOR, BitPat.dontCare(xLen), Y, BOOL_UNPACKED),
+    READ_COUNTER -> List(Y, MEM_OPS_ZERO, FN_READ_COUNTER, BitPat.dontCare(xLen), Y, BOOL_UNPACKED),
+    DRAIN_TRACE -> List(Y, MEM_OPS_ZERO, FN_DRAIN_TRACE, BitPat.dontCare(xLen), Y, BOOL_UNPACKED))
+}
+
+/** Decode table for bulk copies.
+  * The source vector is passed in rs1. The strided variant takes the distance
+  * between consecutive source elements (in elements) in rs2. The destination
+  * is always contiguous.
+  */
+final class CopyDecode(implicit val p: Parameters) extends DecodeConstants {
+  val decodeTable: Array[(BitPat, List[BitPat])] = Array(
+    COPY_INT -> List(Y, MEM_OPS_ONE, FN_COPY, BitPat.dontCare(xLen), Y, BOOL_UNPACKED),
+    COPY_STRIDED_INT -> List(Y, MEM_OPS_ONE, FN_COPY_STRIDED, BitPat.dontCare(xLen), Y, BOOL_UNPACKED))
 }
 
 /** Decode table for accelerator control instructions.
@@ -161,9 +284,17 @@ final class PermuteDecode (implicit val p: Parameters) extends DecodeConstants {
   */
 final class CtrlOpDecode(implicit val p: Parameters) extends DecodeConstants {
   val decodeTable: Array[(BitPat, List[BitPat])] = Array(
-    SET_NUM_OPERANDS -> List(Y, MEM_OPS_ZERO, FN_X, BitPat.dontCare(xLen), N),
-    SET_DEST_ADDR -> List(Y, MEM_OPS_ZERO, FN_X, BitPat.dontCare(xLen), N),
-    SET_THIRD_OPERAND -> List(Y, MEM_OPS_ZERO, FN_X, BitPat.dontCare(xLen), N))
+    SET_NUM_OPERANDS -> List(Y, MEM_OPS_ZERO, FN_X, BitPat.dontCare(xLen), N, BOOL_X),
+    SET_DEST_ADDR -> List(Y, MEM_OPS_ZERO, FN_X, BitPat.dontCare(xLen), N, BOOL_X),
+    SET_THIRD_OPERAND -> List(Y, MEM_OPS_ZERO, FN_X, BitPat.dontCare(xLen), N, BOOL_X),
+    SET_ELEMENT_WIDTH -> List(Y, MEM_OPS_ZERO, FN_X, BitPat.dontCare(xLen), N, BOOL_X),
+    SET_ACCUMULATOR -> List(Y, MEM_OPS_ZERO, FN_X, BitPat.dontCare(xLen), N, BOOL_X),
+    CLEAR_ACCUMULATOR -> List(Y, MEM_OPS_ZERO, FN_X, BitPat.dontCare(xLen), N, BOOL_X),
+    SET_STRIDE -> List(Y, MEM_OPS_ZERO, FN_X, BitPat.dontCare(xLen), N, BOOL_X),
+    SET_ROW_STRIDE -> List(Y, MEM_OPS_ZERO, FN_X, BitPat.dontCare(xLen), N, BOOL_X),
+    SET_ROW_LENGTH -> List(Y, MEM_OPS_ZERO, FN_X, BitPat.dontCare(xLen), N, BOOL_X),
+    SET_HEADER_MODE -> List(Y, MEM_OPS_ZERO, FN_X, BitPat.dontCare(xLen), N, BOOL_X),
+    RESET_COUNTERS -> List(Y, MEM_OPS_ZERO, FN_X, BitPat.dontCare(xLen), N, BOOL_X))
 }
 
 /** A class holding a decode table for all possible RoCC instructions that are
@@ -179,6 +310,12 @@ class DecodeTable(implicit val p: Parameters) {
     Seq(new ScanDecode) ++
     Seq(new SelectDecode) ++
     Seq(new PermuteDecode) ++
+    Seq(new FloatDecode) ++
+    Seq(new SortDecode) ++
+    Seq(new PackedBoolDecode) ++
+    Seq(new GeneratorDecode) ++
+    Seq(new CopyDecode) ++
+    Seq(new ElementDecode) ++
     Seq(new CtrlOpDecode)
   } flatMap(_.decodeTable)
 
@@ -36,6 +36,68 @@ object Instructions {
   def OR_RED_INT = BitPat("b0100001")
   def XOR_RED_INT = BitPat("b0100010")
   def PERMUTE_INT = BitPat("b0100011")
+  def INDEX_INT = BitPat("b0100100")
+  def DIST_INT = BitPat("b0100101")
+  def COPY_INT = BitPat("b0100110")
+  def COPY_STRIDED_INT = BitPat("b0100111")
+  // Comparisons producing bit-packed boolean vectors, 1 bit per element.
+  def LESS_PACKED_INT = BitPat("b0101000")
+  def LESS_EQUAL_PACKED_INT = BitPat("b0101001")
+  def GREATER_PACKED_INT = BitPat("b0101010")
+  def GREATER_EQUAL_PACKED_INT = BitPat("b0101011")
+  def EQUAL_PACKED_INT = BitPat("b0101100")
+  def UNEQUAL_PACKED_INT = BitPat("b0101101")
+  // Logic on bit-packed boolean vectors.
+  def NOT_BOOL = BitPat("b0101110")
+  def AND_BOOL = BitPat("b0101111")
+  def OR_BOOL = BitPat("b0110000")
+  def XOR_BOOL = BitPat("b0110001")
+  /* LESS_INT..GREATER_EQUAL_INT compare their elements as unsigned integers.
+   * These variants compare them as signed (two's complement) integers. */
+  def LESS_SIGNED_INT = BitPat("b0110010")
+  def LESS_EQUAL_SIGNED_INT = BitPat("b0110011")
+  def GREATER_SIGNED_INT = BitPat("b0110100")
+  def GREATER_EQUAL_SIGNED_INT = BitPat("b0110101")
+  def MIN_INT = BitPat("b0110110")
+  def MAX_INT = BitPat("b0110111")
+  def MIN_UNSIGNED_INT = BitPat("b0111000")
+  def MAX_UNSIGNED_INT = BitPat("b0111001")
+  def ARSHIFT_INT = BitPat("b0111010")
+  def DOT_INT = BitPat("b0111011")
+  def POPCOUNT_INT = BitPat("b0111100")
+  def CLZ_INT = BitPat("b0111101")
+  def CTZ_INT = BitPat("b0111110")
+  def BIT_REVERSE_INT = BitPat("b0111111")
+  /* 0x40-0x4F are reserved for accelerator configuration instructions below.
+   * Operations continue from 0x50. */
+  def PLUS_FLOAT = BitPat("b1010000")
+  def SUB_FLOAT = BitPat("b1010001")
+  def MUL_FLOAT = BitPat("b1010010")
+  def DIV_FLOAT = BitPat("b1010011")
+  def SQRT_FLOAT = BitPat("b1010100")
+  def LESS_FLOAT = BitPat("b1010101")
+  def LESS_EQUAL_FLOAT = BitPat("b1010110")
+  def GREATER_FLOAT = BitPat("b1010111")
+  def GREATER_EQUAL_FLOAT = BitPat("b1011000")
+  def EQUAL_FLOAT = BitPat("b1011001")
+  def UNEQUAL_FLOAT = BitPat("b1011010")
+  def PLUS_RED_FLOAT = BitPat("b1011011")
+  def MUL_RED_FLOAT = BitPat("b1011100")
+  def PLUS_SCAN_FLOAT = BitPat("b1011101")
+  def INT_TO_FLOAT = BitPat("b1011110")
+  def FLOAT_TO_INT = BitPat("b1011111")
+  def DOT_FLOAT = BitPat("b1100000")
+  def POPCOUNT_RED_INT = BitPat("b1100001")
+  def HISTOGRAM_INT = BitPat("b1100010")
+  def RANK_INT = BitPat("b1100011")
+  def SORT_BATCH_INT = BitPat("b1100100")
+  def MERGE_INT = BitPat("b1100101")
+  def RAND_INT = BitPat("b1100110")
+  def EXTRACT_INT = BitPat("b1100111")
+  def REPLACE_INT = BitPat("b1101000")
+  def READ_ACCUMULATOR = BitPat("b1101001")
+  def READ_COUNTER = BitPat("b1101010")
+  def DRAIN_TRACE = BitPat("b1101011")
 
   // Accelerator configuration instructions. These are usually nonblocking.
   /** Set number of elements to operate over. */
@@ -44,4 +106,26 @@ object Instructions {
   def SET_DEST_ADDR = BitPat("b1000001")
   /* Set the third operand */
   def SET_THIRD_OPERAND = BitPat("b1000010")
+  /** Set the width of the elements of the following vector operations, using
+    * one of the MemorySizeConstants.MTxx encodings. */
+  def SET_ELEMENT_WIDTH = BitPat("b1000011")
+  /** Select the accumulator (plus 1) that following integer reductions are
+    * kept in. 0 turns accumulation off. */
+  def SET_ACCUMULATOR = BitPat("b1000100")
+  /** Set accumulator rs1 to the value in rs2. */
+  def CLEAR_ACCUMULATOR = BitPat("b1000101")
+  /** Set the stride, in elements, of source vector 1, source vector 2 or the
+    * destination (rs1 = 0, 1 or 2) to rs2. */
+  def SET_STRIDE = BitPat("b1000110")
+  /** Set the distance, in elements, between the starts of two rows of source
+    * vector 1, source vector 2 or the destination (rs1 = 0, 1 or 2) to rs2. */
+  def SET_ROW_STRIDE = BitPat("b1000111")
+  /** Set the number of elements in each row of 2-D vectors. 0 makes vectors
+    * 1-D. */
+  def SET_ROW_LENGTH = BitPat("b1001000")
+  /** Turn header mode on (rs1 = 1) or off (rs1 = 0). In header mode, vectors
+    * start with a word holding their length. */
+  def SET_HEADER_MODE = BitPat("b1001001")
+  /** Set every performance counter back to 0. */
+  def RESET_COUNTERS = BitPat("b1001010")
 }
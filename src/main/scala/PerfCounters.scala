@@ -0,0 +1,94 @@
+package vcoderocc
+
+import chisel3._
+import chisel3.util._
+
+/** Externally-visible properties of the performance counters.
+  * The function code shares the same space as the ALU's, so it must never
+  * overlap with them.
+  */
+object PerfCounters {
+  val SZ_COUNTER_FN = 7
+
+  def FN_READ_COUNTER = BitPat(79.U(SZ_COUNTER_FN.W))
+
+  /* What each counter counts. Counters 0 to 8 count the cycles the main lane's
+   * control unit spends in each of its states, in the order they are declared
+   * in ControlUnit.State. */
+  val CYCLES_IN_STATE = 0
+  val NUM_CTRL_STATES = 9
+  /** Cycles the permute lane is busy. */
+  val PERM_BUSY_CYCLES = 9
+  /** L1 data cache requests issued, responses received & cycles a request
+    * waited on req.ready, by the main lane's data fetcher. */
+  val MAIN_REQS = 10
+  val MAIN_RESPS = 11
+  val MAIN_REQ_STALLS = 12
+  /** The same, for the permute lane's data fetcher. */
+  val PERM_REQS = 13
+  val PERM_RESPS = 14
+  val PERM_REQ_STALLS = 15
+  /** Batches run by each execution unit. The ALU's count covers every ALU
+    * cluster. */
+  val ALU_BATCHES = 16
+  val FPU_BATCHES = 17
+  val SORT_BATCHES = 18
+  val PERMUTE_BATCHES = 19
+  /** Histogram of the main lane's load latencies, from the request being sent
+    * to its response arriving. Bucket 0 counts loads taking under 4 cycles,
+    * bucket k those taking 2^(k+1) to 2^(k+2)-1 cycles, and the last bucket
+    * everything slower. */
+  val LATENCY_HISTOGRAM = 20
+  val LATENCY_BUCKETS = 8
+  /** Sum of every latency in the histogram, for the mean. */
+  val LATENCY_TOTAL = 28
+  /** Tags of the main lane's data fetcher waiting on a response, summed over
+    * every cycle, and cycles every tag is waiting. Many cycles with every tag
+    * waiting mean the lane is bound by memory latency, rather than by how
+    * fast it issues requests. */
+  val OCCUPANCY_TOTAL = 29
+  val TAGS_FULL_CYCLES = 30
+  val NUM_COUNTERS = 31
+
+  /** Width of latencies. Anything in the last bucket may have wrapped. */
+  val LATENCY_BITS = 16
+  /** Width of the most any counter may count up by in one cycle. */
+  val EVENT_BITS = LATENCY_BITS
+
+  /** The histogram bucket a latency falls in. */
+  def latencyBucket(latency: UInt): UInt = {
+    val last = (LATENCY_BUCKETS - 1).U
+    val bucket = Log2(latency) - 1.U
+    Mux(latency < 4.U, 0.U, Mux(latency >= (1 << (LATENCY_BUCKETS + 1)).U, last, bucket))
+  }
+}
+
+/** A bank of free-running event counters, read one at a time.
+  *
+  * Each cycle, every counter counts up by its event. Most events are Bools, so
+  * count by 1, but totals count up by more. Counters are as wide as the core's
+  * registers, so never wrap in practice.
+  *
+  * @param numCounters Number of counters, one per event.
+  */
+class PerfCounters(val xLen: Int)(val numCounters: Int = PerfCounters.NUM_COUNTERS) extends Module {
+  val io = IO(new Bundle {
+    val events = Input(Vec(numCounters, UInt(PerfCounters.EVENT_BITS.W)))
+    // Set every counter back to 0
+    val clear = Input(Bool())
+    val select = Input(UInt(xLen.W))
+    // Value of the selected counter, 0 for counters that do not exist
+    val value = Output(UInt(xLen.W))
+  })
+
+  val counters = RegInit(VecInit(Seq.fill(numCounters)(0.U(xLen.W))))
+  for ((counter, event) <- counters.zip(io.events)) {
+    when(io.clear) {
+      counter := 0.U
+    } .otherwise {
+      counter := counter + event
+    }
+  }
+
+  io.value := Mux(io.select < numCounters.U, counters(io.select(log2Up(numCounters) - 1, 0)), 0.U)
+}
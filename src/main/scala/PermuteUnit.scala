@@ -11,15 +11,40 @@ object PermuteUnit {
 
     def FN_DEFAULT = BitPat.dontCare(SZ_PermuteUnit_FN)
     def FN_PERMUTE = BitPat(34.U(SZ_PermuteUnit_FN.W))
+    def FN_HISTOGRAM = BitPat(71.U(SZ_PermuteUnit_FN.W))
+    def FN_RANK = BitPat(72.U(SZ_PermuteUnit_FN.W))
+
+    /** Does this function scatter its results relative to a fixed destination
+      * base address? */
+    def isScatter(fn: UInt): Bool = fn === FN_PERMUTE || fn === FN_RANK
+
+    /** Is this function handled by the permute unit? */
+    def isPermuteUnit(fn: UInt): Bool = isScatter(fn) || fn === FN_HISTOGRAM
 }
 
-class PermuteUnit(val xLen: Int)(val batchSize: Int) extends Module {
+/** Moves elements to new positions in the destination vector.
+  *
+  * It also holds the digit counters for radix sorting. A radix sort pass is
+  * a HISTOGRAM, which counts how many keys have each value of a digit, then
+  * a RANK, which scatters the keys to their stable sorted position by that
+  * digit. The counters are kept between the two instructions.
+  *
+  * @param radixBits Width of a radix sort digit. There are 2^radixBits
+  * counters.
+  */
+class PermuteUnit(val xLen: Int)(val batchSize: Int, val radixBits: Int = 4) extends Module {
     import PermuteUnit._
     val io = IO(new Bundle {
         val fn = Input(Bits(SZ_PermuteUnit_FN.W))
-        val index = Input(Vec(batchSize, new DataIO(xLen)))
-        val data = Input(Vec(batchSize, new DataIO(xLen)))
-        val default = Input(new DataIO(xLen))
+        val index = Input(Vec(batchSize, UInt(xLen.W)))
+        val data = Input(Vec(batchSize, UInt(xLen.W)))
+        val default = Input(UInt(xLen.W))
+        // Bit offset of the radix sort digit inside each key
+        val shift = Input(UInt(xLen.W))
+        // Lanes of data holding elements of the vector this round
+        val mask = Input(UInt(batchSize.W))
+        /* Unlike every other unit, each element of the output carries its
+         * own address, because they are scattered over the destination. */
         val out = Output(Valid(Vec(batchSize, new DataIO(xLen))))
         val baseAddress = Input(UInt(xLen.W))
         val execute = Input(Bool())
@@ -32,20 +57,71 @@ class PermuteUnit(val xLen: Int)(val batchSize: Int) extends Module {
     io.out.bits := workingSpace
     io.out.valid := false.B
 
+    val numBuckets = 1 << radixBits
+    /* The counters must survive between a HISTOGRAM and its RANK, so unlike
+     * everything else here they are not reset when the accelerator is idle.
+     * HISTOGRAM clears them when it starts, and RANK turns them into the
+     * running destination offset of each bucket. */
+    val buckets = RegInit(VecInit(Seq.fill(numBuckets)(0.U(xLen.W))))
+
+    /* Goes high after the first batch of an instruction, so the first batch
+     * can (re)initialize the counters. */
+    val started = withReset(io.accelIdle) {
+        RegInit(false.B)
+    }
+    when(io.out.valid) {
+        started := true.B
+    }
+
+    /* Keys are signed. Flipping their sign bits puts negative keys below
+     * positive ones, so the digit holding bit 63 sorts them in order. */
+    val signBit = (BigInt(1) << (xLen - 1)).U(xLen.W)
+    val digits = VecInit(io.data.map(x => ((x ^ signBit) >> io.shift(5, 0))(radixBits - 1, 0)))
+    val laneValid = io.mask.asBools
+    /* How many of this batch's keys fall into each bucket. */
+    val batchCounts = VecInit((0 until numBuckets).map { b =>
+        PopCount((0 until batchSize).map(i => laneValid(i) && digits(i) === b.U))
+    })
+    /* Exclusive scan of the counters, giving the first index of each bucket
+     * in the sorted vector. */
+    val bucketStarts = VecInit(buckets.scanLeft(0.U(xLen.W))(_ + _).init)
+
     when(io.execute){
         switch(io.fn){
             /* Permutation works by moving the input data to a different
              * address in the output based on the provided index. */
             is(34.U){
                 for (i <- 0 until batchSize) {
-                    workingSpace(i).data := io.data(i).data
-                    workingSpace(i).addr := io.baseAddress + (io.index(i).data * 8.U)
+                    workingSpace(i).data := io.data(i)
+                    workingSpace(i).addr := io.baseAddress + (io.index(i) * 8.U)
                 }
                 /* A permute is "essentially" an O(1) operation on this scale,
                  * since we know the index and we know the base address. A
                  * permute turns into just a left-shift and an addition. */
                 io.out.valid := true.B
             }
+            is(71.U){
+                // HISTOGRAM
+                for (b <- 0 until numBuckets) {
+                    buckets(b) := Mux(started, buckets(b), 0.U) + batchCounts(b)
+                }
+                io.out.valid := true.B
+            }
+            is(72.U){
+                // RANK
+                val offsets = Mux(started, buckets, bucketStarts)
+                for (i <- 0 until batchSize) {
+                    /* Keys with the same digit keep their order, so each key
+                     * goes after the ones in lower lanes sharing its digit. */
+                    val before = PopCount((0 until i).map(j => digits(j) === digits(i)))
+                    workingSpace(i).data := io.data(i)
+                    workingSpace(i).addr := io.baseAddress + ((offsets(digits(i)) + before) * 8.U)
+                }
+                for (b <- 0 until numBuckets) {
+                    buckets(b) := offsets(b) + batchCounts(b)
+                }
+                io.out.valid := true.B
+            }
         }
     }
 }
@@ -0,0 +1,70 @@
+package vcoderocc
+
+import chisel3._
+import chisel3.util._
+
+/** A range of bytes in memory an operation touches. */
+class MemRange(xLen: Int) extends Bundle {
+  val valid = Bool()
+  val base = UInt(xLen.W)
+  val bytes = UInt(xLen.W)
+}
+
+object MemRange {
+  def apply(xLen: Int, valid: Bool, base: UInt, bytes: UInt): MemRange = {
+    val r = Wire(new MemRange(xLen))
+    r.valid := valid
+    r.base := base
+    r.bytes := bytes
+    r
+  }
+
+  /** Do ranges a & b share at least one byte? The ends are computed a bit
+    * wider, so a range running to the top of memory does not wrap around. */
+  def overlaps(a: MemRange, b: MemRange): Bool =
+    a.valid && b.valid && a.base < (b.base +& b.bytes) && b.base < (a.base +& a.bytes)
+}
+
+/** Every range of memory a vector operation may read from or write to. */
+class Footprint(xLen: Int) extends Bundle {
+  val reads = Vec(3, new MemRange(xLen))
+  val write = new MemRange(xLen)
+}
+
+/** Memory dependency checks between operations running on different lanes of
+  * the accelerator.
+  *
+  * Footprints are conservative. Every operand and destination is assumed to be
+  * twice numOperands elements long, which covers a MERGE's output, or to run
+  * on without end once strides or a 2-D shape are set. rsX are only treated as
+  * addresses when the operation fetches from them. Overlapping footprints only
+  * cost a stall, never a wrong result.
+  */
+object Scoreboard {
+  def footprint(xLen: Int, ctrlSigs: CtrlSigs, rs1: UInt, rs2: UInt,
+    config: ControlConfig): Footprint = {
+    val fp = Wire(new Footprint(xLen))
+    val fetches = ctrlSigs.numMemFetches
+    val unbounded = ~0.U(xLen.W)
+    val bytes = Mux(config.contiguous, config.numOperands << 4, unbounded)
+    // A strided copy reads rs2 elements apart, so could read anywhere past rs1.
+    val rs1Bytes = Mux(ctrlSigs.aluFn === ALU.FN_COPY_STRIDED, unbounded, bytes)
+    fp.reads(0) := MemRange(xLen, fetches =/= NumOperatorOperands.MEM_OPS_ZERO, rs1, rs1Bytes)
+    fp.reads(1) := MemRange(xLen, fetches === NumOperatorOperands.MEM_OPS_TWO ||
+      fetches === NumOperatorOperands.MEM_OPS_THREE, rs2, bytes)
+    fp.reads(2) := MemRange(xLen, fetches === NumOperatorOperands.MEM_OPS_THREE, config.rs3, bytes)
+    // HISTOGRAM, READ_ACCUMULATOR & READ_COUNTER do not write to memory at all.
+    fp.write := MemRange(xLen, ctrlSigs.isMemOp &&
+      ctrlSigs.aluFn =/= PermuteUnit.FN_HISTOGRAM &&
+      ctrlSigs.aluFn =/= ALU.FN_READ_ACCUMULATOR &&
+      ctrlSigs.aluFn =/= PerfCounters.FN_READ_COUNTER, config.destAddr, bytes)
+    fp
+  }
+
+  /** Must operations with footprints a & b run one after the other? They must
+    * if either writes memory the other reads or writes. */
+  def conflicts(a: Footprint, b: Footprint): Bool =
+    MemRange.overlaps(a.write, b.write) ||
+    a.reads.map(MemRange.overlaps(_, b.write)).reduce(_ || _) ||
+    b.reads.map(MemRange.overlaps(_, a.write)).reduce(_ || _)
+}
@@ -0,0 +1,188 @@
+package vcoderocc
+
+import chisel3._
+import chisel3.util._
+
+/** Externally-visible properties of the sorting unit.
+  * The function codes share the same space as the ALU's, so they must never
+  * overlap with them.
+  */
+object SortUnit {
+  val SZ_SORT_FN = 7
+
+  def FN_SORT_BATCH = BitPat(73.U(SZ_SORT_FN.W))
+  def FN_MERGE = BitPat(74.U(SZ_SORT_FN.W))
+
+  /** Is this function handled by the sorting unit? */
+  def isSort(fn: UInt): Bool = fn === FN_SORT_BATCH || fn === FN_MERGE
+
+  /** A single compare-exchange of a sorting network. Puts the smaller of lanes
+    * lo & hi into lo when ascending, and into hi otherwise. */
+  case class CompareExchange(lo: Int, hi: Int, ascending: Boolean)
+
+  /** Stages of a bitonic sorter for n = 2^k lanes. Every stage touches every
+    * lane exactly once. */
+  def bitonicSort(n: Int): Seq[Seq[CompareExchange]] =
+    for {
+      k <- Iterator.iterate(2)(_ * 2).takeWhile(_ <= n).toSeq
+      j <- Iterator.iterate(k / 2)(_ / 2).takeWhile(_ >= 1).toSeq
+    } yield for {
+      i <- 0 until n
+      l = i ^ j
+      if l > i
+    } yield CompareExchange(i, l, (i & k) == 0)
+
+  /** Stages of a bitonic merger, which sorts a bitonic sequence of n = 2^k
+    * lanes into ascending order. */
+  def bitonicMerge(n: Int): Seq[Seq[CompareExchange]] =
+    for {
+      j <- Iterator.iterate(n / 2)(_ / 2).takeWhile(_ >= 1).toSeq
+    } yield for {
+      i <- 0 until n
+      l = i ^ j
+      if l > i
+    } yield CompareExchange(i, l, true)
+}
+
+/** Sorts batches of signed integers with bitonic networks.
+  *
+  * SORT_BATCH sorts each batch on its own, producing sorted runs of batchSize
+  * elements. MERGE merges two sorted vectors a batch at a time. The unit holds
+  * back the upper half of everything it has merged so far (the carry), merges
+  * it with the next batch and outputs the lower half. The control unit fetches
+  * each next batch from whichever vector's last fetched batch ended with the
+  * smaller value, which guarantees that the lower half is final.
+  *
+  * @param compareStages Number of pipeline stages in each comparator of the
+  * networks.
+  */
+class SortUnit(val xLen: Int)(val batchSize: Int, val compareStages: Int = 1) extends Module {
+  import SortUnit._
+  val io = IO(new Bundle {
+    val fn = Input(Bits(SZ_SORT_FN.W))
+    val in1 = Input(Vec(batchSize, UInt(xLen.W)))
+    val in2 = Input(Vec(batchSize, UInt(xLen.W)))
+    // Lanes of in1 holding elements of the vector this round
+    val mask = Input(UInt(batchSize.W))
+    // Lanes of in2 holding elements, in the first round of a merge
+    val mask2 = Input(UInt(batchSize.W))
+    // The batch in in1 came from the second vector of the merge
+    val mergeFromB = Input(Bool())
+    // Both vectors of the merge are used up. Output whatever is left.
+    val mergeFlush = Input(Bool())
+    // The next batch to merge should come from the second vector
+    val nextFromB = Output(Bool())
+    val out = Output(Valid(Vec(batchSize, UInt(xLen.W))))
+    val execute = Input(Bool())
+    val accelIdle = Input(Bool())
+  })
+
+  val workingSpace = withReset(io.accelIdle) {
+    RegInit(VecInit(Seq.fill(batchSize)(0.U(xLen.W))))
+  }
+  io.out.bits := workingSpace
+  io.out.valid := false.B
+
+  // See the ALU for why this is built this way.
+  val pipelineStart = withReset(!io.execute) {
+    io.execute && !RegNext(io.execute)
+  }
+
+  /** Build a sorting network out of pipelined comparators.
+    * Each stage of the network is a rank of comparators, so the result comes
+    * out compareStages cycles per stage after the input was valid. */
+  def network(stages: Seq[Seq[CompareExchange]], in: Seq[SInt], valid: Bool): (Seq[SInt], Bool) = {
+    stages.foldLeft((in, valid)) { case ((lanes, v), stage) =>
+      // Lanes that this stage does not touch still have to stay in step.
+      val next = Array.tabulate(lanes.length)(i => ShiftRegister(lanes(i), compareStages))
+      for (ce <- stage) {
+        val comparators = Seq(ComparatorOp.min, ComparatorOp.max).map { fn =>
+          val comparator = Module(new Comparator(xLen, compareStages))
+          comparator.io.req.valid := v
+          comparator.io.req.bits.fn := fn
+          comparator.io.req.bits.unsigned := false.B
+          comparator.io.req.bits.in1 := lanes(ce.lo)
+          comparator.io.req.bits.in2 := lanes(ce.hi)
+          comparator.io.resp.bits.data
+        }
+        val (smaller, larger) = (comparators(0), comparators(1))
+        next(ce.lo) = if (ce.ascending) smaller else larger
+        next(ce.hi) = if (ce.ascending) larger else smaller
+      }
+      (next.toSeq, ShiftRegister(v, compareStages))
+    }
+  }
+
+  val sIntMax = ((BigInt(1) << (xLen - 1)) - 1).S(xLen.W)
+
+  /* Lanes past the end of the vector are filled with the largest value, so
+   * they sort to the end, where they are not written back. The same goes for
+   * the last batch of a merged vector whose length is not a multiple of
+   * batchSize. */
+  def padded(in: Vec[UInt], mask: UInt): Vec[SInt] =
+    VecInit((0 until batchSize).map(i => Mux(mask(i), in(i).asSInt, sIntMax)))
+  val sortIn = padded(io.in1, io.mask)
+  val in2 = padded(io.in2, io.mask2)
+  val (sorted, sortedValid) = network(bitonicSort(batchSize), sortIn, pipelineStart)
+
+  /* Merge state. started separates the first round, which merges the first
+   * batch of both vectors, from the rest, which merge the carry with one new
+   * batch. */
+  val started = withReset(io.accelIdle) {
+    RegInit(false.B)
+  }
+  val carry = Reg(Vec(batchSize, SInt(xLen.W)))
+  val lastA = Reg(SInt(xLen.W))
+  val lastB = Reg(SInt(xLen.W))
+  // Ties go to the first vector, so the merge is stable.
+  io.nextFromB := lastB < lastA
+
+  /* Two ascending sequences make a bitonic one when the second is reversed. */
+  val mergeLow = Mux(started, carry, sortIn)
+  val mergeHigh = Mux(started, sortIn, in2)
+  val (merged, mergedValid) = network(bitonicMerge(2 * batchSize),
+    mergeLow ++ mergeHigh.reverse, pipelineStart && !io.mergeFlush)
+
+  when(io.execute) {
+    switch(io.fn) {
+      is(73.U) {
+        // SORT BATCH
+        when(sortedValid) {
+          for (i <- 0 until batchSize) {
+            workingSpace(i) := sorted(i).asUInt
+          }
+        }
+        io.out.valid := sortedValid
+      }
+      is(74.U) {
+        // MERGE
+        when(pipelineStart && !io.mergeFlush) {
+          when(!started) {
+            lastA := sortIn(batchSize - 1)
+            lastB := in2(batchSize - 1)
+          } .elsewhen(io.mergeFromB) {
+            lastB := sortIn(batchSize - 1)
+          } .otherwise {
+            lastA := sortIn(batchSize - 1)
+          }
+        }
+
+        when(io.mergeFlush) {
+          for (i <- 0 until batchSize) {
+            workingSpace(i) := carry(i).asUInt
+          }
+          io.out.valid := true.B
+        } .otherwise {
+          when(mergedValid) {
+            for (i <- 0 until batchSize) {
+              workingSpace(i) := merged(i).asUInt
+              carry(i) := merged(batchSize + i)
+            }
+            started := true.B
+          }
+          io.out.valid := mergedValid
+        }
+      }
+    }
+  }
+}
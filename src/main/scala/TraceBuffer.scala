@@ -0,0 +1,139 @@
+package vcoderocc
+
+import chisel3._
+import chisel3.util._
+
+/** Externally-visible properties of the trace buffer.
+  * The function code shares the same space as the ALU's, so it must never
+  * overlap with them.
+  */
+object TraceBuffer {
+  val SZ_TRACE_FN = 7
+
+  def FN_DRAIN_TRACE = BitPat(80.U(SZ_TRACE_FN.W))
+
+  /* Every record is one 64-bit word: the cycle it happened in (bits 63-32),
+   * what happened (bits 31-24) and an argument (bits 23-0). The cycle wraps,
+   * so only the differences between records mean anything. */
+  val CYCLE_BITS = 32
+  val KIND_BITS = 8
+  val ARG_BITS = 24
+
+  /* What happened. 0 marks a word past the end of the trace. */
+  /** A lane's control unit changed state. arg is the lane (bit 8) and the
+    * state it moved to (bits 7-0), numbered as in ControlUnit.State. */
+  val EV_STATE = 1
+  /** A lane's data fetcher started or finished a round of requests. arg is
+    * the lane (bit 23), whether it writes (bit 22) and the number of
+    * elements (bits 21-0). */
+  val EV_FETCH_START = 2
+  val EV_FETCH_DONE = 3
+  /** An instruction was issued to a lane. arg is the lane (bit 8) and the
+    * instruction's funct7 (bits 6-0). */
+  val EV_OP_START = 4
+  /** A lane finished its instruction and went back to idle. arg is the
+    * lane (bit 8). */
+  val EV_OP_END = 5
+
+  /** Build an event, with its argument cut down to ARG_BITS. */
+  def event(valid: Bool, kind: Int, arg: UInt): Valid[TraceEvent] = {
+    val ev = Wire(Valid(new TraceEvent))
+    ev.valid := valid
+    ev.bits.kind := kind.U
+    ev.bits.arg := arg.pad(ARG_BITS)(ARG_BITS - 1, 0)
+    ev
+  }
+}
+
+class TraceEvent extends Bundle {
+  val kind = UInt(TraceBuffer.KIND_BITS.W)
+  val arg = UInt(TraceBuffer.ARG_BITS.W)
+}
+
+/** Records events into an on-chip ring buffer, for draining to memory.
+  *
+  * Unlike printf debugging, this barely slows simulation down and can be
+  * built into an FPGA. Any number of the events can happen in the same cycle. Once
+  * the buffer is full, each new record overwrites the oldest one.
+  *
+  * DRAIN_TRACE writes the records out like any other vector, oldest first, a
+  * batch at a time, and removes them from the buffer. The drain works on the
+  * records there when it started. Events can still be recorded meanwhile, and
+  * are kept for the next drain. Whoever drives events must keep the lane
+  * running the drain quiet, so draining does not trace itself.
+  *
+  * @param entries Number of records the buffer holds. Must be a power of 2.
+  * @param numEvents Number of events that may be recorded each cycle.
+  */
+class TraceBuffer(val xLen: Int)(val batchSize: Int, val entries: Int, val numEvents: Int) extends Module {
+  import TraceBuffer._
+  require(isPow2(entries) && entries >= 2 && entries >= numEvents,
+    "TraceBuffer entries must be a power of 2, and hold a cycle's worth of events!")
+  val io = IO(new Bundle {
+    val events = Input(Vec(numEvents, Valid(new TraceEvent)))
+    // A DRAIN_TRACE is running
+    val draining = Input(Bool())
+    // Hand the next batch of records to out
+    val execute = Input(Bool())
+    // Most records the drain may write
+    val numOperands = Input(UInt(xLen.W))
+    // Records the drain writes, the rest of its output is 0
+    val drained = Output(UInt(xLen.W))
+    val out = Output(Valid(Vec(batchSize, UInt(xLen.W))))
+  })
+
+  val indexBits = log2Up(entries)
+  /** Slot of the buffer i records after slot base. */
+  def slot(base: UInt, i: UInt): UInt = (base + i)(indexBits - 1, 0)
+
+  val records = Reg(Vec(entries, UInt(xLen.W)))
+  // Where the next record goes, and how many records the buffer holds.
+  val head = RegInit(0.U(indexBits.W))
+  val count = RegInit(0.U(log2Up(entries + 1).W))
+  val cycle = RegInit(0.U(CYCLE_BITS.W))
+  cycle := cycle + 1.U
+
+  val valids = io.events.map(_.valid)
+  for ((ev, k) <- io.events.zipWithIndex) {
+    // Events in the same cycle are recorded in the order they are listed.
+    val offset = if (k == 0) 0.U else PopCount(valids.take(k))
+    when(valids(k)) {
+      records(slot(head, offset)) := Cat(cycle, ev.bits.kind, ev.bits.arg)
+    }
+  }
+  val recorded = PopCount(valids)
+  head := slot(head, recorded)
+
+  /* Draining. The oldest record & the number of records are taken as the
+   * drain starts, so records made during it are not drained. pos counts the
+   * records handed out so far. The drained records leave the buffer once the
+   * drain is over. */
+  val drainStart = io.draining && !RegNext(io.draining, false.B)
+  val drainEnd = RegNext(io.draining, false.B) && !io.draining
+  val startTail = Reg(UInt(indexBits.W))
+  val startCount = Reg(UInt(log2Up(entries + 1).W))
+  when(drainStart) {
+    startTail := (head - count)(indexBits - 1, 0)
+    startCount := count
+  }
+  val tail = Mux(drainStart, (head - count)(indexBits - 1, 0), startTail)
+  val available = Mux(drainStart, count, startCount)
+  val pos = withReset(!io.draining) { RegInit(0.U(xLen.W)) }
+  io.drained := Mux(io.numOperands < available, io.numOperands, available)
+  // Records overwritten during the drain may already have left the buffer.
+  val removed = Mux(drainEnd, RegNext(io.drained), 0.U)
+  val kept = Mux(count > removed, count - removed, 0.U)
+  val filled = kept +& recorded
+  count := Mux(filled > entries.U, entries.U, filled)
+
+  val workingSpace = RegInit(VecInit(Seq.fill(batchSize)(0.U(xLen.W))))
+  io.out.bits := workingSpace
+  io.out.valid := io.execute
+  when(io.execute) {
+    for (i <- 0 until batchSize) {
+      val j = pos + i.U
+      workingSpace(i) := Mux(j < available, records(slot(tail, j)), 0.U)
+    }
+    pos := pos + batchSize.U
+  }
+}
@@ -21,7 +21,6 @@ import PermuteUnit._
 class VCodeAccel(opcodes: OpcodeSet, batchSize: Int)(implicit p: Parameters) extends LazyRoCC(opcodes) {
   // batchSize must be power of 2 to make certain ops on counters efficient
   require(isPow2(batchSize), "VCode accelerator batchSize must be power of 2!")
-  require((batchSize <= 64), "VCode accelerator batchSize must not be greater than 64!")
   override lazy val module = new VCodeAccelImp(this, batchSize)
 }
 
@@ -37,18 +36,73 @@ class VCodeAccel(opcodes: OpcodeSet, batchSize: Int)(implicit p: Parameters) ext
 class VCodeAccelImp(outer: VCodeAccel, batchSize: Int) extends LazyRoCCModuleImp(outer) {
   // io is "implicit" because we inherit from LazyRoCCModuleImp.
   // io is the RoCCCoreIO
+  val core = Module(new VCodeCore(batchSize))
+  core.io.cmd <> io.cmd
+  io.resp <> core.io.resp
+  io.mem.req <> core.io.mem.req
+  core.io.mem.resp := io.mem.resp
+  io.busy := core.io.busy
+  io.interrupt := core.io.interrupt
+
+  /* LazyRoCC class contains two TLOutputNode instances, atlNode and tlNode.
+   * atlNode connects into a tile-local arbiter along with the backside of the
+   * L1 instruction cache.
+   * tlNode connects directly to the L1-L2 crossbar. The corresponding Tilelink
+   * ports in the module implementation’s IO bundle are atl and tl, respectively. */
+}
+
+/** The parts of the L1 data cache port the accelerator uses. */
+class VCodeMemIO(implicit p: Parameters) extends Bundle {
+  val req = Decoupled(new HellaCacheReq)
+  val resp = Flipped(Valid(new HellaCacheResp))
+}
+
+/** The parts of the RoCCCoreIO the accelerator uses. */
+class VCodeCoreIO(implicit p: Parameters) extends Bundle {
+  val cmd = Flipped(Decoupled(new RoCCCommand))
+  val resp = Decoupled(new RoCCResponse)
+  val mem = new VCodeMemIO
+  val busy = Output(Bool())
+  val interrupt = Output(Bool())
+}
+
+/** Everything of the VCODE accelerator inside the RoCC interface.
+  *
+  * This is a plain Module, free of diplomacy, so test benches can build the
+  * accelerator on its own and play the core & L1 data cache themselves.
+  */
+class VCodeCore(batchSize: Int)(implicit p: Parameters) extends Module {
+  val io = IO(new VCodeCoreIO)
   val xLen = p(TileKey).core.xLen
   val rocc_io = io
   val cmd = rocc_io.cmd
+
+  /***************
+   * ISSUE
+   * The accelerator has two lanes, each with its own control unit, data
+   * fetcher and operand buffers. Instructions for the permute unit run on the
+   * permute lane, everything else on the main lane. An instruction on one lane
+   * can run while the other lane is busy, as long as neither writes memory the
+   * other touches.
+   **************/
+  val issueDecoder = Module(new Decoder)
+  issueDecoder.io.roccInst := cmd.bits.inst
+  val issueSigs = issueDecoder.io.ctrlSigs
+  val toPermuteLane = issueSigs.legal && isPermuteUnit(issueSigs.aluFn)
+  val isConfig = issueSigs.legal && !issueSigs.isMemOp
+
   val roccCmd = Reg(new RoCCCommand)
   val cmdValid = RegInit(false.B)
 
   val roccInst = roccCmd.inst // The customX instruction in instruction stream
   val returnReg = roccInst.rd
   val status = roccCmd.status
-  when(cmd.fire) {
-    roccCmd := cmd.bits // The entire RoCC Command provided to the accelerator
-    cmdValid := true.B
+
+  val permCmd = Reg(new RoCCCommand)
+  val permCmdValid = RegInit(false.B)
+  when(cmd.fire && toPermuteLane) {
+    permCmd := cmd.bits
+    permCmdValid := true.B
   }
 
   /***************
@@ -60,21 +114,78 @@ class VCodeAccelImp(outer: VCodeAccel, batchSize: Int) extends LazyRoCCModuleImp
   decoder.io.roccInst := roccCmd.inst
   ctrlSigs := decoder.io.ctrlSigs
 
+  val permDecoder = Module(new Decoder)
+  val permSigs = Wire(new CtrlSigs(xLen))
+  permDecoder.io.roccInst := permCmd.inst
+  permSigs := permDecoder.io.ctrlSigs
+
   /***************
    * CONTROL UNIT
    * Control unit connects ALU, Permute unit & Data fetcher together, properly sequencing them
    **************/
   val ctrlUnit = Module(new ControlUnit(batchSize))
-  // Accelerator control unit controls when we are ready to accept the next
-  // instruction from the RoCC command queue. Cannot accept another command
-  // unless accelerator is ready/idle
-  cmd.ready := ctrlUnit.io.accelReady
   ctrlUnit.io.cmdValid := cmdValid
-  // RoCC must assert RoCCCoreIO.busy line high when memory actions happening
-  rocc_io.busy := ctrlUnit.io.busy
   ctrlUnit.io.roccCmd := roccCmd
   ctrlUnit.io.ctrlSigs := ctrlSigs
-  ctrlUnit.io.responseCompleted := rocc_io.resp.fire
+  ctrlUnit.io.loadConfig.valid := false.B
+  ctrlUnit.io.loadConfig.bits := DontCare
+  /* Configuration staged behind a running operation is handled by the control
+   * unit alone. It must not replace the operation's command. */
+  val toMainLane = cmd.fire && !toPermuteLane && ctrlUnit.io.accelReady
+  when(toMainLane) {
+    roccCmd := cmd.bits // The entire RoCC Command provided to the accelerator
+    cmdValid := true.B
+  }
+  // Sub-word support depends on the element width the main lane is set up with.
+  issueDecoder.io.elementWidth := ctrlUnit.io.config.elementWidth
+  decoder.io.elementWidth := ctrlUnit.io.config.elementWidth
+  /* Configuration instructions are applied as they are accepted, so the
+   * configuration and footprint of the instruction accepted right after one
+   * already include it. */
+  ctrlUnit.io.configCmd.valid := cmd.fire && isConfig
+  ctrlUnit.io.configCmd.bits := cmd.bits
+
+  /* Configuration instructions always go to the main lane. The permute lane
+   * runs with whatever the main lane was configured with when the instruction
+   * was issued, including settings staged behind a running main-lane
+   * instruction. */
+  val permCtrl = Module(new ControlUnit(batchSize))
+  permCtrl.io.cmdValid := permCmdValid
+  permCtrl.io.roccCmd := permCmd
+  permCtrl.io.ctrlSigs := permSigs
+  permCtrl.io.loadConfig.valid := cmd.fire && toPermuteLane
+  permCtrl.io.loadConfig.bits := ctrlUnit.io.config
+  permCtrl.io.configCmd.valid := false.B
+  permDecoder.io.elementWidth := permCtrl.io.config.elementWidth
+  permCtrl.io.configCmd.bits := DontCare
+  permCtrl.io.mergeNextFromB := false.B
+  permCtrl.io.writeClusterDone := false.B
+
+  /* The scoreboard holds the memory each lane's instruction touches. Either
+   * lane may only start an instruction that does not conflict with the one
+   * running on the other lane. */
+  val permInFlight = permCmdValid || permCtrl.io.busy
+  val mainInFlight = cmdValid || ctrlUnit.io.busy
+  val issueFootprint = Scoreboard.footprint(xLen, issueSigs, cmd.bits.rs1, cmd.bits.rs2, ctrlUnit.io.config)
+  val permFootprint = Reg(new Footprint(xLen))
+  val mainFootprint = Reg(new Footprint(xLen))
+  when(cmd.fire && toPermuteLane) {
+    permFootprint := issueFootprint
+  }
+  when(toMainLane) {
+    mainFootprint := issueFootprint
+  }
+  val hazard = permInFlight && issueSigs.isMemOp && Scoreboard.conflicts(issueFootprint, permFootprint)
+  val permHazard = mainInFlight && Scoreboard.conflicts(issueFootprint, mainFootprint)
+
+  // Accelerator control unit controls when we are ready to accept the next
+  // instruction from the RoCC command queue. Cannot accept another command
+  // unless the lane it goes to is ready/idle
+  cmd.ready := MuxCase(ctrlUnit.io.accelReady && !hazard, Seq(
+    toPermuteLane -> (!permInFlight && !permHazard),
+    isConfig -> ctrlUnit.io.configReady))
+  // RoCC must assert RoCCCoreIO.busy line high when memory actions happening
+  rocc_io.busy := ctrlUnit.io.busy || permInFlight
 
   // If invalid instruction, raise exception
   val exception = cmdValid && !ctrlSigs.legal
@@ -104,86 +215,219 @@ class VCodeAccelImp(outer: VCodeAccel, batchSize: Int) extends LazyRoCCModuleImp
    * Most instructions pass pointers to vectors, so we need to fetch that before
    * operating on the data.
    **************/
-  val dataFetcher = Module(new DCacheFetcher(batchSize))
-  dataFetcher.io.ctrlSigs := ctrlSigs
-  dataFetcher.io.mstatus := status
-  ctrlUnit.io.memOpCompleted := dataFetcher.io.opCompleted
+  /** Build the data fetcher for a lane, and the operand buffers it fills.
+    * @param scatter The lane writes every element to its own address.
+    * @return The fetcher and its rs1, rs2 & rs3 operand buffers. */
+  def laneFetcher(ctrl: ControlUnit, sigs: CtrlSigs, mstatus: MStatus, scatter: Boolean = false) = {
+    /* The lowest bit of the L1 data cache's request tag is the lane's, which
+     * leaves the rest for requests in flight. */
+    val maxInFlight = 1 << (p(TileKey).core.dcacheReqTagBits - 1)
+    val fetcher = Module(new DCacheFetcher(batchSize, scatter, maxInFlight))
+    fetcher.io.ctrlSigs := sigs
+    fetcher.io.mstatus := mstatus
+    ctrl.io.memOpCompleted := fetcher.io.opCompleted
+    ctrl.io.headerLength := fetcher.io.fetchedData.bits.data(0)
+
+    when(ctrl.io.writebackReady) {
+      fetcher.io.opToPerform := MemoryOperation.write
+    } .otherwise {
+      fetcher.io.opToPerform := MemoryOperation.read
+    }
+
+    val addrToFetch = ctrl.io.baseAddress
+    // FIXME: Should not need to rely on op_completed boolean
+    when((ctrl.io.shouldFetch || ctrl.io.writebackReady) &&
+      !fetcher.io.opCompleted && fetcher.io.baseAddress.ready) {
+      // Queue addrs and set valid bit
+      fetcher.io.baseAddress.enq(addrToFetch)
+      if(p(VCodePrintfEnable)) {
+        printf("VCode\tEnqueued addresses to data fetcher\n")
+        printf("\tBase Address: 0x%x\tvalid? %d\n",
+          fetcher.io.baseAddress.bits, fetcher.io.baseAddress.valid)
+      }
+    } .otherwise {
+      fetcher.io.baseAddress.noenq()
+    }
+    fetcher.io.start := ctrl.io.shouldFetch || ctrl.io.writebackReady
+    fetcher.io.amountData := ctrl.io.numToFetch
+    fetcher.io.stride := ctrl.io.fetchStride
+    fetcher.io.pairAddress := ctrl.io.pairAddress
+
+    val data1 = RegInit((0.U).asTypeOf(new Batch(xLen, batchSize)))
+    val data2 = RegInit((0.U).asTypeOf(new Batch(xLen, batchSize)))
+    // SELECT flags, flagWords words of them for batches of 64 or more.
+    val flagWords = math.max(1, batchSize / 64)
+    val data3 = RegInit(0.U((flagWords * xLen).W))
+    /** One half of a paired batch, moved down to start at lane 0. */
+    def pairHalf(batch: Batch, upper: Boolean): Batch = {
+      val half = batchSize / 2
+      val offset = if (upper) half else 0
+      val out = Wire(new Batch(xLen, batchSize))
+      out.data := VecInit((0 until batchSize).map(i =>
+        if (i < half) batch.data(i + offset) else 0.U(xLen.W)))
+      out.mask := VecInit((0 until batchSize).map(i =>
+        if (i < half) batch.mask(i + offset) else false.B)).asUInt
+      out
+    }
 
-  when(ctrlUnit.io.writebackReady) {
-    dataFetcher.io.opToPerform := MemoryOperation.write
-  } .otherwise {
-    dataFetcher.io.opToPerform := MemoryOperation.read
+    // FIXME: Only use rs1/rs2 if xs1/xs2 =1, respectively.
+    when(fetcher.io.fetchedData.valid) {
+      /* TODO: Use SourceOperand here! */
+      when(ctrl.io.rs1Fetch && ctrl.io.pairAddress.valid) {
+        data1 := pairHalf(fetcher.io.fetchedData.bits, upper = false)
+        data2 := pairHalf(fetcher.io.fetchedData.bits, upper = true)
+      } .elsewhen(ctrl.io.rs1Fetch) {
+        data1 := fetcher.io.fetchedData.bits
+      } .elsewhen(ctrl.io.rs2Fetch){
+        data2 := fetcher.io.fetchedData.bits
+      } .otherwise {
+        data3 := Cat(fetcher.io.fetchedData.bits.data.take(flagWords).reverse)
+      }
+    }
+    (fetcher, data1, data2, data3)
   }
 
-  rocc_io.mem.req :<>= dataFetcher.io.req // Connect Request queue
-  dataFetcher.io.resp :<>= rocc_io.mem.resp  // Connect response queue
+  val (dataFetcher, data1, data2, data3) = laneFetcher(ctrlUnit, ctrlSigs, status)
+  val (permFetcher, permData1, permData2, permData3) = laneFetcher(permCtrl, permSigs, permCmd.status, scatter = true)
+
+  /* Both lanes share the L1 data cache port. The lowest bit of a request's tag
+   * says which lane sent it, so its response can be routed back. */
+  val fetchers = Seq(dataFetcher, permFetcher)
+  val memArbiter = Module(new RRArbiter(new HellaCacheReq, fetchers.length))
+  for ((fetcher, i) <- fetchers.zipWithIndex) {
+    memArbiter.io.in(i) <> fetcher.io.req
+    memArbiter.io.in(i).bits.tag := Cat(fetcher.io.req.bits.tag, i.U(1.W))
+    fetcher.io.resp.valid := rocc_io.mem.resp.valid && rocc_io.mem.resp.bits.tag(0) === i.U
+    fetcher.io.resp.bits := rocc_io.mem.resp.bits
+    fetcher.io.resp.bits.tag := rocc_io.mem.resp.bits.tag >> 1
+  }
+  rocc_io.mem.req :<>= memArbiter.io.out // Connect Request queue
 
   /* rsX here are just wire aliases to make using rs1/rs2 slightly shorter in
    * later portions of this file, where rsX get used more frequently. */
   val rs1 = Wire(Bits(xLen.W)); rs1 := roccCmd.rs1
   val rs2 = Wire(Bits(xLen.W)); rs2 := roccCmd.rs2
 
-  val addrToFetch = ctrlUnit.io.baseAddress
-  // FIXME: Should not need to rely on op_completed boolean
-  when((ctrlUnit.io.shouldFetch || ctrlUnit.io.writebackReady) &&
-    !dataFetcher.io.opCompleted && dataFetcher.io.baseAddress.ready) {
-    // Queue addrs and set valid bit
-    dataFetcher.io.baseAddress.enq(addrToFetch)
-    if(p(VCodePrintfEnable)) {
-      printf("VCode\tEnqueued addresses to data fetcher\n")
-      printf("\tBase Address: 0x%x\tvalid? %d\n",
-        dataFetcher.io.baseAddress.bits, dataFetcher.io.baseAddress.valid)
-    }
-  } .otherwise {
-    dataFetcher.io.baseAddress.noenq()
-  }
-  dataFetcher.io.start := ctrlUnit.io.shouldFetch || ctrlUnit.io.writebackReady
-  dataFetcher.io.amountData := ctrlUnit.io.numToFetch
-
-  val data1 = RegInit((0.U).asTypeOf(Vec(batchSize, new DataIO(xLen))))
-  val data2 = RegInit((0.U).asTypeOf(Vec(batchSize, new DataIO(xLen))))
-  val data3 = RegInit((0.U).asTypeOf(new DataIO(xLen)))
-  // FIXME: Only use rs1/rs2 if xs1/xs2 =1, respectively.
-  when(dataFetcher.io.fetchedData.valid) {
-    /* TODO: Use SourceOperand here! */
-    when(ctrlUnit.io.rs1Fetch) {
-      data1 := dataFetcher.io.fetchedData.bits
-    } .elsewhen(ctrlUnit.io.rs2Fetch){
-      data2 := dataFetcher.io.fetchedData.bits
-    } .otherwise {
-      data3 := dataFetcher.io.fetchedData.bits(0)
-    }
-  }
-
   /***************
    * EXECUTE
    **************/
-  /* TODO: Have multiple ALUs, one for each element, thus one per lane?
-   * Or have one big ALU handle a whole batchSize simultaneously? */
   // Must more specifically specify MY ALU, because freechips.rocketchip.rocket.ALU is also defined.
   // ALU processing integer instructions except permutations
-  val alu = Module(new vcoderocc.ALU(xLen)(batchSize))
-  // Hook up the ALU to VCode signals
-  alu.io.fn := ctrlSigs.aluFn
-  alu.io.in1 := data1
-  alu.io.in2 := data2
-  alu.io.in3 := data3
-  alu.io.identityVal := ctrlSigs.identityVal
-  alu.io.baseAddress := ctrlUnit.io.baseAddress
-  alu.io.execute := ctrlUnit.io.shouldExecute
-  alu.io.accelIdle := !ctrlUnit.io.busy // ctrlUnit.io.accelReady is also valid.
-
-  // Execution unit processing PERMUTE instructions
-  val permute = Module(new vcoderocc.PermuteUnit(xLen)(batchSize))
-  permute.io.fn := ctrlSigs.aluFn
-  permute.io.data := data1
-  permute.io.index := data2
-  permute.io.default := data3
-  permute.io.baseAddress := ctrlUnit.io.baseAddress
-  permute.io.execute := ctrlUnit.io.shouldExecute
-  permute.io.accelIdle := !ctrlUnit.io.busy
-
-  val exe_result = Mux(ctrlSigs.aluFn === PermuteUnit.FN_PERMUTE, permute.io.out, alu.io.out)
+  /* The first ALU cluster runs every ALU instruction. Any others only help
+   * with long-latency element-wise ones, see Ctrl's clustered. */
+  val numClusters = p(VCodeAluClusters)
+  val alus = Seq.fill(numClusters)(Module(new vcoderocc.ALU(xLen)(batchSize, p(VCodeComparatorStages))))
+  val alu = alus(0)
+  val clustered = (numClusters > 1).B && vcoderocc.ALU.isClusterable(ctrlSigs.aluFn)
+  /* Lanes past the end of the vector, or the end of a row of a 2-D vector,
+   * read as the operation's identity, so reductions & scans can fold in
+   * whole batches. */
+  def identityFilled(batch: Batch): Vec[UInt] =
+    VecInit(batch.data.zip(batch.mask.asBools).map { case (d, valid) =>
+      Mux(valid, d, ctrlSigs.identityVal) })
+  val in1 = identityFilled(data1)
+  val in2 = identityFilled(data2)
+
+  /* A cluster is busy from the batch being dispatched to it until its result
+   * is valid, and done from then until it is handed its next batch. */
+  val clusterBusy = withReset(!ctrlUnit.io.busy) { RegInit(VecInit(Seq.fill(numClusters)(false.B))) }
+  val clusterDone = withReset(!ctrlUnit.io.busy) { RegInit(VecInit(Seq.fill(numClusters)(false.B))) }
+  for ((cluster, k) <- alus.zipWithIndex) {
+    // Hook up the ALU to VCode signals
+    cluster.io.fn := ctrlSigs.aluFn
+    cluster.io.in1 := in1
+    cluster.io.in2 := in2
+    cluster.io.in3 := data3
+    cluster.io.mask := data1.mask
+    cluster.io.lastWordMask := ctrlUnit.io.lastWordMask
+    cluster.io.rs1 := rs1
+    cluster.io.rs2 := rs2
+    cluster.io.identityVal := ctrlSigs.identityVal
+    cluster.io.elementWidth := ctrlUnit.io.elementWidth
+    cluster.io.packResult := ctrlSigs.boolPacking === BoolPacking.BOOL_PACK_RESULT
+    cluster.io.accelIdle := !ctrlUnit.io.busy // ctrlUnit.io.accelReady is also valid.
+
+    when(ctrlUnit.io.clusterDispatch && ctrlUnit.io.dispatchCluster === k.U) {
+      clusterBusy(k) := true.B
+      clusterDone(k) := false.B
+    } .elsewhen(clusterBusy(k) && cluster.io.out.valid) {
+      clusterBusy(k) := false.B
+      clusterDone(k) := true.B
+    }
+  }
+  // Only the first cluster keeps accumulators, because only it runs reductions.
+  alu.io.accumulator := ctrlUnit.io.accumulator
+  /* Like RESET_COUNTERS, CLEAR_ACCUMULATOR must act only once. It clears the
+   * cycle after it is accepted, once its rs1 & rs2 are latched. */
+  alu.io.clearAccumulator := RegNext(cmd.fire && issueSigs.legal &&
+    cmd.bits.inst.funct === vcoderocc.Instructions.CLEAR_ACCUMULATOR && cmd.bits.inst.xs1, false.B)
+  alu.io.execute := Mux(clustered, clusterBusy(0), ctrlUnit.io.shouldExecute)
+  for ((cluster, k) <- alus.zipWithIndex.tail) {
+    cluster.io.accumulator := 0.U
+    cluster.io.clearAccumulator := false.B
+    cluster.io.execute := clusterBusy(k)
+  }
+  ctrlUnit.io.writeClusterDone := clusterDone(ctrlUnit.io.writeCluster)
+
+  // Results are written back in the order their batches were dispatched.
+  val clusterResult = Wire(Valid(Vec(batchSize, UInt(xLen.W))))
+  clusterResult.valid := clusterDone(ctrlUnit.io.writeCluster)
+  clusterResult.bits := VecInit(alus.map(_.io.out.bits))(ctrlUnit.io.writeCluster)
+
+  // Execution unit processing PERMUTE and radix sort instructions, on its own lane
+  val permute = Module(new vcoderocc.PermuteUnit(xLen)(batchSize, p(VCodeRadixBits)))
+  permute.io.fn := permSigs.aluFn
+  permute.io.data := permData1.data
+  permute.io.index := permData2.data
+  permute.io.default := permData3
+  permute.io.shift := permCmd.rs2
+  permute.io.mask := permData1.mask
+  permute.io.baseAddress := permCtrl.io.baseAddress
+  permute.io.execute := permCtrl.io.shouldExecute
+  permute.io.accelIdle := !permCtrl.io.busy
+  permCtrl.io.executeCompleted := permute.io.out.valid
+  permFetcher.io.dataToWrite.bits := VecInit(permute.io.out.bits.map(_.data))
+  permFetcher.io.writeAddrs.get := VecInit(permute.io.out.bits.map(_.addr))
+  permFetcher.io.dataToWrite.valid := permCtrl.io.writebackReady
+
+  // Execution unit processing double-precision floating-point instructions
+  val fpu = Module(new vcoderocc.FloatUnit(xLen)(batchSize, p(VCodeFmaLatency)))
+  fpu.io.fn := ctrlSigs.aluFn
+  fpu.io.in1 := in1
+  fpu.io.in2 := in2
+  fpu.io.identityVal := ctrlSigs.identityVal
+  fpu.io.execute := ctrlUnit.io.shouldExecute
+  fpu.io.accelIdle := !ctrlUnit.io.busy
+
+  // Execution unit processing sorting instructions
+  val sorter = Module(new vcoderocc.SortUnit(xLen)(batchSize, p(VCodeComparatorStages)))
+  sorter.io.fn := ctrlSigs.aluFn
+  sorter.io.in1 := data1.data
+  sorter.io.in2 := data2.data
+  sorter.io.mask := data1.mask
+  sorter.io.mask2 := data2.mask
+  sorter.io.mergeFromB := ctrlUnit.io.mergeFromB
+  sorter.io.mergeFlush := ctrlUnit.io.mergeFlush
+  ctrlUnit.io.mergeNextFromB := sorter.io.nextFromB
+  sorter.io.execute := ctrlUnit.io.shouldExecute
+  sorter.io.accelIdle := !ctrlUnit.io.busy
+
+  /* Copies have no execution stage. The fetched source data is written straight
+   * back out, to the destination. */
+  val copyResult = Wire(Valid(Vec(batchSize, UInt(xLen.W))))
+  copyResult.valid := true.B
+  copyResult.bits := data1.data
+
+  // Drains the trace buffer, see TRACE below. It records 4 events per lane, plus issue.
+  val trace = Module(new TraceBuffer(xLen)(batchSize, p(VCodeTraceEntries), 1 + 2 * 4))
+  val isDrain = ctrlSigs.aluFn === TraceBuffer.FN_DRAIN_TRACE
+
+  val exe_result = MuxCase(alu.io.out, Seq(
+    clustered -> clusterResult,
+    isDrain -> trace.io.out,
+    FloatUnit.isFloat(ctrlSigs.aluFn) -> fpu.io.out,
+    SortUnit.isSort(ctrlSigs.aluFn) -> sorter.io.out,
+    vcoderocc.ALU.isCopy(ctrlSigs.aluFn) -> copyResult))
   ctrlUnit.io.executeCompleted := exe_result.valid
   // assert(forall ctrlUnit.io.baseAddr <= dataToWrite.bits.addr &&
   //               dataToWrite.bits.addr < (ctrlUnit.io.baseAddr + ctrlUnit.io.totalLength * 8))
@@ -192,6 +436,88 @@ class VCodeAccelImp(outer: VCodeAccel, batchSize: Int) extends LazyRoCCModuleImp
   dataFetcher.io.dataToWrite.bits := exe_result.bits
   dataFetcher.io.dataToWrite.valid := ctrlUnit.io.writebackReady
 
+  /* In header mode, a lane finishes by writing the length of its output to
+   * the destination's header, in place of its results. */
+  for ((ctrl, fetcher) <- Seq((ctrlUnit, dataFetcher), (permCtrl, permFetcher))) {
+    when(ctrl.io.headerOut.valid) {
+      fetcher.io.dataToWrite.bits := VecInit(Seq.fill(batchSize)(ctrl.io.headerOut.bits))
+      fetcher.io.writeAddrs.foreach(_ := VecInit(Seq.fill(batchSize)(ctrl.io.baseAddress)))
+    }
+  }
+
+  /***************
+   * PERFORMANCE COUNTERS
+   * Count where the accelerator spends its cycles, without changing its
+   * timing. Read back with READ_COUNTER, see PerfCounters for what each counts.
+   **************/
+  val counters = Module(new PerfCounters(xLen)())
+  val events = Wire(Vec(PerfCounters.NUM_COUNTERS, Bool()))
+  require(ctrlUnit.State.all.length == PerfCounters.NUM_CTRL_STATES,
+    "Every control unit state needs a performance counter!")
+  for ((state, i) <- ctrlUnit.State.all.zipWithIndex) {
+    events(PerfCounters.CYCLES_IN_STATE + i) := ctrlUnit.io.state === state.asUInt
+  }
+  events(PerfCounters.PERM_BUSY_CYCLES) := permCtrl.io.busy
+  for ((fetcher, first) <- Seq((dataFetcher, PerfCounters.MAIN_REQS), (permFetcher, PerfCounters.PERM_REQS))) {
+    events(first) := fetcher.io.req.fire
+    events(first + 1) := fetcher.io.resp.valid
+    events(first + 2) := fetcher.io.req.valid && !fetcher.io.req.ready
+  }
+  // Clusters finish their batches on their own, outside of the exe state.
+  val batchDone = ctrlUnit.io.shouldExecute && exe_result.valid
+  val isFloat = FloatUnit.isFloat(ctrlSigs.aluFn)
+  val isSort = SortUnit.isSort(ctrlSigs.aluFn)
+  events(PerfCounters.ALU_BATCHES) := Mux(clustered,
+    alus.zip(clusterBusy).map { case (cluster, busy) => busy && cluster.io.out.valid }.reduce(_ || _),
+    batchDone && !isFloat && !isSort && !isDrain)
+  events(PerfCounters.FPU_BATCHES) := batchDone && isFloat
+  events(PerfCounters.SORT_BATCHES) := batchDone && isSort
+  events(PerfCounters.PERMUTE_BATCHES) := permCtrl.io.shouldExecute && permute.io.out.valid
+  val latency = dataFetcher.io.loadLatency
+  val bucket = PerfCounters.latencyBucket(latency.bits)
+  for (k <- 0 until PerfCounters.LATENCY_BUCKETS) {
+    events(PerfCounters.LATENCY_HISTOGRAM + k) := latency.valid && bucket === k.U
+  }
+  events(PerfCounters.LATENCY_TOTAL) := Mux(latency.valid, latency.bits, 0.U)
+  events(PerfCounters.OCCUPANCY_TOTAL) := dataFetcher.io.occupancy
+  events(PerfCounters.TAGS_FULL_CYCLES) := dataFetcher.io.tagsFull
+  counters.io.events := events
+  /* Unlike the other configuration instructions, RESET_COUNTERS must act only
+   * once, so it clears the counters as it is issued. */
+  counters.io.clear := cmd.fire && issueSigs.legal &&
+    cmd.bits.inst.funct === vcoderocc.Instructions.RESET_COUNTERS
+  counters.io.select := rs1
+
+  /***************
+   * TRACE
+   * Record when instructions start & end, every control unit state change,
+   * and every round of memory requests, for DRAIN_TRACE to write out. See
+   * TraceBuffer for what each record holds.
+   **************/
+  /* Only the main lane runs DRAIN_TRACE, so only its events are held back
+   * while it drains. The permute lane may be busy with an instruction issued
+   * before the drain, and its events are still recorded. */
+  val draining = ctrlUnit.io.busy && isDrain
+  val traceEvents = Seq(TraceBuffer.event(cmd.fire, TraceBuffer.EV_OP_START,
+    Cat(toPermuteLane, 0.U(1.W), cmd.bits.inst.funct))) ++
+  Seq((ctrlUnit, dataFetcher), (permCtrl, permFetcher)).zipWithIndex.flatMap {
+    case ((ctrl, fetcher), lane) =>
+      val fetchArg = Cat(lane.U(1.W), ctrl.io.writebackReady, ctrl.io.numToFetch(21, 0))
+      val quiet = if (lane == 0) draining else false.B
+      Seq(
+        TraceBuffer.event(ctrl.io.state =/= RegNext(ctrl.io.state, 0.U) && !quiet, TraceBuffer.EV_STATE,
+          Cat(lane.U(1.W), ctrl.io.state.pad(8))),
+        TraceBuffer.event(fetcher.io.baseAddress.fire && !quiet, TraceBuffer.EV_FETCH_START, fetchArg),
+        TraceBuffer.event(fetcher.io.opCompleted && !quiet, TraceBuffer.EV_FETCH_DONE, fetchArg),
+        TraceBuffer.event(RegNext(ctrl.io.busy, false.B) && !ctrl.io.busy && !quiet, TraceBuffer.EV_OP_END,
+          Cat(lane.U(1.W), 0.U(8.W))))
+  }
+  require(traceEvents.length == trace.numEvents, "Every trace event needs a slot!")
+  trace.io.events := VecInit(traceEvents)
+  trace.io.draining := draining
+  trace.io.execute := ctrlUnit.io.shouldExecute && isDrain
+  trace.io.numOperands := ctrlUnit.io.config.numOperands
+
   val responseReady = Wire(Bool())
   responseReady := ctrlUnit.io.responseReady
 
@@ -209,13 +535,39 @@ class VCodeAccelImp(outer: VCodeAccel, batchSize: Int) extends LazyRoCCModuleImp
    * wire here is a non-issue because of it. */
   val response = Wire(new RoCCResponse)
   response.rd := returnReg
-  response.data := 0.U // 0 for success. Could be number of elements processed too.
-  io.resp.bits := response
-  io.resp.valid := responseRequired && responseReady || exception
-  when(rocc_io.resp.fire) {
+  // 0 for success. Could be number of elements processed too.
+  // EXTRACT, READ_ACCUMULATOR & READ_COUNTER respond with the value they read instead.
+  // DRAIN_TRACE responds with the number of records it wrote.
+  response.data := MuxCase(0.U, Seq(
+    (ctrlSigs.aluFn === vcoderocc.ALU.FN_EXTRACT) -> data1.data(0),
+    (ctrlSigs.aluFn === vcoderocc.ALU.FN_READ_ACCUMULATOR) -> alu.io.accumulatorOut,
+    (ctrlSigs.aluFn === PerfCounters.FN_READ_COUNTER) -> counters.io.value,
+    isDrain -> trace.io.drained))
+
+  // The permute lane's instructions only ever respond with 0.
+  val permResponseRequired = RegInit(false.B)
+  when(permCmdValid && permSigs.legal && permCmd.inst.xd) {
+    permResponseRequired := true.B
+  }
+  val permResponse = Wire(new RoCCResponse)
+  permResponse.rd := permCmd.inst.rd
+  permResponse.data := 0.U
+
+  // When both lanes are done at once, the main lane responds first.
+  val mainResponds = responseRequired && responseReady || exception
+  val permResponds = permResponseRequired && permCtrl.io.responseReady
+  io.resp.bits := Mux(mainResponds, response, permResponse)
+  io.resp.valid := mainResponds || permResponds
+  ctrlUnit.io.responseCompleted := rocc_io.resp.fire && mainResponds
+  permCtrl.io.responseCompleted := rocc_io.resp.fire && !mainResponds
+  when(rocc_io.resp.fire && mainResponds) {
     responseRequired := false.B
     cmdValid := false.B
   }
+  when(rocc_io.resp.fire && !mainResponds) {
+    permResponseRequired := false.B
+    permCmdValid := false.B
+  }
 
   when(responseRequired && responseReady) {
     if(p(VCodePrintfEnable)) {
@@ -227,10 +579,4 @@ class VCodeAccelImp(outer: VCodeAccel, batchSize: Int) extends LazyRoCCModuleImp
         io.resp.bits.data, io.resp.valid)
     }
   }
-
-  /* LazyRoCC class contains two TLOutputNode instances, atlNode and tlNode.
-   * atlNode connects into a tile-local arbiter along with the backside of the
-   * L1 instruction cache.
-   * tlNode connects directly to the L1-L2 crossbar. The corresponding Tilelink
-   * ports in the module implementation’s IO bundle are atl and tl, respectively. */
 }
@@ -22,16 +22,27 @@ trait ALUBehavior {
   def testAddition(a: BigInt, b: BigInt, s: Int): Unit = {
     val result = (a + b) & mask(s)
     it should s"$a + $b == $result" in {
-      test(new ALU(s)) { c =>
-        c.io.fn.poke(ALU.FN_ADD.value)
-        c.io.in1.poke(a.U(s.W))
-        c.io.in2.poke(b.U(s.W))
+      // Every lane of the batch adds the same pair.
+      val batchSize = 2
+      test(new ALU(s)(batchSize)) { c =>
+        c.io.fn.poke(ALU.FN_ADD.value.U)
+        c.io.in1.foreach(_.poke(a.U(s.W)))
+        c.io.in2.foreach(_.poke(b.U(s.W)))
+        c.io.in3.poke(0.U)
+        c.io.mask.poke(mask(batchSize).U)
+        c.io.rs1.poke(0.U)
+        c.io.rs2.poke(0.U)
+        c.io.identityVal.poke(0.U)
+        c.io.elementWidth.poke(constants.MT64.value.U)
+        c.io.packResult.poke(false.B)
+        c.io.accumulator.poke(0.U)
+        c.io.clearAccumulator.poke(false.B)
+        c.io.accelIdle.poke(false.B)
         c.io.execute.poke(true.B)
         c.clock.step()
 
-        c.io.out.bits.expect(result.U(s.W))
+        c.io.out.bits.foreach(_.expect(result.U(s.W)))
         c.io.out.valid.expect(true.B)
-        c.io.cout.expect(0.U)
       }
     }
   }
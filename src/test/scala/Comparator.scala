@@ -0,0 +1,60 @@
+package vcoderocc
+
+import chisel3._
+import chiseltest._
+import org.scalatest.flatspec.AnyFlatSpec
+
+import scala.util.Random
+
+class ComparatorTest extends AnyFlatSpec with ChiselScalatestTester {
+  val xLen = 64
+
+  def signed(v: BigInt): BigInt = if (v.testBit(xLen - 1)) v - (BigInt(1) << xLen) else v
+
+  def flag(c: Boolean): BigInt = if (c) BigInt(1) else BigInt(0)
+  /** Every op, with what it should produce from the values compared (a & b)
+    * and the words they came from (x & y). */
+  val ops: Seq[(ComparatorOp.Type, (BigInt, BigInt, BigInt, BigInt) => BigInt)] = Seq(
+    ComparatorOp.min -> ((a, b, x, y) => if (a < b) x else y),
+    ComparatorOp.max -> ((a, b, x, y) => if (a > b) x else y),
+    ComparatorOp.lt -> ((a, b, _, _) => flag(a < b)),
+    ComparatorOp.le -> ((a, b, _, _) => flag(a <= b)),
+    ComparatorOp.gt -> ((a, b, _, _) => flag(a > b)),
+    ComparatorOp.ge -> ((a, b, _, _) => flag(a >= b)),
+    ComparatorOp.eq -> ((a, b, _, _) => flag(a == b)),
+    ComparatorOp.ne -> ((a, b, _, _) => flag(a != b)))
+
+  behavior of "Comparator"
+  for (stages <- Seq(1, 2, 4)) {
+    it should s"compare signed & unsigned values with $stages stages" in {
+      test(new Comparator(xLen, stages)) { dut =>
+        val rand = new Random(stages)
+        // Values that differ only in one chunk, or only in the sign bit.
+        val edges = Seq(BigInt(0), BigInt(1), BigInt(1) << 31, BigInt(1) << 32,
+          BigInt(1) << (xLen - 1), (BigInt(1) << xLen) - 1)
+        val values = edges ++ Seq.fill(20)(BigInt(xLen, rand))
+        for {
+          x <- values
+          y <- values.take(8) :+ x
+          (fn, model) <- ops
+          unsigned <- Seq(false, true)
+        } {
+          dut.io.req.valid.poke(true.B)
+          dut.io.req.bits.fn.poke(fn)
+          dut.io.req.bits.unsigned.poke(unsigned.B)
+          dut.io.req.bits.in1.poke(signed(x).S)
+          dut.io.req.bits.in2.poke(signed(y).S)
+          dut.clock.step()
+          dut.io.req.valid.poke(false.B)
+          if (stages > 1) dut.clock.step(stages - 1)
+          dut.io.resp.valid.expect(true.B)
+          assert((dut.io.resp.bits.data.peek().litValue & ((BigInt(1) << xLen) - 1)) ==
+            (if (unsigned) model(x, y, x, y) else model(signed(x), signed(y), x, y)),
+            s"$fn of $x & $y, unsigned $unsigned")
+          dut.clock.step()
+          dut.io.resp.valid.expect(false.B)
+        }
+      }
+    }
+  }
+}
@@ -9,48 +9,84 @@ import org.scalatest.matchers.should.Matchers
 
 import vcoderocc.Instructions._
 
-import freechips.rocketchip.config.Parameters
+import org.chipsalliance.cde.config.Parameters
 
 class ControlUnitTest extends AnyFlatSpec with ChiselScalatestTester {
   implicit val p: Parameters = new vcoderocc.VCodeTestConfig
+  val batchSize = 8
 
   behavior of "Control Unit"
   it should s"Control signals for ${PLUS_INT}" in {
-    test(new ControlUnit) { dut =>
+    test(new ControlUnit(batchSize)) { dut =>
       val ctrlSigs = (new DecodeTable).findCtrlSigs(PLUS_INT)
 
+      // A whole batch of operands, too many to fetch both vectors in one pass.
+      dut.io.configCmd.valid.poke(false.B)
+      dut.io.loadConfig.valid.poke(true.B)
+      dut.io.loadConfig.bits.numOperands.poke(batchSize.U)
+      dut.io.loadConfig.bits.destAddr.poke(0x3000.U)
+      dut.io.loadConfig.bits.rs3.poke(0.U)
+      dut.io.loadConfig.bits.elementWidth.poke(constants.MT64.value.U)
+      dut.io.loadConfig.bits.headerMode.poke(false.B)
+      dut.clock.step()
+      dut.io.loadConfig.valid.poke(false.B)
+
       dut.io.accelReady.expect(true.B)
       dut.io.busy.expect(false.B)
+      dut.io.roccCmd.inst.funct.poke(PLUS_INT.value.U)
+      dut.io.roccCmd.inst.xd.poke(true.B)
+      dut.io.roccCmd.inst.xs1.poke(true.B)
+      dut.io.roccCmd.inst.xs2.poke(true.B)
+      dut.io.roccCmd.rs1.poke(0x1000.U)
+      dut.io.roccCmd.rs2.poke(0x2000.U)
       dut.io.ctrlSigs.poke(ctrlSigs)
       dut.io.cmdValid.poke(true.B)
+      // Not ready for another instruction while leaving idle for this one.
+      dut.io.accelReady.expect(false.B)
       dut.clock.step()
 
-      // Should be in fetchingData state now
+      // Should be fetching the first operand now
       dut.io.accelReady.expect(false.B)
       dut.io.busy.expect(true.B)
       dut.io.shouldFetch.expect(true.B)
-      dut.io.numToFetch.expect(2.U)
-      dut.io.fetchingCompleted.poke(true.B)
+      dut.io.rs1Fetch.expect(true.B)
+      dut.io.baseAddress.expect(0x1000.U)
+      dut.io.numToFetch.expect(batchSize.U)
+      dut.io.memOpCompleted.poke(true.B)
       dut.clock.step()
 
-      // Should be in execute state now
+      // Then the second
+      dut.io.shouldFetch.expect(true.B)
+      dut.io.rs2Fetch.expect(true.B)
+      dut.io.baseAddress.expect(0x2000.U)
+      dut.io.numToFetch.expect(batchSize.U)
       dut.clock.step()
-      dut.io.accelReady.expect(false.B)
+      dut.io.memOpCompleted.poke(false.B)
+
+      // Should be in execute state now
       dut.io.busy.expect(true.B)
       dut.io.shouldFetch.expect(false.B)
       dut.io.shouldExecute.expect(true.B)
-      dut.io.executionCompleted.poke(true.B)
+      dut.io.executeCompleted.poke(true.B)
+      dut.clock.step()
+      dut.io.executeCompleted.poke(false.B)
 
       // Should be in write-back state now
-      dut.clock.step()
-      dut.io.accelReady.expect(false.B)
-      dut.io.busy.expect(true.B)
       dut.io.shouldExecute.expect(false.B)
+      dut.io.writebackReady.expect(true.B)
+      dut.io.baseAddress.expect(0x3000.U)
+      dut.io.memOpCompleted.poke(true.B)
+      dut.clock.step()
+      dut.io.memOpCompleted.poke(false.B)
+
+      // The whole vector was written, so respond
+      dut.io.writebackReady.expect(false.B)
       dut.io.responseReady.expect(true.B)
       dut.io.responseCompleted.poke(true.B)
+      dut.io.cmdValid.poke(false.B)
+      dut.clock.step()
 
       // Return to idle
-      dut.clock.step()
       dut.io.accelReady.expect(true.B)
       dut.io.busy.expect(false.B)
       dut.io.responseReady.expect(false.B)
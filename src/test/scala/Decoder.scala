@@ -10,19 +10,29 @@ import org.scalatest.matchers.should.Matchers
 
 import vcoderocc.Instructions._
 
-import freechips.rocketchip.config.Parameters
+import org.chipsalliance.cde.config.Parameters
 import freechips.rocketchip.tile.RoCCInstruction
 
 class DecoderTest extends AnyFlatSpec with ChiselScalatestTester {
   implicit val p: Parameters = new vcoderocc.VCodeTestConfig
 
-  def testDecode(inst: BitPat, rocc_inst: RoCCInstruction): Unit = {
+  /** Check the bits of sig that pat cares about. */
+  def expectPat(sig: UInt, pat: BitPat): Unit =
+    assert((sig.peek().litValue & pat.mask) == pat.value, s"$sig should match $pat")
+
+  def testDecode(inst: BitPat, roccInst: RoCCInstruction): Unit = {
     it should s"Decode ${inst}" in {
       test(new Decoder) { dut =>
-        val expectedSigs = (new DecodeTable).findCtrlSigs(inst)
+        val Seq(legal, numMemFetches, aluFn, _, isMemOp, boolPacking) =
+          (new DecodeTable).table.find(_._1 == inst).get._2
         dut.io.roccInst.poke(roccInst)
+        dut.io.elementWidth.poke(constants.MT64.value.U)
 
-        dut.io.ctrlSigs.expect(expectedSigs)
+        expectPat(dut.io.ctrlSigs.legal, legal)
+        expectPat(dut.io.ctrlSigs.numMemFetches, numMemFetches)
+        expectPat(dut.io.ctrlSigs.aluFn, aluFn)
+        expectPat(dut.io.ctrlSigs.isMemOp, isMemOp)
+        expectPat(dut.io.ctrlSigs.boolPacking, boolPacking)
       }
     }
   }
@@ -41,4 +51,30 @@ class DecoderTest extends AnyFlatSpec with ChiselScalatestTester {
   testData.foreach { datum =>
     it should behave like testDecode(datum._1, datum._2)
   }
+
+  it should "Decode an unused funct7 as illegal" in {
+    test(new Decoder) { dut =>
+      dut.io.elementWidth.poke(constants.MT64.value.U)
+      dut.io.roccInst.poke(vcoderocc.RoCCInstructionFactory.buildRoCCInstruction(BitPat("b1111111"),
+        0, 0, 0, true, true, true, RoCCInstructionFactory.ROCC_CUSTOM_OPCODE_0))
+      dut.io.ctrlSigs.legal.expect(false.B)
+    }
+  }
+
+  it should "Decode only sub-word operations as legal at a narrow element width" in {
+    test(new Decoder) { dut =>
+      def inst(op: BitPat) = vcoderocc.RoCCInstructionFactory.buildRoCCInstruction(op,
+        0, 0, 0, true, true, true, RoCCInstructionFactory.ROCC_CUSTOM_OPCODE_0)
+      dut.io.elementWidth.poke(constants.MT8.value.U)
+      dut.io.roccInst.poke(inst(PLUS_INT))
+      dut.io.ctrlSigs.legal.expect(true.B)
+      dut.io.roccInst.poke(inst(PLUS_RED_INT))
+      dut.io.ctrlSigs.legal.expect(false.B)
+      dut.io.roccInst.poke(inst(SET_ELEMENT_WIDTH))
+      dut.io.ctrlSigs.legal.expect(true.B)
+      dut.io.elementWidth.poke(constants.MT64.value.U)
+      dut.io.roccInst.poke(inst(PLUS_RED_INT))
+      dut.io.ctrlSigs.legal.expect(true.B)
+    }
+  }
 }
@@ -0,0 +1,465 @@
+package vcoderocc
+
+import chisel3._
+import chisel3.util.BitPat
+import chiseltest._
+
+import scala.collection.mutable
+import scala.util.Random
+
+import org.chipsalliance.cde.config.Parameters
+
+/** How the simulated L1 data cache behaves.
+  *
+  * @param minLatency Fewest cycles from a request being accepted to its
+  * response.
+  * @param maxLatency Most cycles from a request being accepted to its
+  * response. Each request takes a random latency in between.
+  * @param outOfOrder Responses that are due may come back in any order,
+  * rather than in the order their requests were sent.
+  * @param readyProbability Chance the cache accepts a request in any given
+  * cycle. Below 1 applies backpressure.
+  * @param seed Seed for every random choice, so runs can be repeated.
+  */
+case class MemoryConfig(minLatency: Int = 2, maxLatency: Int = 2,
+  outOfOrder: Boolean = false, readyProbability: Double = 1.0, seed: Long = 0) {
+  require(minLatency >= 1 && maxLatency >= minLatency)
+  require(readyProbability > 0.0 && readyProbability <= 1.0)
+}
+
+/** A behavioral model of the L1 data cache, sitting on the accelerator's
+  * memory port. Memory is sparse, 64-bit words that have never been written
+  * read as 0. At most one response comes back each cycle.
+  */
+class HellaCacheModel(config: MemoryConfig) {
+  private val rand = new Random(config.seed)
+  private val words = mutable.Map[BigInt, BigInt]()
+  private case class Pending(tag: BigInt, data: BigInt, hasData: Boolean, dueAt: Long)
+  private val pending = mutable.ArrayBuffer[Pending]()
+  private var cycle = 0L
+  /** Requests accepted so far. */
+  var requests = 0L
+
+  private val wordMask = (BigInt(1) << 64) - 1
+  private def word(addr: BigInt): BigInt = addr & ~BigInt(7)
+
+  def read(addr: BigInt): BigInt = words.getOrElse(word(addr), BigInt(0))
+  def write(addr: BigInt, value: BigInt): Unit = words(word(addr)) = value & wordMask
+  def readVector(addr: BigInt, n: Int): Seq[BigInt] = (0 until n).map(i => read(addr + 8 * i))
+  def writeVector(addr: BigInt, values: Seq[BigInt]): Unit =
+    values.zipWithIndex.foreach { case (v, i) => write(addr + 8 * i, v) }
+
+  /** Drive the cache's side of port for the current cycle. Call once per
+    * cycle, before the clock steps. */
+  def tick(port: VCodeMemIO): Unit = {
+    val ready = config.readyProbability >= 1.0 || rand.nextDouble() < config.readyProbability
+    port.req.ready.poke(ready.B)
+
+    val due = pending.indices.filter(pending(_).dueAt <= cycle)
+    if (due.nonEmpty) {
+      val i = if (config.outOfOrder) due(rand.nextInt(due.length)) else due.head
+      val resp = pending.remove(i)
+      port.resp.valid.poke(true.B)
+      port.resp.bits.tag.poke(resp.tag.U)
+      port.resp.bits.data.poke(resp.data.U)
+      port.resp.bits.has_data.poke(resp.hasData.B)
+    } else {
+      port.resp.valid.poke(false.B)
+    }
+
+    if (ready && port.req.valid.peekBoolean()) {
+      val addr = port.req.bits.addr.peek().litValue
+      val tag = port.req.bits.tag.peek().litValue
+      val isWrite = port.req.bits.cmd.peek().litValue == 1 // M_XWR
+      if (isWrite) {
+        write(addr, port.req.bits.data.peek().litValue)
+      }
+      val latency = config.minLatency + rand.nextInt(config.maxLatency - config.minLatency + 1)
+      // Without reordering, a response can never overtake an earlier one.
+      val dueAt = if (config.outOfOrder || pending.isEmpty) cycle + latency
+        else math.max(cycle + latency, pending.last.dueAt)
+      pending += Pending(tag, if (isWrite) 0 else read(addr), !isWrite, dueAt)
+      requests += 1
+    }
+    cycle += 1
+  }
+}
+
+/** Plays the core's side of the RoCC interface, running instructions on an
+  * accelerator whose memory port is served by mem.
+  */
+class RoCCDriver(dut: VCodeCore, mem: HellaCacheModel, maxCycles: Int = 200000) {
+  /** Cycles since the driver started. */
+  var cycle = 0L
+  /** Responses that came back and were not collected yet, by rd. */
+  private val responses = mutable.Map[Int, BigInt]()
+
+  def step(): Unit = {
+    mem.tick(dut.io.mem)
+    dut.io.resp.ready.poke(true.B)
+    if (dut.io.resp.valid.peekBoolean()) {
+      responses(dut.io.resp.bits.rd.peek().litValue.toInt) = dut.io.resp.bits.data.peek().litValue
+    }
+    dut.clock.step()
+    cycle += 1
+  }
+
+  /** Hand an instruction to the accelerator, without waiting for its
+    * response. Like a custom instruction whose rd is not read yet. */
+  def send(funct: BitPat, rs1: BigInt = 0, rs2: BigInt = 0, rd: Int = 1,
+    xs1: Boolean = true, xs2: Boolean = true, xd: Boolean = true): Unit = {
+    val cmd = dut.io.cmd
+    cmd.valid.poke(true.B)
+    cmd.bits.inst.funct.poke(funct.value.U)
+    cmd.bits.inst.opcode.poke(RoCCInstructionFactory.ROCC_CUSTOM_OPCODE_0)
+    cmd.bits.inst.rd.poke(rd.U)
+    cmd.bits.inst.xs1.poke(xs1.B)
+    cmd.bits.inst.xs2.poke(xs2.B)
+    cmd.bits.inst.xd.poke(xd.B)
+    cmd.bits.rs1.poke(rs1.U)
+    cmd.bits.rs2.poke(rs2.U)
+    val start = cycle
+    while (!cmd.ready.peekBoolean()) {
+      require(cycle - start < maxCycles, s"Instruction $funct never issued")
+      step()
+    }
+    step()
+    cmd.valid.poke(false.B)
+  }
+
+  /** Wait for the response to an instruction sent with rd, and return it. */
+  def await(rd: Int = 1): BigInt = {
+    val start = cycle
+    while (!responses.contains(rd)) {
+      require(cycle - start < maxCycles, s"No response for rd $rd")
+      step()
+    }
+    responses.remove(rd).get
+  }
+
+  /** Has the response to an instruction sent with rd come back yet? */
+  def responded(rd: Int): Boolean = responses.contains(rd)
+
+  /** Issue an instruction. Waits for its response when xd is set, like a
+    * blocking custom instruction, and returns it. */
+  def issue(funct: BitPat, rs1: BigInt = 0, rs2: BigInt = 0,
+    xs1: Boolean = true, xs2: Boolean = true, xd: Boolean = true): Option[BigInt] = {
+    send(funct, rs1, rs2, 1, xs1, xs2, xd)
+    if (xd) Some(await(1)) else None
+  }
+
+  /** Run an instruction and count the cycles from it being issued to the
+    * accelerator responding. */
+  def time(funct: BitPat, rs1: BigInt = 0, rs2: BigInt = 0): (BigInt, Long) = {
+    val start = cycle
+    val data = issue(funct, rs1, rs2).get
+    (data, cycle - start)
+  }
+}
+
+/** Cycles one instruction took on a vector of length elements. */
+case class OpTiming(op: String, length: Int, cycles: Long)
+
+/** Times every vector instruction the accelerator decodes. */
+object OpBench {
+  // Where each operand lives. Far enough apart for the longest vectors.
+  val rs1Addr = BigInt(0x100000)
+  val rs2Addr = BigInt(0x200000)
+  val flagsAddr = BigInt(0x300000)
+  val destAddr = BigInt(0x400000)
+
+  /** Every instruction, by name, found in the Instructions object. */
+  def instructions: Seq[(String, BitPat)] =
+    Instructions.getClass.getDeclaredMethods.toSeq
+      .filter(m => m.getParameterCount == 0 && m.getReturnType == classOf[BitPat])
+      .map(m => m.getName -> m.invoke(Instructions).asInstanceOf[BitPat])
+      .sortBy(_._2.value)
+
+  /** The instructions that run on vectors. */
+  def vectorOps(implicit p: Parameters): Seq[(String, BitPat)] = {
+    val table = (new DecodeTable).table
+    for {
+      (name, op) <- instructions
+      (_, sigs) <- table.find(_._1 == op).toSeq
+      if sigs(4) == constants.Y // isMemOp
+    } yield (name, op)
+  }
+
+  /** An instruction ready to run: its operands, and a check of its response
+    * & what it wrote against OpModel. */
+  case class OpCase(rs1: BigInt, rs2: BigInt, check: BigInt => Unit)
+
+  /* chisel3._ has an assert of its own, for hardware. */
+  def verify(cond: Boolean, message: => String): Unit =
+    if (!cond) throw new AssertionError(message)
+
+  /** Fail on the first element of actual that differs from expected. */
+  def expect(what: String, actual: Seq[BigInt], expected: Seq[BigInt]): Unit = {
+    val wrong = actual.zip(expected).indexWhere { case (a, e) => a != e }
+    verify(wrong < 0, s"$what: element $wrong is 0x${actual(wrong).toString(16)}, " +
+      s"expected 0x${expected(wrong).toString(16)}")
+  }
+
+  def expectResponse(what: String, actual: BigInt, expected: BigInt): Unit =
+    verify(actual == expected, s"$what: responded $actual, expected $expected")
+
+  /** Write operands for the instruction name that it can run on, and run
+    * any instruction it depends on: a HISTOGRAM before a RANK, a reduction
+    * into the accumulator READ_ACCUMULATOR reads, and so on.
+    *
+    * Integers are small & signed. Floats are powers of 2, which every
+    * floating-point instruction adds & multiplies exactly, so the order the
+    * FloatUnit's trees combine them in does not change the result.
+    */
+  def prepare(driver: RoCCDriver, mem: HellaCacheModel, name: String, length: Int,
+    batchSize: Int, rand: Random)(implicit p: Parameters): OpCase = {
+    import OpModel._
+    val words = (length + 63) / 64
+    def ints(n: Int = length): Seq[BigInt] =
+      Seq.fill(n)(BigInt(rand.nextInt(2 * length + 1) - length) & mask64)
+    // Never 0, so they can be divisors.
+    def positives(): Seq[BigInt] = Seq.fill(length)(BigInt(1 + rand.nextInt(length)))
+    def floats(): Seq[BigInt] = Seq.fill(length)(bits(
+      (if (rand.nextBoolean()) 1.0 else -1.0) * math.pow(2, rand.nextInt(5) - 2)))
+    def randomWords(n: Int): Seq[BigInt] = Seq.fill(n)(BigInt(64, rand))
+    def dest(n: Int): Seq[BigInt] = mem.readVector(destAddr, n)
+    def setup(op: BitPat, rs1: BigInt = 0, rs2: BigInt = 0): Unit =
+      expectResponse(s"$name setup", driver.issue(op, rs1, rs2).get, 0)
+    def config(op: BitPat, rs1: BigInt = 0, rs2: BigInt = 0): Unit =
+      driver.issue(op, rs1, rs2, xd = false)
+    /** The instruction responds with 0 and writes expected to the destination. */
+    def writes(expected: Seq[BigInt]): BigInt => Unit = { response =>
+      expectResponse(name, response, 0)
+      expect(name, dest(expected.length), expected)
+    }
+    /** The same, for packed flags, ignoring the flags past the end of the
+      * vector in the last word. */
+    def writesFlags(expected: Seq[BigInt]): BigInt => Unit = { response =>
+      expectResponse(name, response, 0)
+      val defined = (0 until words).map(w => (BigInt(1) << math.min(64, length - 64 * w)) - 1)
+      expect(name, dest(words).zip(defined).map { case (x, d) => x & d },
+        expected.zip(defined).map { case (x, d) => x & d })
+    }
+    def operands(a: Seq[BigInt], b: Seq[BigInt]): Unit = {
+      mem.writeVector(rs1Addr, a)
+      mem.writeVector(rs2Addr, b)
+    }
+    val radixBits = p(VCodeRadixBits)
+
+    name match {
+      case "SELECT_INT" =>
+        val (a, b, flags) = (ints(), ints(), randomWords(words))
+        operands(a, b)
+        mem.writeVector(flagsAddr, flags)
+        val selected = unpack(flags, length)
+        OpCase(rs1Addr, rs2Addr, writes((0 until length).map(i => if (selected(i)) a(i) else b(i))))
+      case _ if name.endsWith("_PACKED_INT") =>
+        val (a, b) = (ints(), ints())
+        operands(a, b)
+        val compare = elementWise(name.replace("_PACKED", ""))
+        OpCase(rs1Addr, rs2Addr, writesFlags(pack(a.zip(b).map { case (x, y) => compare(x, y) == 1 })))
+      case _ if name.endsWith("_BOOL") =>
+        val (a, b) = (randomWords(words), randomWords(words))
+        operands(a, b)
+        val logic = elementWise(name.replace("_BOOL", "_INT"))
+        OpCase(rs1Addr, rs2Addr, writesFlags(a.zip(b).map { case (x, y) => logic(x, y) & mask64 }))
+      case "POPCOUNT_RED_INT" =>
+        val a = randomWords(words)
+        operands(a, Seq.empty)
+        OpCase(rs1Addr, 0, writes(Seq(BigInt(unpack(a, length).count(identity)))))
+      case _ if name.endsWith("_SCAN_INT") || name.endsWith("_RED_INT") =>
+        val f = folds(name.takeWhile(_ != '_'))
+        // Odd factors, so products never become 0 mod 2^64.
+        val a = if (name.startsWith("MUL")) ints().map(_ | 1) else ints()
+        operands(a, Seq.empty)
+        OpCase(rs1Addr, 0, writes(if (name.contains("SCAN")) scan(f, a) else Seq(reduce(f, a))))
+      case "DOT_INT" =>
+        val (a, b) = (ints(), ints())
+        operands(a, b)
+        OpCase(rs1Addr, rs2Addr, writes(Seq(a.zip(b).map { case (x, y) => x * y }.sum & mask64)))
+      case "PLUS_SCAN_FLOAT" =>
+        val a = floats()
+        operands(a, Seq.empty)
+        OpCase(rs1Addr, 0, writes(a.map(float).scanLeft(-0.0)(_ + _).init.map(bits)))
+      case "PLUS_RED_FLOAT" | "MUL_RED_FLOAT" =>
+        val a = floats()
+        operands(a, Seq.empty)
+        val total = if (name == "PLUS_RED_FLOAT") a.map(float).foldLeft(-0.0)(_ + _)
+          else a.map(float).foldLeft(1.0)(_ * _)
+        OpCase(rs1Addr, 0, writes(Seq(bits(total))))
+      case "DOT_FLOAT" =>
+        val (a, b) = (floats(), floats())
+        operands(a, b)
+        OpCase(rs1Addr, rs2Addr, writes(Seq(bits(a.zip(b).map { case (x, y) => float(x) * float(y) }
+          .foldLeft(-0.0)(_ + _)))))
+      case "INDEX_INT" =>
+        val (start, stride) = (ints(1).head, ints(1).head)
+        OpCase(start, stride, writes((0 until length).map(i => (start + stride * i) & mask64)))
+      case "DIST_INT" =>
+        val value = randomWords(1).head
+        OpCase(value, 0, writes(Seq.fill(length)(value)))
+      case "RAND_INT" =>
+        val seed = randomWords(1).head | 1
+        val bound = if (rand.nextBoolean()) BigInt(length) else BigInt(0)
+        OpCase(seed, bound, writes(randomNumbers(seed, bound, length, batchSize)))
+      case "COPY_STRIDED_INT" =>
+        val a = ints(2 * length)
+        operands(a, Seq.empty)
+        OpCase(rs1Addr, 2, writes((0 until length).map(i => a(2 * i))))
+      case "PERMUTE_INT" =>
+        val a = ints()
+        val index = rand.shuffle((0 until length).toSeq)
+        operands(a, index.map(BigInt(_)))
+        OpCase(rs1Addr, rs2Addr, writes(permute(a, index)))
+      case "HISTOGRAM_INT" | "RANK_INT" =>
+        val keys = randomWords(length)
+        val shift = radixBits * rand.nextInt(64 / radixBits)
+        operands(keys, Seq.empty)
+        if (name == "RANK_INT") {
+          config(Instructions.SET_NUM_OPERANDS, length)
+          setup(Instructions.HISTOGRAM_INT, rs1Addr, shift)
+          OpCase(rs1Addr, shift, writes(rank(keys, shift, radixBits)))
+        } else {
+          // HISTOGRAM writes nothing, so check the RANK that follows it.
+          OpCase(rs1Addr, shift, { response =>
+            expectResponse(name, response, 0)
+            config(Instructions.SET_DEST_ADDR, destAddr)
+            setup(Instructions.RANK_INT, rs1Addr, shift)
+            expect(s"RANK_INT after $name", dest(length), rank(keys, shift, radixBits))
+          })
+        }
+      case "SORT_BATCH_INT" =>
+        val a = ints()
+        operands(a, Seq.empty)
+        OpCase(rs1Addr, 0, writes(sortBatch(a, batchSize)))
+      case "MERGE_INT" =>
+        val (a, b) = (ints().sortBy(signed), ints().sortBy(signed))
+        operands(a, b)
+        OpCase(rs1Addr, rs2Addr, writes(merge(a, b)))
+      case "EXTRACT_INT" =>
+        val a = ints()
+        val i = rand.nextInt(length)
+        operands(a, Seq.empty)
+        OpCase(rs1Addr, i, expectResponse(name, _, a(i)))
+      case "REPLACE_INT" =>
+        val (value, i) = (randomWords(1).head, rand.nextInt(length))
+        val before = dest(length)
+        OpCase(value, i, writes(before.updated(i, value)))
+      case "READ_ACCUMULATOR" =>
+        // Sum the vector into accumulator 0.
+        val a = ints()
+        operands(a, Seq.empty)
+        config(Instructions.SET_NUM_OPERANDS, length)
+        config(Instructions.SET_ACCUMULATOR, 1)
+        config(Instructions.CLEAR_ACCUMULATOR, 0, 0)
+        setup(Instructions.PLUS_RED_INT, rs1Addr)
+        config(Instructions.SET_ACCUMULATOR, 0)
+        OpCase(0, 0, expectResponse(name, _, a.sum & mask64))
+      case "READ_COUNTER" =>
+        // Count the batches of an ADD.
+        operands(ints(), ints())
+        config(Instructions.SET_NUM_OPERANDS, length)
+        config(Instructions.SET_DEST_ADDR, destAddr)
+        config(Instructions.RESET_COUNTERS)
+        setup(Instructions.PLUS_INT, rs1Addr, rs2Addr)
+        OpCase(PerfCounters.ALU_BATCHES, 0,
+          expectResponse(name, _, (length + batchSize - 1) / batchSize))
+      case "DRAIN_TRACE" =>
+        /* The records themselves depend on every cycle run so far, so check
+         * their shape. A DIST first leaves records to drain, and fills the
+         * destination with words that are never 0. */
+        config(Instructions.SET_NUM_OPERANDS, length)
+        config(Instructions.SET_DEST_ADDR, destAddr)
+        setup(Instructions.DIST_INT, mask64)
+        OpCase(0, 0, { drained =>
+          val records = dest(length)
+          verify(drained >= 1 && drained <= length.min(p(VCodeTraceEntries)),
+            s"$name: drained $drained records into $length elements")
+          // Oldest first.
+          val cycles = records.take(drained.toInt).map(_ >> 32)
+          verify(cycles == cycles.sorted, s"$name: records out of order, at cycles $cycles")
+          expect(s"$name padding", records.drop(drained.toInt), Seq.fill(length - drained.toInt)(BigInt(0)))
+        })
+      case _ if elementWise.isDefinedAt(name) =>
+        val isFloat = name.endsWith("_FLOAT") && name != "INT_TO_FLOAT" || name == "FLOAT_TO_INT"
+        val (values, b) = if (isFloat) (floats(), floats()) else (ints(), positives())
+        // No square roots of negative numbers.
+        val a = if (name == "SQRT_FLOAT") values.map(_.clearBit(63)) else values
+        operands(a, b)
+        val f = elementWise(name)
+        OpCase(rs1Addr, rs2Addr, writes(a.zip(b).map { case (x, y) => f(x, y) & mask64 }))
+      case _ =>
+        throw new IllegalArgumentException(s"OpModel has no model of $name")
+    }
+  }
+
+  /** Run op on vectors of length elements, check its result against
+    * OpModel, and count its cycles. */
+  def time(driver: RoCCDriver, mem: HellaCacheModel, name: String, op: BitPat, length: Int,
+    batchSize: Int, rand: Random)(implicit p: Parameters): OpTiming = {
+    val c = prepare(driver, mem, name, length, batchSize, rand)
+    driver.issue(Instructions.SET_NUM_OPERANDS, length, xs2 = false, xd = false)
+    driver.issue(Instructions.SET_DEST_ADDR, destAddr, xs2 = false, xd = false)
+    driver.issue(Instructions.SET_THIRD_OPERAND, flagsAddr, xs2 = false, xd = false)
+    val (response, cycles) = driver.time(op, c.rs1, c.rs2)
+    c.check(response)
+    OpTiming(name, length, cycles)
+  }
+
+  /** Sort the n signed keys at keysAddr the way rocc_merge_sort.c does: a
+    * SORT_BATCH_INT into runs of batchSize, then passes of MERGE_INT doubling
+    * the run length, between keysAddr & tmpAddr. n must be a power of 2 and
+    * at least batchSize.
+    *
+    * @return Where the sorted keys ended up, and the cycles the whole sort took.
+    */
+  def mergeSort(driver: RoCCDriver, n: Int, batchSize: Int, keysAddr: BigInt,
+    tmpAddr: BigInt): (BigInt, Long) = {
+    require(Integer.bitCount(n) == 1 && n >= batchSize, "mergeSort needs a power of 2 keys")
+    val start = driver.cycle
+    var (src, dst) = (keysAddr, tmpAddr)
+    driver.issue(Instructions.SET_NUM_OPERANDS, n, xs2 = false, xd = false)
+    driver.issue(Instructions.SET_DEST_ADDR, src, xs2 = false, xd = false)
+    require(driver.issue(Instructions.SORT_BATCH_INT, src, xs2 = false) == Some(0))
+    var run = batchSize
+    while (run < n) {
+      driver.issue(Instructions.SET_NUM_OPERANDS, run, xs2 = false, xd = false)
+      for (i <- 0 until n by 2 * run) {
+        driver.issue(Instructions.SET_DEST_ADDR, dst + 8 * i, xs2 = false, xd = false)
+        require(driver.issue(Instructions.MERGE_INT, src + 8 * i, src + 8 * (i + run)) == Some(0))
+      }
+      val swap = src; src = dst; dst = swap
+      run *= 2
+    }
+    (src, driver.cycle - start)
+  }
+
+  /** Time every vector instruction, or only the ones named in ops, on every
+    * length. */
+  def run(dut: VCodeCore, batchSize: Int, config: MemoryConfig, lengths: Seq[Int],
+    ops: Seq[String] = Seq.empty)(implicit p: Parameters): Seq[OpTiming] = {
+    dut.clock.setTimeout(0)
+    val mem = new HellaCacheModel(config)
+    val driver = new RoCCDriver(dut, mem)
+    val rand = new Random(config.seed)
+    for {
+      (name, op) <- vectorOps
+      if ops.isEmpty || ops.contains(name)
+      length <- lengths
+    } yield time(driver, mem, name, op, length, batchSize, rand)
+  }
+
+  /** Lay timings out as a table, one row per instruction. */
+  def report(timings: Seq[OpTiming]): String = {
+    val lengths = timings.map(_.length).distinct.sorted
+    val ops = timings.map(_.op).distinct
+    val width = (ops.map(_.length) :+ 11).max
+    val header = "Instruction".padTo(width, ' ') + lengths.map(n => f"$n%10d").mkString
+    val rows = ops.map { op =>
+      op.padTo(width, ' ') + lengths.map { n =>
+        timings.find(t => t.op == op && t.length == n).map(t => f"${t.cycles}%10d").getOrElse(" " * 10)
+      }.mkString
+    }
+    (s"Cycles per instruction, by vector length" +: header +: rows).mkString("\n")
+  }
+}
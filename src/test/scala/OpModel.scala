@@ -0,0 +1,142 @@
+package vcoderocc
+
+/** A software model of what the vector instructions compute, to check the
+  * accelerator's results against. Values are 64-bit words held as
+  * non-negative BigInts, the way HellaCacheModel holds them, so every result
+  * is truncated to 64 bits with mask64.
+  */
+object OpModel {
+  val mask64 = (BigInt(1) << 64) - 1
+  val signBit = BigInt(1) << 63
+
+  def signed(v: BigInt): BigInt = if (v.testBit(63)) v - (BigInt(1) << 64) else v
+  def flag(b: Boolean): BigInt = if (b) 1 else 0
+  def float(v: BigInt): Double = java.lang.Double.longBitsToDouble(v.toLong)
+  def bits(d: Double): BigInt = BigInt(java.lang.Double.doubleToRawLongBits(d)) & mask64
+
+  /** Instructions that compute each element of the destination from the
+    * elements of rs1 & rs2 at the same index. */
+  val elementWise: PartialFunction[String, (BigInt, BigInt) => BigInt] = {
+    case "PLUS_INT" => _ + _
+    case "SUB_INT" => _ - _
+    case "MUL_INT" => _ * _
+    // Signed, rounding towards 0, like RISC-V's DIV & REM.
+    case "DIV_INT" => (x, y) => signed(x) / signed(y)
+    case "MOD_INT" => (x, y) => signed(x) % signed(y)
+    case "LESS_INT" => (x, y) => flag(x < y)
+    case "LESS_EQUAL_INT" => (x, y) => flag(x <= y)
+    case "GREATER_INT" => (x, y) => flag(x > y)
+    case "GREATER_EQUAL_INT" => (x, y) => flag(x >= y)
+    case "EQUAL_INT" => (x, y) => flag(x == y)
+    case "UNEQUAL_INT" => (x, y) => flag(x != y)
+    case "LESS_SIGNED_INT" => (x, y) => flag(signed(x) < signed(y))
+    case "LESS_EQUAL_SIGNED_INT" => (x, y) => flag(signed(x) <= signed(y))
+    case "GREATER_SIGNED_INT" => (x, y) => flag(signed(x) > signed(y))
+    case "GREATER_EQUAL_SIGNED_INT" => (x, y) => flag(signed(x) >= signed(y))
+    case "MIN_INT" => (x, y) => if (signed(x) < signed(y)) x else y
+    case "MAX_INT" => (x, y) => if (signed(x) > signed(y)) x else y
+    case "MIN_UNSIGNED_INT" => _ min _
+    case "MAX_UNSIGNED_INT" => _ max _
+    // Shifts only use the low 6 bits of the amount.
+    case "LSHIFT_INT" => (x, y) => x << (y & 63).toInt
+    case "RSHIFT_INT" => (x, y) => x >> (y & 63).toInt
+    case "ARSHIFT_INT" => (x, y) => signed(x) >> (y & 63).toInt
+    case "NOT_INT" => (x, _) => ~x
+    case "AND_INT" => _ & _
+    case "OR_INT" => _ | _
+    case "XOR_INT" => _ ^ _
+    case "POPCOUNT_INT" => (x, _) => x.bitCount
+    case "CLZ_INT" => (x, _) => 64 - x.bitLength
+    case "CTZ_INT" => (x, _) => if (x == 0) 64 else x.lowestSetBit
+    case "BIT_REVERSE_INT" => (x, _) => (0 until 64).filter(x.testBit).map(i => BigInt(1) << (63 - i)).sum
+    case "COPY_INT" => (x, _) => x
+    // IEEE 754 doubles round the same way in Scala as in the FloatUnit.
+    case "PLUS_FLOAT" => (x, y) => bits(float(x) + float(y))
+    case "SUB_FLOAT" => (x, y) => bits(float(x) - float(y))
+    case "MUL_FLOAT" => (x, y) => bits(float(x) * float(y))
+    case "DIV_FLOAT" => (x, y) => bits(float(x) / float(y))
+    case "SQRT_FLOAT" => (x, _) => bits(math.sqrt(float(x)))
+    case "LESS_FLOAT" => (x, y) => flag(float(x) < float(y))
+    case "LESS_EQUAL_FLOAT" => (x, y) => flag(float(x) <= float(y))
+    case "GREATER_FLOAT" => (x, y) => flag(float(x) > float(y))
+    case "GREATER_EQUAL_FLOAT" => (x, y) => flag(float(x) >= float(y))
+    case "EQUAL_FLOAT" => (x, y) => flag(float(x) == float(y))
+    case "UNEQUAL_FLOAT" => (x, y) => flag(float(x) != float(y))
+    case "INT_TO_FLOAT" => (x, _) => bits(signed(x).toDouble)
+    // Truncates towards 0, like C's cast.
+    case "FLOAT_TO_INT" => (x, _) => BigInt(float(x).toLong)
+  }
+
+  /** The identity & combining function of an integer scan or reduction. */
+  case class Fold(identity: BigInt, combine: (BigInt, BigInt) => BigInt)
+
+  /** Integer scans & reductions, by the name their instructions start with.
+    * MAX & MIN compare signed. */
+  val folds: PartialFunction[String, Fold] = {
+    case "PLUS" => Fold(0, _ + _)
+    case "MUL" => Fold(1, _ * _)
+    case "MAX" => Fold(signBit, (x, y) => if (signed(x) > signed(y)) x else y)
+    case "MIN" => Fold(signBit - 1, (x, y) => if (signed(x) < signed(y)) x else y)
+    case "AND" => Fold(mask64, _ & _)
+    case "OR" => Fold(0, _ | _)
+    case "XOR" => Fold(0, _ ^ _)
+  }
+
+  /** Exclusive scan: element i combines every element before it. */
+  def scan(f: Fold, xs: Seq[BigInt]): Seq[BigInt] =
+    xs.scanLeft(f.identity)((acc, x) => f.combine(acc, x) & mask64).init
+
+  def reduce(f: Fold, xs: Seq[BigInt]): BigInt =
+    xs.foldLeft(f.identity)((acc, x) => f.combine(acc, x) & mask64)
+
+  /** Pack flags 64 to a word, flag i in bit i % 64 of word i / 64. */
+  def pack(flags: Seq[Boolean]): Seq[BigInt] =
+    flags.grouped(64).map(_.zipWithIndex.collect { case (true, k) => BigInt(1) << k }.sum).toSeq
+
+  def unpack(words: Seq[BigInt], n: Int): Seq[Boolean] = (0 until n).map(i => words(i / 64).testBit(i % 64))
+
+  /** The radix sort digit of a key. Its sign bit is flipped, so negative keys
+    * come first. */
+  def digit(key: BigInt, shift: Int, radixBits: Int): BigInt =
+    ((key ^ signBit) >> shift) & ((BigInt(1) << radixBits) - 1)
+
+  /** A RANK after a HISTOGRAM over the same keys: a stable sort by digit. */
+  def rank(keys: Seq[BigInt], shift: Int, radixBits: Int): Seq[BigInt] =
+    keys.sortBy(digit(_, shift, radixBits))
+
+  def sortBatch(xs: Seq[BigInt], batchSize: Int): Seq[BigInt] =
+    xs.grouped(batchSize).flatMap(_.sortBy(signed)).toSeq
+
+  def merge(xs: Seq[BigInt], ys: Seq[BigInt]): Seq[BigInt] = (xs ++ ys).sortBy(signed)
+
+  def permute(data: Seq[BigInt], index: Seq[Int]): Seq[BigInt] = {
+    val out = Array.fill(data.length)(BigInt(0))
+    data.zip(index).foreach { case (x, i) => out(i) = x }
+    out.toSeq
+  }
+
+  /** One step of Marsaglia's xorshift64 generator. */
+  def xorshift(x: BigInt): BigInt = {
+    val a = x ^ ((x << 13) & mask64)
+    val b = a ^ (a >> 7)
+    b ^ ((b << 17) & mask64)
+  }
+
+  /** n numbers from a RAND with a non-zero seed. Every lane steps its own
+    * generator once per batch, and a non-zero bound keeps the upper half of
+    * value * bound. */
+  def randomNumbers(seed: BigInt, bound: BigInt, n: Int, batchSize: Int): Seq[BigInt] = {
+    require(seed != 0, "Only a non-zero seed restarts the generators")
+    val golden = BigInt("9E3779B97F4A7C15", 16)
+    val batches = (n + batchSize - 1) / batchSize
+    val lanes = (0 until batchSize).map { i =>
+      val laneSeed = (golden * (i + 1)) & mask64
+      val start = if ((seed ^ laneSeed) == 0) laneSeed else seed ^ laneSeed
+      Iterator.iterate(start)(xorshift).slice(1, batches + 1).toIndexedSeq
+    }
+    (0 until n).map { j =>
+      val v = lanes(j % batchSize)(j / batchSize)
+      if (bound == 0) v else (v * bound) >> 64
+    }
+  }
+}
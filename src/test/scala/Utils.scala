@@ -23,7 +23,7 @@ object RoCCInstructionFactory {
       _.rd -> rd.U,
       _.xs1 -> xs1.B,
       _.xs2 -> xs2.B,
-      _.xd -> xs2.B,
+      _.xd -> xd.B,
       _.opcode -> ROCC_CUSTOM_OPCODE_0)
     roccInst
   }
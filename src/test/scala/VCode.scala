@@ -0,0 +1,394 @@
+package vcoderocc
+
+import org.scalatest._
+import chisel3._
+import chiseltest._
+import org.scalatest.flatspec.AnyFlatSpec
+import org.scalatest.matchers.should.Matchers
+
+import scala.util.Random
+
+import org.chipsalliance.cde.config.{Config, Parameters}
+
+/** Whole-accelerator tests, with the test bench playing the core and the L1
+  * data cache. See Harness.scala. */
+class VCodeTest extends AnyFlatSpec with ChiselScalatestTester with Matchers {
+  implicit val p: Parameters = new vcoderocc.VCodeTestConfig
+  val batchSize = 8
+  val mask64 = (BigInt(1) << 64) - 1
+
+  behavior of "VCode accelerator"
+
+  val memoryConfigs = Seq(
+    "a fixed latency" -> MemoryConfig(),
+    "random latencies, returned out of order" ->
+      MemoryConfig(minLatency = 1, maxLatency = 20, outOfOrder = true, seed = 1),
+    "backpressure" -> MemoryConfig(minLatency = 3, maxLatency = 6, readyProbability = 0.3, seed = 2))
+
+  memoryConfigs.foreach { case (desc, config) =>
+    it should s"add vectors & reduce them with $desc" in {
+      test(new VCodeCore(batchSize)) { dut =>
+        dut.clock.setTimeout(0)
+        val mem = new HellaCacheModel(config)
+        val driver = new RoCCDriver(dut, mem)
+        val rand = new Random(config.seed)
+        for (n <- Seq(1, 3, batchSize, 2 * batchSize + 5)) {
+          val a = Seq.fill(n)(BigInt(64, rand))
+          val b = Seq.fill(n)(BigInt(64, rand))
+          mem.writeVector(OpBench.rs1Addr, a)
+          mem.writeVector(OpBench.rs2Addr, b)
+          driver.issue(Instructions.SET_NUM_OPERANDS, n, xs2 = false, xd = false)
+          driver.issue(Instructions.SET_DEST_ADDR, OpBench.destAddr, xs2 = false, xd = false)
+
+          driver.issue(Instructions.PLUS_INT, OpBench.rs1Addr, OpBench.rs2Addr) shouldBe Some(0)
+          mem.readVector(OpBench.destAddr, n) shouldBe a.zip(b).map { case (x, y) => (x + y) & mask64 }
+
+          // The destination moved on past the sum, so point it back.
+          driver.issue(Instructions.SET_DEST_ADDR, OpBench.destAddr, xs2 = false, xd = false)
+          driver.issue(Instructions.PLUS_RED_INT, OpBench.rs1Addr, xs2 = false) shouldBe Some(0)
+          mem.read(OpBench.destAddr) shouldBe a.sum & mask64
+        }
+      }
+    }
+  }
+
+  def signed(v: BigInt): BigInt = if (v.testBit(63)) v - (BigInt(1) << 64) else v
+  // MUL keeps the low word, DIV & MOD are signed and round towards 0, like RISC-V.
+  val clusteredOps = Seq(
+    ("MUL", Instructions.MUL_INT, (x: BigInt, y: BigInt) => (x * y) & mask64),
+    ("DIV", Instructions.DIV_INT, (x: BigInt, y: BigInt) => (signed(x) / signed(y)) & mask64),
+    ("MOD", Instructions.MOD_INT, (x: BigInt, y: BigInt) => (signed(x) % signed(y)) & mask64))
+
+  for (clusters <- Seq(2, 3)) {
+    it should s"MUL, DIV & MOD across $clusters ALU clusters" in {
+      val clusterP: Parameters = new Config(new WithVCodeAluClusters(clusters) ++ new VCodeTestConfig)
+      test(new VCodeCore(batchSize)(clusterP)) { dut =>
+        dut.clock.setTimeout(0)
+        val config = MemoryConfig(minLatency = 1, maxLatency = 20, outOfOrder = true, seed = clusters)
+        val mem = new HellaCacheModel(config)
+        val driver = new RoCCDriver(dut, mem)
+        val rand = new Random(config.seed)
+        // Fewer batches than clusters, then several rounds ending in a partial batch.
+        for (n <- Seq(batchSize - 1, clusters * batchSize, 3 * clusters * batchSize + 5)) {
+          val a = Seq.fill(n)(BigInt(64, rand))
+          val b = Seq.fill(n)(BigInt(64, rand) | 1) // Never 0
+          mem.writeVector(OpBench.rs1Addr, a)
+          mem.writeVector(OpBench.rs2Addr, b)
+          driver.issue(Instructions.SET_NUM_OPERANDS, n, xs2 = false, xd = false)
+          for ((name, op, model) <- clusteredOps) {
+            withClue(s"$name of $n elements: ") {
+              // Each instruction leaves the destination past what it wrote.
+              driver.issue(Instructions.SET_DEST_ADDR, OpBench.destAddr, xs2 = false, xd = false)
+              driver.issue(op, OpBench.rs1Addr, OpBench.rs2Addr) shouldBe Some(0)
+              mem.readVector(OpBench.destAddr, n) shouldBe a.zip(b).map { case (x, y) => model(x, y) }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  /* Batches wider than a word of flags read several flag words per batch for
+   * SELECT, and write several for packed compares. */
+  for (wide <- Seq(128, 256)) {
+    it should s"SELECT & packed LESS with $wide-element batches" in {
+      test(new VCodeCore(wide)) { dut =>
+        dut.clock.setTimeout(0)
+        val mem = new HellaCacheModel(MemoryConfig())
+        val driver = new RoCCDriver(dut, mem)
+        val rand = new Random(wide)
+        // Ends part way through a batch, and part way through a flag word.
+        val n = 3 * wide + 37
+        val words = (n + 63) / 64
+        val a = Seq.fill(n)(BigInt(64, rand))
+        val b = Seq.fill(n)(BigInt(64, rand))
+        val flags = Seq.fill(words)(BigInt(64, rand))
+        def flag(i: Int): Boolean = flags(i / 64).testBit(i % 64)
+        mem.writeVector(OpBench.rs1Addr, a)
+        mem.writeVector(OpBench.rs2Addr, b)
+        mem.writeVector(OpBench.flagsAddr, flags)
+        driver.issue(Instructions.SET_NUM_OPERANDS, n, xs2 = false, xd = false)
+        driver.issue(Instructions.SET_DEST_ADDR, OpBench.destAddr, xs2 = false, xd = false)
+        driver.issue(Instructions.SET_THIRD_OPERAND, OpBench.flagsAddr, xs2 = false, xd = false)
+
+        val (selectStatus, selectCycles) = driver.time(Instructions.SELECT_INT, OpBench.rs1Addr, OpBench.rs2Addr)
+        selectStatus shouldBe 0
+        mem.readVector(OpBench.destAddr, n) shouldBe (0 until n).map(i => if (flag(i)) a(i) else b(i))
+
+        driver.issue(Instructions.SET_DEST_ADDR, OpBench.destAddr, xs2 = false, xd = false)
+        val (lessStatus, lessCycles) = driver.time(Instructions.LESS_PACKED_INT, OpBench.rs1Addr, OpBench.rs2Addr)
+        lessStatus shouldBe 0
+        // Flags past the end of the vector are undefined.
+        val less = (0 until words).map { w =>
+          (0 until 64).filter(k => 64 * w + k < n && a(64 * w + k) < b(64 * w + k))
+            .map(k => BigInt(1) << k).sum
+        }
+        val lastBits = (BigInt(1) << (n - 64 * (words - 1))) - 1
+        val packed = mem.readVector(OpBench.destAddr, words)
+        packed.init shouldBe less.init
+        (packed.last & lastBits) shouldBe less.last
+
+        println(f"batchSize $wide%d, $n%d elements: SELECT $selectCycles%d cycles " +
+          f"(${selectCycles.toDouble / n}%.2f per element), " +
+          f"LESS_PACKED $lessCycles%d cycles (${lessCycles.toDouble / n}%.2f per element)")
+      }
+    }
+  }
+
+  it should "hold back an instruction reading a PERMUTE's destination" in {
+    test(new VCodeCore(batchSize)) { dut =>
+      dut.clock.setTimeout(0)
+      val config = MemoryConfig(minLatency = 1, maxLatency = 20, outOfOrder = true, seed = 3)
+      val mem = new HellaCacheModel(config)
+      val driver = new RoCCDriver(dut, mem)
+      val rand = new Random(config.seed)
+      val n = 2 * batchSize + 3
+      val data = Seq.fill(n)(BigInt(64, rand))
+      val indices = rand.shuffle((0 until n).toList)
+      val permutedAddr = OpBench.flagsAddr
+      mem.writeVector(OpBench.rs1Addr, data)
+      mem.writeVector(OpBench.rs2Addr, indices.map(BigInt(_)))
+
+      // The configuration must reach the PERMUTE, issued right after it.
+      driver.issue(Instructions.SET_NUM_OPERANDS, n, xs2 = false, xd = false)
+      driver.issue(Instructions.SET_DEST_ADDR, permutedAddr, xs2 = false, xd = false)
+      driver.send(Instructions.PERMUTE_INT, OpBench.rs1Addr, OpBench.rs2Addr, rd = 2)
+      driver.issue(Instructions.SET_DEST_ADDR, OpBench.destAddr, xs2 = false, xd = false)
+      /* A strided copy may read anything above its source, so its footprint
+       * runs to the top of memory, and it must wait for the PERMUTE. */
+      driver.issue(Instructions.COPY_STRIDED_INT, permutedAddr, 1) shouldBe Some(0)
+      driver.await(2) shouldBe 0
+
+      val expected = Array.fill(n)(BigInt(0))
+      indices.zip(data).foreach { case (i, x) => expected(i) = x }
+      mem.readVector(permutedAddr, n) shouldBe expected.toSeq
+      mem.readVector(OpBench.destAddr, n) shouldBe expected.toSeq
+    }
+  }
+
+  it should "run a PERMUTE while an ALU instruction is running" in {
+    test(new VCodeCore(batchSize)) { dut =>
+      dut.clock.setTimeout(0)
+      val mem = new HellaCacheModel(MemoryConfig())
+      val driver = new RoCCDriver(dut, mem)
+      val rand = new Random(7)
+      // Long enough for the ALU instruction to still be running once the PERMUTE is accepted.
+      val n = 64 * batchSize
+      val m = 2 * batchSize + 3
+      val a = Seq.fill(n)(BigInt(64, rand))
+      val b = Seq.fill(n)(BigInt(64, rand))
+      val data = Seq.fill(m)(BigInt(64, rand))
+      val indices = rand.shuffle((0 until m).toList)
+      val permSrc = OpBench.destAddr + 0x100000
+      val permIdx = OpBench.destAddr + 0x200000
+      val permutedAddr = OpBench.destAddr + 0x300000
+      mem.writeVector(OpBench.rs1Addr, a)
+      mem.writeVector(OpBench.rs2Addr, b)
+      mem.writeVector(permSrc, data)
+      mem.writeVector(permIdx, indices.map(BigInt(_)))
+
+      driver.issue(Instructions.SET_NUM_OPERANDS, n, xs2 = false, xd = false)
+      driver.issue(Instructions.SET_DEST_ADDR, OpBench.destAddr, xs2 = false, xd = false)
+      driver.send(Instructions.PLUS_INT, OpBench.rs1Addr, OpBench.rs2Addr, rd = 1)
+      // Set up & start the PERMUTE behind the running PLUS, on memory it does not touch.
+      driver.issue(Instructions.SET_NUM_OPERANDS, m, xs2 = false, xd = false)
+      driver.issue(Instructions.SET_DEST_ADDR, permutedAddr, xs2 = false, xd = false)
+      driver.send(Instructions.PERMUTE_INT, permSrc, permIdx, rd = 2)
+      driver.responded(1) shouldBe false
+      driver.await(2) shouldBe 0
+      driver.await(1) shouldBe 0
+
+      mem.readVector(OpBench.destAddr, n) shouldBe a.zip(b).map { case (x, y) => (x + y) & mask64 }
+      val expected = Array.fill(m)(BigInt(0))
+      indices.zip(data).foreach { case (i, x) => expected(i) = x }
+      mem.readVector(permutedAddr, m) shouldBe expected.toSeq
+
+      // The staged configuration also applies to the next main-lane instruction.
+      driver.issue(Instructions.PLUS_INT, permSrc, permSrc) shouldBe Some(0)
+      mem.readVector(permutedAddr, m) shouldBe data.map(x => (2 * x) & mask64)
+    }
+  }
+
+  it should "hold back an instruction reading a PERMUTE's destination in header mode" in {
+    test(new VCodeCore(batchSize)) { dut =>
+      dut.clock.setTimeout(0)
+      val config = MemoryConfig(minLatency = 1, maxLatency = 20, outOfOrder = true, seed = 4)
+      val mem = new HellaCacheModel(config)
+      val driver = new RoCCDriver(dut, mem)
+      val rand = new Random(config.seed)
+      val n = 2 * batchSize + 3
+      val data = Seq.fill(n)(BigInt(64, rand))
+      val indices = rand.shuffle((0 until n).toList)
+      val onesAddr = OpBench.flagsAddr
+      val permutedAddr = OpBench.destAddr
+      val dependentAddr = OpBench.destAddr + 0x100000
+      // Every vector starts with a header holding its length.
+      mem.writeVector(OpBench.rs1Addr, BigInt(n) +: data)
+      mem.writeVector(OpBench.rs2Addr, BigInt(n) +: indices.map(BigInt(_)))
+      mem.writeVector(onesAddr, BigInt(n) +: Seq.fill(n)(BigInt(1)))
+
+      driver.issue(Instructions.SET_HEADER_MODE, 1, xs2 = false, xd = false)
+      driver.issue(Instructions.SET_DEST_ADDR, permutedAddr, xs2 = false, xd = false)
+      driver.send(Instructions.PERMUTE_INT, OpBench.rs1Addr, OpBench.rs2Addr, rd = 2)
+      driver.issue(Instructions.SET_DEST_ADDR, dependentAddr, xs2 = false, xd = false)
+      driver.issue(Instructions.PLUS_INT, permutedAddr, onesAddr) shouldBe Some(0)
+      driver.await(2) shouldBe 0
+      driver.issue(Instructions.SET_HEADER_MODE, 0, xs2 = false, xd = false)
+
+      val expected = Array.fill(n)(BigInt(0))
+      indices.zip(data).foreach { case (i, x) => expected(i) = x }
+      mem.readVector(permutedAddr, n + 1) shouldBe BigInt(n) +: expected.toSeq
+      mem.readVector(dependentAddr, n + 1) shouldBe BigInt(n) +: expected.toSeq.map(x => (x + 1) & mask64)
+    }
+  }
+
+  it should "ignore accumulators past the last one" in {
+    test(new VCodeCore(batchSize)) { dut =>
+      dut.clock.setTimeout(0)
+      val mem = new HellaCacheModel(MemoryConfig())
+      val driver = new RoCCDriver(dut, mem)
+      val rand = new Random(5)
+      val n = batchSize + 3
+      val a = Seq.fill(n)(BigInt(32, rand))
+      mem.writeVector(OpBench.rs1Addr, a)
+      driver.issue(Instructions.SET_NUM_OPERANDS, n, xs2 = false, xd = false)
+      driver.issue(Instructions.SET_DEST_ADDR, OpBench.destAddr, xs2 = false, xd = false)
+
+      // Keep the sum in the last accumulator, then try to select one past it.
+      driver.issue(Instructions.CLEAR_ACCUMULATOR, ALU.NUM_ACCUMULATORS - 1, 0, xd = false)
+      driver.issue(Instructions.SET_ACCUMULATOR, ALU.NUM_ACCUMULATORS, xs2 = false, xd = false)
+      driver.issue(Instructions.SET_ACCUMULATOR, 8, xs2 = false, xd = false)
+      driver.issue(Instructions.PLUS_RED_INT, OpBench.rs1Addr, xs2 = false) shouldBe Some(0)
+      driver.issue(Instructions.SET_ACCUMULATOR, 0, xs2 = false, xd = false)
+      driver.issue(Instructions.READ_ACCUMULATOR, ALU.NUM_ACCUMULATORS - 1, xs2 = false) shouldBe Some(a.sum)
+      driver.issue(Instructions.READ_ACCUMULATOR, ALU.NUM_ACCUMULATORS, xs2 = false) shouldBe Some(0)
+    }
+  }
+
+  it should "clear an accumulator only after the reduction into it" in {
+    test(new VCodeCore(batchSize)) { dut =>
+      dut.clock.setTimeout(0)
+      val mem = new HellaCacheModel(MemoryConfig())
+      val driver = new RoCCDriver(dut, mem)
+      val rand = new Random(9)
+      val n = 16 * batchSize + 3
+      val a = Seq.fill(n)(BigInt(32, rand))
+      val start = BigInt(1000)
+      mem.writeVector(OpBench.rs1Addr, a)
+      driver.issue(Instructions.SET_NUM_OPERANDS, n, xs2 = false, xd = false)
+      driver.issue(Instructions.SET_DEST_ADDR, OpBench.destAddr, xs2 = false, xd = false)
+      driver.issue(Instructions.CLEAR_ACCUMULATOR, 0, 0, xd = false)
+      driver.issue(Instructions.SET_ACCUMULATOR, 1, xs2 = false, xd = false)
+
+      // The CLEAR waits behind the reduction, and must not touch it.
+      driver.send(Instructions.PLUS_RED_INT, OpBench.rs1Addr, xs2 = false, rd = 1)
+      driver.send(Instructions.CLEAR_ACCUMULATOR, 0, start, xd = false)
+      driver.await(1) shouldBe 0
+      driver.issue(Instructions.READ_ACCUMULATOR, 0, xs2 = false) shouldBe Some(start)
+      // It clears once, so the next reduction carries on from it.
+      driver.issue(Instructions.PLUS_RED_INT, OpBench.rs1Addr, xs2 = false) shouldBe Some(0)
+      driver.issue(Instructions.READ_ACCUMULATOR, 0, xs2 = false) shouldBe Some(start + a.sum)
+    }
+  }
+
+  it should "merge sort signed keys" in {
+    test(new VCodeCore(batchSize)) { dut =>
+      dut.clock.setTimeout(0)
+      val mem = new HellaCacheModel(MemoryConfig())
+      val driver = new RoCCDriver(dut, mem)
+      val rand = new Random(6)
+      val n = 16 * batchSize
+      val keys = Seq.fill(n)(BigInt(64, rand))
+      mem.writeVector(OpBench.rs1Addr, keys)
+      val (sorted, cycles) = OpBench.mergeSort(driver, n, batchSize, OpBench.rs1Addr, OpBench.destAddr)
+      mem.readVector(sorted, n) shouldBe keys.sortBy(signed)
+      println(s"Merge sort of $n keys: $cycles cycles")
+    }
+  }
+
+  it should "merge vectors whose length is not a multiple of batchSize" in {
+    test(new VCodeCore(batchSize)) { dut =>
+      dut.clock.setTimeout(0)
+      val config = MemoryConfig(minLatency = 1, maxLatency = 20, outOfOrder = true, seed = 8)
+      val mem = new HellaCacheModel(config)
+      val driver = new RoCCDriver(dut, mem)
+      val rand = new Random(config.seed)
+      val sentinel = BigInt("5eed5eed5eed5eed", 16)
+      for (n <- Seq(1, batchSize - 3, 2 * batchSize + 3)) {
+        val a = Seq.fill(n)(BigInt(64, rand)).sortBy(signed)
+        val b = Seq.fill(n)(BigInt(64, rand)).sortBy(signed)
+        mem.writeVector(OpBench.rs1Addr, a)
+        mem.writeVector(OpBench.rs2Addr, b)
+        mem.write(OpBench.destAddr + 16 * n, sentinel)
+        driver.issue(Instructions.SET_NUM_OPERANDS, n, xs2 = false, xd = false)
+        driver.issue(Instructions.SET_DEST_ADDR, OpBench.destAddr, xs2 = false, xd = false)
+        withClue(s"MERGE of $n elements: ") {
+          driver.issue(Instructions.MERGE_INT, OpBench.rs1Addr, OpBench.rs2Addr) shouldBe Some(0)
+          mem.readVector(OpBench.destAddr, 2 * n) shouldBe (a ++ b).sortBy(signed)
+          mem.read(OpBench.destAddr + 16 * n) shouldBe sentinel
+        }
+      }
+    }
+  }
+
+  it should "skip fetch2 for two operands that fit in half a batch" in {
+    test(new VCodeCore(batchSize)) { dut =>
+      dut.clock.setTimeout(0)
+      val mem = new HellaCacheModel(MemoryConfig())
+      val driver = new RoCCDriver(dut, mem)
+      val fetch2Cycles = PerfCounters.CYCLES_IN_STATE + 2 // ControlUnit.State.fetch2
+      for ((n, paired) <- Seq(batchSize / 2 -> true, batchSize / 2 + 1 -> false)) {
+        val a = Seq.tabulate(n)(i => BigInt(i + 1))
+        val b = Seq.tabulate(n)(i => BigInt(3 * i + 5))
+        mem.writeVector(OpBench.rs1Addr, a)
+        mem.writeVector(OpBench.rs2Addr, b)
+        driver.issue(Instructions.SET_NUM_OPERANDS, n, xs2 = false, xd = false)
+        driver.issue(Instructions.SET_DEST_ADDR, OpBench.destAddr, xs2 = false, xd = false)
+        driver.issue(Instructions.RESET_COUNTERS, xs1 = false, xs2 = false, xd = false)
+        driver.issue(Instructions.PLUS_INT, OpBench.rs1Addr, OpBench.rs2Addr) shouldBe Some(0)
+        mem.readVector(OpBench.destAddr, n) shouldBe a.zip(b).map { case (x, y) => x + y }
+        val fetch2 = driver.issue(Instructions.READ_COUNTER, fetch2Cycles, xs2 = false).get
+        withClue(s"fetch2 cycles for $n elements: ") {
+          if (paired) fetch2 shouldBe 0 else fetch2 should be > BigInt(0)
+        }
+      }
+    }
+  }
+
+  it should "take fewer cycles for short vectors fetched in one pass" in {
+    // The instructions rocc_short_vector.c times, plus a scan and a compare.
+    val ops = Seq("PLUS_INT", "MUL_RED_INT", "PLUS_SCAN_INT", "LESS_INT")
+    def timings(pairing: Boolean): Seq[OpTiming] = {
+      val pairP: Parameters = new Config(new WithVCodePairShortVectors(pairing) ++ new VCodeTestConfig)
+      var result = Seq.empty[OpTiming]
+      test(new VCodeCore(batchSize)(pairP)) { dut =>
+        result = OpBench.run(dut, batchSize, MemoryConfig(), 3 to 20, ops)(pairP)
+      }
+      result
+    }
+    val before = timings(pairing = false)
+    val after = timings(pairing = true)
+    println("Without the single-pass fetch:\n" + OpBench.report(before))
+    println("With the single-pass fetch:\n" + OpBench.report(after))
+    after.map(_.op).distinct should contain theSameElementsAs ops
+    for ((b, a) <- before.zip(after)) {
+      withClue(s"${a.op} of ${a.length} elements: ") {
+        (a.op, a.length) shouldBe ((b.op, b.length))
+        a.cycles should be <= b.cycles
+        // Only two-operand instructions fetch both operands at once.
+        if (a.length <= batchSize / 2 && Seq("PLUS_INT", "LESS_INT").contains(a.op)) {
+          a.cycles should be < b.cycles
+        }
+      }
+    }
+  }
+
+  it should "report the cycles every vector instruction takes" in {
+    test(new VCodeCore(batchSize)) { dut =>
+      // OpBench.time checks every result against OpModel before timing counts.
+      val timings = OpBench.run(dut, batchSize, MemoryConfig(), Seq(1, 8, 13, 64, 256))
+      timings.map(_.op).distinct should contain theSameElementsAs OpBench.vectorOps.map(_._1)
+      println(OpBench.report(timings))
+    }
+  }
+}
@@ -0,0 +1,186 @@
+package vcoderocc.bench
+
+import chisel3._
+import chisel3.util.BitPat
+import chiseltest._
+import org.scalatest.{BeforeAndAfterAllConfigMap, ConfigMap}
+import org.scalatest.flatspec.AnyFlatSpec
+import org.scalatest.matchers.should.Matchers
+
+import java.io.{File, PrintWriter}
+import scala.io.Source
+import scala.util.Random
+
+import org.chipsalliance.cde.config.Parameters
+import vcoderocc._
+
+/** Cycles per element of one instruction, at one batchSize & vector length. */
+case class BenchResult(family: String, op: String, batchSize: Int, length: Int, cycles: Long) {
+  def cyclesPerElement: Double = cycles.toDouble / length
+  def key: (String, Int, Int) = (op, batchSize, length)
+}
+
+object BenchResult {
+  val header = "family,op,batchSize,length,cycles,cyclesPerElement"
+
+  def toCsv(r: BenchResult): String =
+    f"${r.family},${r.op},${r.batchSize},${r.length},${r.cycles},${r.cyclesPerElement}%.4f"
+
+  /** Read results back from CSV, skipping the header & # comments. */
+  def fromCsv(lines: Iterator[String]): Seq[BenchResult] =
+    lines.map(_.trim).filter(l => l.nonEmpty && !l.startsWith("#") && l != header).map { l =>
+      val f = l.split(",")
+      BenchResult(f(0), f(1), f(2).toInt, f(3).toInt, f(4).toLong)
+    }.toSeq
+}
+
+/** Performance regression suite. Sweeps every instruction of every opcode
+  * family over each vector length & batchSize, writes the cycles per element
+  * to a CSV, and fails if any entry got slower than the checked-in baseline
+  * by more than a threshold, or has no baseline to compare against.
+  *
+  * It is slow, so it only runs when asked to:
+  * {{{
+  * $ sbt bench
+  * $ sbt "testOnly vcoderocc.bench.* -- -Dbench=true"
+  * }}}
+  * Settings are passed the same way, as -Dname=value:
+  *  - lengths, batchSizes: comma-separated lists overriding the sweep.
+  *  - long: true adds vectors of 65536 elements to the default lengths.
+  *    At a batchSize of 2 each of those runs 32768 batches per instruction,
+  *    which makes them most of the sweep's time.
+  *  - ops: comma-separated instruction names, to sweep only those.
+  *  - threshold: the largest slowdown allowed, as a fraction. 0.05 = 5%.
+  *  - out: where to write the CSV.
+  *  - update: write the results over the baseline at this path, instead of
+  *    checking against it.
+  */
+class BenchSuite extends AnyFlatSpec with ChiselScalatestTester with Matchers
+    with BeforeAndAfterAllConfigMap {
+  implicit val p: Parameters = new vcoderocc.VCodeTestConfig
+
+  var settings = ConfigMap.empty
+  override def beforeAll(configMap: ConfigMap): Unit = settings = configMap
+
+  def setting(name: String, default: String): String =
+    settings.getOptional[String](name).getOrElse(default)
+  def ints(name: String, default: Seq[Int]): Seq[Int] =
+    settings.getOptional[String](name).map(_.split(",").map(_.trim.toInt).toSeq).getOrElse(default)
+
+  val baselineResource = "/vcoderocc/bench/baseline.csv"
+
+  /** Every opcode family swept, by the decode table that holds it. */
+  def families: Seq[(String, Array[(BitPat, List[BitPat])])] = Seq(
+    "binop" -> new BinOpDecode().decodeTable,
+    "reduce" -> new ReduceDecode().decodeTable,
+    "scan" -> new ScanDecode().decodeTable,
+    "select" -> new SelectDecode().decodeTable,
+    "permute" -> new PermuteDecode().decodeTable,
+    "float" -> new FloatDecode().decodeTable,
+    "sort" -> new SortDecode().decodeTable,
+    "packedBool" -> new PackedBoolDecode().decodeTable,
+    "generator" -> new GeneratorDecode().decodeTable,
+    "element" -> new ElementDecode().decodeTable,
+    "copy" -> new CopyDecode().decodeTable)
+
+  behavior of "VCode accelerator performance"
+
+  it should "not regress against the baseline" in {
+    assume(settings.contains("bench"), "run with sbt bench")
+    val long = if (setting("long", "false").toBoolean) Seq(65536) else Seq.empty
+    val lengths = ints("lengths", Seq(1, 7, 64, 1000) ++ long)
+    val batchSizes = ints("batchSizes", Seq(2, 8, 32, 64))
+    val only = settings.getOptional[String]("ops").map(_.split(",").map(_.trim).toSet)
+    val threshold = setting("threshold", "0.05").toDouble
+
+    val instructions = OpBench.instructions
+    val ops = for {
+      (family, table) <- families
+      (op, _) <- table.toSeq
+      name = instructions.find(_._2 == op).get._1
+      if only.forall(_.contains(name))
+    } yield (family, name, op)
+
+    val results = batchSizes.flatMap { batchSize =>
+      var timings = Seq.empty[BenchResult]
+      test(new VCodeCore(batchSize)) { dut =>
+        dut.clock.setTimeout(0)
+        val config = MemoryConfig()
+        val mem = new HellaCacheModel(config)
+        // The longest vectors take far more cycles than the driver normally waits.
+        val driver = new RoCCDriver(dut, mem, maxCycles = 100 * lengths.max + 200000)
+        val rand = new Random(config.seed)
+        timings = for {
+          (family, name, op) <- ops
+          length <- lengths
+        } yield {
+          val t = OpBench.time(driver, mem, name, op, length, batchSize, rand)
+          BenchResult(family, name, batchSize, length, t.cycles)
+        }
+      }
+      timings
+    }
+
+    val out = new File(setting("out", "target/bench/results.csv"))
+    writeCsv(out, results)
+    println(s"Benchmark results written to ${out.getPath}")
+
+    settings.getOptional[String]("update") match {
+      case Some(path) =>
+        writeCsv(new File(path), results, baselineComments)
+        println(s"Baseline updated at $path")
+      case None =>
+        val stream = getClass.getResourceAsStream(baselineResource)
+        val baseline = if (stream == null) Seq.empty
+          else BenchResult.fromCsv(Source.fromInputStream(stream).getLines())
+        val byKey = baseline.map(b => b.key -> b).toMap
+        withClue(s"No baseline at $baselineResource; generate it with -Dupdate\n") {
+          baseline should not be empty
+        }
+        val regressions = results.flatMap { r =>
+          byKey.get(r.key).filter(b => r.cyclesPerElement > b.cyclesPerElement * (1 + threshold)).map { b =>
+            f"${r.op} batchSize ${r.batchSize} length ${r.length}: " +
+              f"${b.cyclesPerElement}%.4f -> ${r.cyclesPerElement}%.4f cycles/element"
+          }
+        }
+        // Both ways: a new result needs a baseline, and a baseline line in
+        // the sweep's range needs a result, or an instruction silently
+        // dropping out of the sweep would pass.
+        val resultKeys = results.map(_.key).toSet
+        val names = ops.map(_._2).toSet
+        val unmatched = results.filterNot(r => byKey.contains(r.key)).map { r =>
+          s"${r.op} batchSize ${r.batchSize} length ${r.length}: no baseline"
+        } ++ baseline.filter { b =>
+          names.contains(b.op) && batchSizes.contains(b.batchSize) && lengths.contains(b.length) &&
+            !resultKeys.contains(b.key)
+        }.map(b => s"${b.op} batchSize ${b.batchSize} length ${b.length}: no result")
+        withClue("Results & baseline do not match, regenerate it with -Dupdate:\n" +
+          unmatched.mkString("\n") + "\n") {
+          unmatched shouldBe empty
+        }
+        withClue(s"Slower than the baseline by more than ${threshold * 100}%:\n" +
+          regressions.mkString("\n") + "\n") {
+          regressions shouldBe empty
+        }
+    }
+  }
+
+  val baselineComments = Seq(
+    "# Cycles per element of each benchmark, checked by vcoderocc.bench.BenchSuite.",
+    "# Regenerate after a deliberate performance change with:",
+    "#   sbt \"bench -Dlong=true -Dupdate=src/test/resources/vcoderocc/bench/baseline.csv\"",
+    "# Lines for lengths outside a run's sweep are not checked by it.",
+    "# A result with no line here, or a line here with no result, fails.")
+
+  def writeCsv(file: File, results: Seq[BenchResult], comments: Seq[String] = Seq.empty): Unit = {
+    Option(file.getParentFile).foreach(_.mkdirs())
+    val w = new PrintWriter(file)
+    try {
+      comments.foreach(w.println)
+      w.println(BenchResult.header)
+      results.map(BenchResult.toCsv).foreach(w.println)
+    } finally {
+      w.close()
+    }
+  }
+}
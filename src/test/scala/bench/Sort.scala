@@ -0,0 +1,70 @@
+package vcoderocc.bench
+
+import chisel3._
+import chiseltest._
+import org.scalatest.{BeforeAndAfterAllConfigMap, ConfigMap}
+import org.scalatest.flatspec.AnyFlatSpec
+import org.scalatest.matchers.should.Matchers
+
+import scala.util.Random
+
+import org.chipsalliance.cde.config.Parameters
+import vcoderocc._
+
+/** Sort throughput. Runs the merge sort of rocc_merge_sort.c (SORT_BATCH_INT,
+  * then passes of MERGE_INT) on the harness, for 1K to 1M keys, and prints the
+  * accelerator's cycles & cycles per key.
+  *
+  * The harness has no core, so it cannot run qsort. The comparison against
+  * qsort is rocc_merge_sort.c on a Rocket core: built with
+  * -DNUM_ELEMENTS=1048576 and the same BATCH_SIZE, it prints the cycles of
+  * both at 1K to 1M elements.
+  *
+  * Like BenchSuite it only runs when asked to:
+  * {{{
+  * $ sbt bench
+  * $ sbt "testOnly vcoderocc.bench.SortBench -- -Dbench=true"
+  * }}}
+  * Settings, as -Dname=value:
+  *  - sizes: comma-separated numbers of keys, each a power of 2.
+  *  - batchSize: the batchSize to build the accelerator with.
+  */
+class SortBench extends AnyFlatSpec with ChiselScalatestTester with Matchers
+    with BeforeAndAfterAllConfigMap {
+  implicit val p: Parameters = new vcoderocc.VCodeTestConfig
+
+  var settings = ConfigMap.empty
+  override def beforeAll(configMap: ConfigMap): Unit = settings = configMap
+
+  // Far enough apart for 1M keys.
+  val keysAddr = BigInt(0x1000000)
+  val tmpAddr = BigInt(0x2000000)
+
+  behavior of "VCode accelerator sorting"
+
+  it should "sort 1K to 1M keys" in {
+    assume(settings.contains("bench"), "run with -Dbench=true")
+    val sizes = settings.getOptional[String]("sizes").map(_.split(",").map(_.trim.toInt).toSeq)
+      .getOrElse(Seq(1 << 10, 1 << 12, 1 << 14, 1 << 16, 1 << 18, 1 << 20))
+    val batchSize = settings.getOptional[String]("batchSize").map(_.toInt).getOrElse(8)
+
+    val lines = for (n <- sizes) yield {
+      var line = ""
+      test(new VCodeCore(batchSize)) { dut =>
+        dut.clock.setTimeout(0)
+        val mem = new HellaCacheModel(MemoryConfig())
+        // The last MERGE runs over every key at once.
+        val driver = new RoCCDriver(dut, mem, maxCycles = 100 * n + 200000)
+        val rand = new Random(n)
+        val keys = Seq.fill(n)(BigInt(64, rand))
+        mem.writeVector(keysAddr, keys)
+        val (sorted, cycles) = OpBench.mergeSort(driver, n, batchSize, keysAddr, tmpAddr)
+        def signed(v: BigInt): BigInt = if (v.testBit(63)) v - (BigInt(1) << 64) else v
+        mem.readVector(sorted, n) shouldBe keys.sortBy(signed)
+        line = f"$n%10d keys: $cycles%12d cycles, ${cycles.toDouble / n}%8.2f cycles per key"
+      }
+      line
+    }
+    println((s"Merge sort at batchSize $batchSize" +: lines).mkString("\n"))
+  }
+}
@@ -0,0 +1,79 @@
+// Helpers for reading the VCODE accelerator's performance counters.
+// See src/main/scala/PerfCounters.scala for what each counter counts.
+
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "rocc.h"
+
+#define READ_COUNTER_FUNCT7 0x6A
+#define RESET_COUNTERS_FUNCT7 0x4A
+
+// Counters 0-8 count cycles spent in each of the main lane's control states.
+#define COUNTER_CYCLES_IDLE         0
+#define COUNTER_CYCLES_FETCH1       1
+#define COUNTER_CYCLES_FETCH2       2
+#define COUNTER_CYCLES_FETCH3       3
+#define COUNTER_CYCLES_EXE          4
+#define COUNTER_CYCLES_WRITE        5
+#define COUNTER_CYCLES_RESPOND      6
+#define COUNTER_CYCLES_READ_HEADER  7
+#define COUNTER_CYCLES_WRITE_HEADER 8
+#define COUNTER_PERM_BUSY_CYCLES    9
+#define COUNTER_MAIN_REQS           10
+#define COUNTER_MAIN_RESPS          11
+#define COUNTER_MAIN_REQ_STALLS     12
+#define COUNTER_PERM_REQS           13
+#define COUNTER_PERM_RESPS          14
+#define COUNTER_PERM_REQ_STALLS     15
+#define COUNTER_ALU_BATCHES         16
+#define COUNTER_FPU_BATCHES         17
+#define COUNTER_SORT_BATCHES        18
+#define COUNTER_PERMUTE_BATCHES     19
+// Bucket 0 counts main lane loads taking under 4 cycles, bucket k those
+// taking 2^(k+1) to 2^(k+2)-1 cycles, and the last bucket everything slower.
+#define COUNTER_LATENCY_HISTOGRAM   20
+#define LATENCY_BUCKETS             8
+#define COUNTER_LATENCY_TOTAL       28
+#define COUNTER_OCCUPANCY_TOTAL     29
+#define COUNTER_TAGS_FULL_CYCLES    30
+#define NUM_COUNTERS                31
+
+static const char* const counter_names[NUM_COUNTERS] = {
+  "idle", "fetch1", "fetch2", "fetch3", "exe", "write", "respond",
+  "readHeader", "writeHeader", "perm busy",
+  "main reqs", "main resps", "main req stalls",
+  "perm reqs", "perm resps", "perm req stalls",
+  "alu batches", "fpu batches", "sort batches", "permute batches",
+  "latency <4", "latency 4-7", "latency 8-15", "latency 16-31",
+  "latency 32-63", "latency 64-127", "latency 128-255", "latency 256+",
+  "latency total", "occupancy total", "tags full cycles"
+};
+
+static inline uint64_t read_counter(uint64_t n)
+{
+  uint64_t value;
+  ROCC_INSTRUCTION_DS(0, value, n, READ_COUNTER_FUNCT7);
+  return value;
+}
+
+static inline void reset_counters(void)
+{
+  ROCC_INSTRUCTION(0, RESET_COUNTERS_FUNCT7);
+}
+
+// Like util.h's stats, but prints the accelerator's counters for code instead.
+#define counter_stringify_1(s) #s
+#define counter_stringify(s) counter_stringify_1(s)
+#define counter_stats(code) do { \
+    int _n; \
+    reset_counters(); \
+    code; \
+    printf("\n%s:\n", counter_stringify(code)); \
+    for (_n = 0; _n < NUM_COUNTERS; _n++) \
+      printf("  %s: %ld\n", counter_names[_n], (long)read_counter(_n)); \
+  } while(0)
+
+#endif // COUNTERS_H
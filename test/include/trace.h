@@ -0,0 +1,36 @@
+// Helpers for draining the VCODE accelerator's trace buffer.
+// See src/main/scala/TraceBuffer.scala for what each record holds, and
+// test/utils/decode_trace.py to turn print_trace's output into a timeline.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "rocc.h"
+
+#define DRAIN_TRACE_FUNCT7 0x6B
+
+// Write up to n of the oldest trace records to buf, and remove them from the
+// trace. Words of buf past the records written are set to 0.
+// Returns the number of records written.
+// This changes the number of operands and destination address set in the
+// accelerator.
+static inline uint64_t drain_trace(uint64_t* buf, uint64_t n)
+{
+  uint64_t written;
+  ROCC_INSTRUCTION_S(0, n, 0x40);
+  ROCC_INSTRUCTION_S(0, buf, 0x41);
+  ROCC_INSTRUCTION_D(0, written, DRAIN_TRACE_FUNCT7);
+  return written;
+}
+
+// Print n trace records in the form decode_trace.py reads.
+static inline void print_trace(const uint64_t* buf, uint64_t n)
+{
+  uint64_t i;
+  for (i = 0; i < n; i++)
+    printf("TRACE %016lx\n", (unsigned long)buf[i]);
+}
+
+#endif // TRACE_H
@@ -11,8 +11,11 @@ TEST_SRCS += rocc_add.c host_add.c \
              rocc_greater_equal.c\
              rocc_equal.c\
              rocc_unequal.c\
+             rocc_less_signed.c\
+             rocc_min_int.c\
              rocc_left_shift.c\
              rocc_right_shift.c\
+             rocc_arith_right_shift.c\
              rocc_not.c\
              rocc_and.c\
              rocc_or.c\
@@ -32,7 +35,21 @@ TEST_SRCS += rocc_add.c host_add.c \
              rocc_and_reduce_int.c rocc_and_reduce_int_long.c\
              rocc_or_reduce_int.c rocc_or_reduce_int_long.c\
              rocc_xor_reduce_int.c rocc_xor_reduce_int_long.c\
-             rocc_permute_int.c\
+             rocc_permute_int.c rocc_permute_overlap.c \
+             rocc_permute_overlap_header.c \
+             rocc_index_int.c rocc_dist_int.c rocc_rand_int.c \
+             rocc_copy_int.c rocc_copy_strided_int.c \
+             rocc_extract_replace.c \
+             rocc_add_float.c rocc_div_float.c \
+             rocc_add_reduce_float.c rocc_add_scan_float.c \
+             rocc_dot_int.c rocc_accumulate_reduce.c \
+             rocc_popcount_int.c rocc_clz_int.c rocc_popcount_reduce_int.c \
+             rocc_radix_sort.c rocc_merge_sort.c \
+             rocc_less_packed_select.c rocc_and_bool.c \
+             rocc_select_wide.c rocc_less_packed_wide.c \
+             rocc_short_vector.c rocc_strided_2d.c rocc_header.c \
+             rocc_counters.c rocc_trace.c \
+             rocc_add_int8.c \
              rocc_illegal.c rocc_illegal_nonblocking.c \
              host_div0.c host_ecall.c \
              malloc.c
@@ -0,0 +1,33 @@
+#include <rocc.h>
+#include <stdint.h>
+
+int main() {
+    int64_t rocc_computed,status;
+    int64_t dest = 0x1234;
+    int64_t a[4] = { 1, 2, 3, 4 };
+    int64_t b[6] = { 10, 20, 30, 40, 50, 60 };
+
+    ROCC_INSTRUCTION_SS(0, 0, 0, 0x45); // Clear accumulator 0 to 0
+    ROCC_INSTRUCTION_S(0, 1, 0x44);  // Accumulate into accumulator 0
+    ROCC_INSTRUCTION_S(0, &dest, 0x41); // Send destination address
+    ROCC_INSTRUCTION_S(0, 4, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_DS(0, status, &a, 0x02); // +_REDUCE a
+    if (status != 0) { return 10; }
+    ROCC_INSTRUCTION_S(0, 6, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_DS(0, status, &b, 0x02); // +_REDUCE b
+    if (status != 0) { return 10; }
+    ROCC_INSTRUCTION_S(0, 0, 0x44);  // Stop accumulating
+    ROCC_INSTRUCTION_DS(0, rocc_computed, 0, 0x69); // Read accumulator 0
+
+    int64_t expected = 0;
+    for(int i = 0; i < 4; i++){
+        expected += a[i];
+    }
+    for(int i = 0; i < 6; i++){
+        expected += b[i];
+    }
+
+    // Accumulated reductions must not write their result out.
+    if (dest != 0x1234) { return 2; }
+    return (expected == rocc_computed) ? 0 : 1;
+}
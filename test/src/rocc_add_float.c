@@ -0,0 +1,24 @@
+#include <rocc.h>
+#include <stdint.h>
+
+int main() {
+    int64_t status;
+    double c[4];
+    double a[4] = {1.5, -2.25, 1e10, 0.125};
+    double b[4] = {2.5, 0.25, -1e10, 3.0};
+    ROCC_INSTRUCTION_S(0, 4, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_S(0, &c, 0x41); // Send destination address
+    ROCC_INSTRUCTION_DSS(0, status, &a, &b, 0x50); // Wait for result
+
+    // Every sum is exactly representable, so the comparison can be exact.
+    if (status == 0) {
+        for(int i = 0; i < 4; i++) {
+            if(c[i] != a[i] + b[i]) {
+                return i+1;
+            }
+        }
+    }
+    else { return 10; }
+
+    return 0;
+}
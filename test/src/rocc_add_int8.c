@@ -0,0 +1,39 @@
+#include <rocc.h>
+#include <stdint.h>
+
+/* Sub-word elements are read and written in whole 8-byte words, so every
+ * vector is padded to a multiple of 8 bytes. */
+#define NUM_ELEMENTS 21
+#define PADDED_ELEMENTS 24
+
+#define MT8 0x0
+#define MT64 0x3
+
+int main() {
+    int8_t c[PADDED_ELEMENTS] __attribute__((aligned(8)));
+    int8_t a[PADDED_ELEMENTS] __attribute__((aligned(8)));
+    int8_t b[PADDED_ELEMENTS] __attribute__((aligned(8)));
+    int64_t status;
+    for(int i = 0; i < PADDED_ELEMENTS; i++) {
+        a[i] = (int8_t)(i * 13);
+        b[i] = (int8_t)(120 - (i * 7)); // Some of these sums overflow an int8_t
+    }
+    ROCC_INSTRUCTION_S(0, MT8, 0x43); // Elements are 1 byte wide
+    ROCC_INSTRUCTION_S(0, NUM_ELEMENTS, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_S(0, &c, 0x41); // Send destination address
+    ROCC_INSTRUCTION_DSS(0, status, &a, &b, 1); // Wait for result
+    ROCC_INSTRUCTION_S(0, MT64, 0x43); // Go back to 64-bit elements
+
+    int arrays_equal = 1;
+    if (status == 0) {
+        for(int i = 0; i < NUM_ELEMENTS; i++) {
+            if(c[i] != (int8_t)(a[i] + b[i])) {
+                arrays_equal = 0;
+                return i+1;
+            }
+        }
+    }
+    else { return 10; }
+
+    return ((status == 0) && arrays_equal) ? 0 : 4;
+}
@@ -0,0 +1,24 @@
+#include <rocc.h>
+#include <stdint.h>
+
+int main() {
+    int64_t status;
+    double rocc_computed;
+    double a[8] = { 0.5, 1.5, 2.0, 4.25, 8.0, 16.5, 32.0, 64.75 };
+    ROCC_INSTRUCTION_S(0, 8, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_S(0, &rocc_computed, 0x41); // Send destination address
+    ROCC_INSTRUCTION_DS(0, status, &a, 0x5b); // Wait for result
+
+    /* The accelerator sums in a tree, not left to right. These values are
+     * chosen so every partial sum is exact and the order does not matter. */
+    double expected = 0;
+    for(int i = 0; i < 8; i++){
+        expected += a[i];
+    }
+
+    if (status == 0) {
+        return (expected == rocc_computed) ? 0 : 1;
+    } else {
+        return 2;
+    }
+}
@@ -0,0 +1,25 @@
+#include <rocc.h>
+#include <stdint.h>
+
+int main() {
+    int64_t status;
+    double c[6];
+    double a[6] = { 1.0, 0.5, 0.25, 2.0, -3.75, 10.0 };
+    ROCC_INSTRUCTION_S(0, 6, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_S(0, &c, 0x41); // Send destination address
+    ROCC_INSTRUCTION_DS(0, status, &a, 0x5d); // Wait for result
+
+    // Exclusive scan, like the integer scans.
+    double expected = 0;
+    if (status == 0) {
+        for(int i = 0; i < 6; i++) {
+            if(c[i] != expected) {
+                return i+1;
+            }
+            expected += a[i];
+        }
+    }
+    else { return 10; }
+
+    return 0;
+}
@@ -0,0 +1,30 @@
+#include <rocc.h>
+#include <stdint.h>
+
+/* Packed booleans hold 64 flags per word. 130 flags need 3 words. */
+#define CEIL(x, y) ((((x) + (y)) - 1) / (y))
+
+#define NUM_FLAGS 130
+#define NUM_WORDS CEIL(NUM_FLAGS, 64)
+
+int main() {
+    int64_t c[NUM_WORDS],status;
+    int64_t a[NUM_WORDS] = { 0xF0F0F0F0F0F0F0F0, 0x123456789ABCDEF0, 0x3 };
+    int64_t b[NUM_WORDS] = { 0xFF00FF00FF00FF00, 0x0FEDCBA987654321, 0x1 };
+    ROCC_INSTRUCTION_S(0, NUM_FLAGS, 0x40);  // Send "length" of vector, in flags
+    ROCC_INSTRUCTION_S(0, &c, 0x41); // Send destination address
+    ROCC_INSTRUCTION_DSS(0, status, &a, &b, 0x2F); // Wait for result
+
+    int arrays_equal = 1;
+    if (status == 0) {
+        for(int i = 0; i < NUM_WORDS; i++) {
+            if(c[i] != (a[i] & b[i])) {
+                arrays_equal = 0;
+                return i+1;
+            }
+        }
+    }
+    else { return 10; }
+
+    return ((status == 0) && arrays_equal) ? 0 : 4;
+}
@@ -0,0 +1,30 @@
+#include <rocc.h>
+#include <stdint.h>
+
+int main() {
+    int64_t c[4],status;
+    int64_t a[4] = {-1024, 0x7200, -3, 0x8000000000000000};
+    int64_t b[4] = {3, 4, 1, 63};
+    ROCC_INSTRUCTION_S(0, 4, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_S(0, &c, 0x41); // Send destination address
+    // DSS used to block the main core.
+    ROCC_INSTRUCTION_DSS(0, status, &a, &b, 0x3A); // Wait for result
+    // Host-side arithmetic right shift. GCC shifts signed values arithmetically.
+    int64_t expected[4];
+    for(int i = 0; i < 4; i++) {
+        expected[i] = a[i] >> b[i];
+    }
+
+    int arrays_equal = 1;
+    if (status == 0) {
+        for(int i = 0; i < 4; i++) {
+            if(c[i] != expected[i]) {
+                arrays_equal = 0;
+                return i+1;
+            }
+        }
+    }
+    else { return 10; }
+
+    return ((status == 0) && arrays_equal) ? 0 : 4;
+}
@@ -0,0 +1,22 @@
+#include <rocc.h>
+#include <stdint.h>
+
+int main() {
+    int64_t c[4],status;
+    uint64_t a[4] = {0, 1, 0x8000000000000000, 0x00f0000000000000};
+    int64_t expected[4] = {64, 63, 0, 8};
+    ROCC_INSTRUCTION_S(0, 4, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_S(0, &c, 0x41); // Send destination address
+    ROCC_INSTRUCTION_DS(0, status, &a, 0x3d); // Wait for result
+
+    if (status == 0) {
+        for(int i = 0; i < 4; i++) {
+            if(c[i] != expected[i]) {
+                return i+1;
+            }
+        }
+    }
+    else { return 10; }
+
+    return 0;
+}
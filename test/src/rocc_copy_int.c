@@ -0,0 +1,28 @@
+#include <rocc.h>
+#include <stdint.h>
+
+#define NUM_ELEMENTS 13
+
+int main() {
+    int64_t dest[NUM_ELEMENTS],status;
+    int64_t src[NUM_ELEMENTS];
+    for(int i = 0; i < NUM_ELEMENTS; i++) {
+        src[i] = 0x1000 + (i * 0x11);
+    }
+    ROCC_INSTRUCTION_S(0, NUM_ELEMENTS, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_S(0, &dest, 0x41); // Send destination address
+    ROCC_INSTRUCTION_DS(0, status, &src, 0x26); // Wait for result
+
+    int arrays_equal = 1;
+    if (status == 0) {
+        for(int i = 0; i < NUM_ELEMENTS; i++) {
+            if(dest[i] != src[i]) {
+                arrays_equal = 0;
+                return i+1;
+            }
+        }
+    }
+    else { return 10; }
+
+    return ((status == 0) && arrays_equal) ? 0 : 4;
+}
@@ -0,0 +1,36 @@
+#include <rocc.h>
+#include <stdint.h>
+
+/* Gather every STRIDE-th element of src, starting at src[1], into a contiguous
+ * destination vector. This is how a column of a row-major matrix is copied. */
+#define NUM_ELEMENTS 9
+#define STRIDE 3
+
+int main() {
+    int64_t dest[NUM_ELEMENTS],status;
+    int64_t src[NUM_ELEMENTS * STRIDE];
+    for(int i = 0; i < NUM_ELEMENTS * STRIDE; i++) {
+        src[i] = 0x2000 + i;
+    }
+    ROCC_INSTRUCTION_S(0, NUM_ELEMENTS, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_S(0, &dest, 0x41); // Send destination address
+    ROCC_INSTRUCTION_DSS(0, status, &src[1], STRIDE, 0x27); // Wait for result
+
+    int64_t expected[NUM_ELEMENTS];
+    for(int i = 0; i < NUM_ELEMENTS; i++) {
+        expected[i] = src[1 + (i * STRIDE)];
+    }
+
+    int arrays_equal = 1;
+    if (status == 0) {
+        for(int i = 0; i < NUM_ELEMENTS; i++) {
+            if(dest[i] != expected[i]) {
+                arrays_equal = 0;
+                return i+1;
+            }
+        }
+    }
+    else { return 10; }
+
+    return ((status == 0) && arrays_equal) ? 0 : 4;
+}
@@ -0,0 +1,42 @@
+#include <rocc.h>
+#include <stdint.h>
+#include "counters.h"
+
+int main() {
+    int64_t c[3],status;
+    int64_t a[3] = {1, 0xcd9c, 4};
+    int64_t b[3] = {2, 0x1111, 4};
+
+    reset_counters();
+    ROCC_INSTRUCTION_S(0, 3, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_S(0, &c, 0x41); // Send destination address
+    ROCC_INSTRUCTION_DSS(0, status, &a, &b, 1); // c = a + b
+    if (status != 0) { return 10; }
+
+    for(int i = 0; i < 3; i++) {
+        if(c[i] != a[i] + b[i]) { return i+1; }
+    }
+
+    // 3 loads from each of a & b, then 3 stores to c, every one answered.
+    uint64_t reqs = read_counter(COUNTER_MAIN_REQS);
+    if (reqs < 9) { return 20; }
+    if (read_counter(COUNTER_MAIN_RESPS) != reqs) { return 30; }
+    if (read_counter(COUNTER_ALU_BATCHES) == 0) { return 40; }
+    if (read_counter(COUNTER_CYCLES_EXE) == 0) { return 50; }
+    // Nothing ran on the float unit or the permute lane.
+    if (read_counter(COUNTER_FPU_BATCHES) != 0) { return 60; }
+    if (read_counter(COUNTER_PERM_REQS) != 0) { return 70; }
+    // Only the 6 loads land in the latency histogram, not the stores.
+    uint64_t loads = 0;
+    for(int k = 0; k < LATENCY_BUCKETS; k++) {
+        loads += read_counter(COUNTER_LATENCY_HISTOGRAM + k);
+    }
+    if (loads != 6) { return 71; }
+    if (read_counter(COUNTER_LATENCY_TOTAL) < loads) { return 72; }
+    if (read_counter(COUNTER_OCCUPANCY_TOTAL) == 0) { return 73; }
+    // Counters that do not exist read as 0.
+    if (read_counter(NUM_COUNTERS) != 0) { return 80; }
+
+    reset_counters();
+    return read_counter(COUNTER_ALU_BATCHES) == 0 ? 0 : 90;
+}
@@ -0,0 +1,26 @@
+#include <rocc.h>
+#include <stdint.h>
+
+#define NUM_ELEMENTS 7
+
+int main() {
+    int64_t c[NUM_ELEMENTS],status;
+    int64_t value = 0xdead;
+    ROCC_INSTRUCTION_S(0, NUM_ELEMENTS, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_S(0, &c, 0x41); // Send destination address
+    // Nothing is read from memory. The value is passed by value.
+    ROCC_INSTRUCTION_DS(0, status, value, 0x25); // Wait for result
+
+    int arrays_equal = 1;
+    if (status == 0) {
+        for(int i = 0; i < NUM_ELEMENTS; i++) {
+            if(c[i] != value) {
+                arrays_equal = 0;
+                return i+1;
+            }
+        }
+    }
+    else { return 10; }
+
+    return ((status == 0) && arrays_equal) ? 0 : 4;
+}
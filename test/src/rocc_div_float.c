@@ -0,0 +1,24 @@
+#include <rocc.h>
+#include <stdint.h>
+
+int main() {
+    int64_t status;
+    double c[4];
+    double a[4] = {1.0, 9.0, -7.5, 1.0};
+    double b[4] = {4.0, 3.0, 2.5, 3.0};
+    ROCC_INSTRUCTION_S(0, 4, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_S(0, &c, 0x41); // Send destination address
+    ROCC_INSTRUCTION_DSS(0, status, &a, &b, 0x53); // Wait for result
+
+    // IEEE 754 division is correctly rounded, so host and accelerator agree.
+    if (status == 0) {
+        for(int i = 0; i < 4; i++) {
+            if(c[i] != a[i] / b[i]) {
+                return i+1;
+            }
+        }
+    }
+    else { return 10; }
+
+    return 0;
+}
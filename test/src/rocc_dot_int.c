@@ -0,0 +1,22 @@
+#include <rocc.h>
+#include <stdint.h>
+
+int main() {
+    int64_t rocc_computed,status;
+    int64_t a[10] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, -10 };
+    int64_t b[10] = { 10, 9, 8, 7, 6, 5, 4, 3, 2, 1 };
+    ROCC_INSTRUCTION_S(0, 10, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_S(0, &rocc_computed, 0x41); // Send destination address
+    ROCC_INSTRUCTION_DSS(0, status, &a, &b, 0x3b); // Wait for result
+
+    int64_t expected = 0;
+    for(int i = 0; i < 10; i++){
+        expected += a[i] * b[i];
+    }
+
+    if (status == 0) {
+        return (expected == rocc_computed) ? 0 : 1;
+    } else {
+        return 2;
+    }
+}
@@ -0,0 +1,20 @@
+#include <rocc.h>
+#include <stdint.h>
+
+int main() {
+    int64_t value,status;
+    int64_t a[5] = {10, 20, 30, 40, 50};
+
+    ROCC_INSTRUCTION_DSS(0, value, &a, 3, 0x67); // Extract a[3]
+    if (value != a[3]) { return 1; }
+
+    ROCC_INSTRUCTION_S(0, &a, 0x41); // Send destination address
+    ROCC_INSTRUCTION_DSS(0, status, -7, 2, 0x68); // a[2] = -7
+    if (status != 0) { return 10; }
+
+    // The extract must see the replace's store.
+    ROCC_INSTRUCTION_DSS(0, value, &a, 2, 0x67);
+    if (value != -7) { return 2; }
+
+    return (a[2] == -7 && a[1] == 20 && a[3] == 40) ? 0 : 4;
+}
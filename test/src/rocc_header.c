@@ -0,0 +1,51 @@
+#include <rocc.h>
+#include <stdint.h>
+
+/* In header mode, vectors carry their length in a header word in front of
+ * their elements. The accelerator reads the length from the first source's
+ * header and writes the output's length into the destination's header, so
+ * the host never sends SET_NUM_OPERANDS. */
+
+#define NUM_ELEMENTS 13
+
+struct vector {
+    int64_t length;
+    int64_t data[NUM_ELEMENTS];
+};
+
+struct vector a, b, sum;
+
+int main() {
+    int64_t status, total;
+    a.length = NUM_ELEMENTS; b.length = NUM_ELEMENTS;
+    sum.length = -1;
+    for(int i = 0; i < NUM_ELEMENTS; i++) {
+        a.data[i] = i;
+        b.data[i] = 2 * i + 1;
+    }
+
+    ROCC_INSTRUCTION_S(0, 0, 0x40);  // Must not be used
+    ROCC_INSTRUCTION_S(0, 1, 0x49);  // Header mode on
+    ROCC_INSTRUCTION_S(0, &sum, 0x41); // Send destination address
+    ROCC_INSTRUCTION_DSS(0, status, &a, &b, 1); // PLUS_INT
+    if (status != 0) { return 10; }
+    if (sum.length != NUM_ELEMENTS) { return 20; }
+    for(int i = 0; i < NUM_ELEMENTS; i++) {
+        if (sum.data[i] != a.data[i] + b.data[i]) {
+            return i+1;
+        }
+    }
+
+    // A reduction writes a scalar, which has no header.
+    ROCC_INSTRUCTION_S(0, &total, 0x41);
+    ROCC_INSTRUCTION_DS(0, status, &sum, 0x02); // PLUS_REDUCE_INT
+    if (status != 0) { return 10; }
+    int64_t expected = 0;
+    for(int i = 0; i < NUM_ELEMENTS; i++) {
+        expected += sum.data[i];
+    }
+    if (total != expected) { return 30; }
+
+    ROCC_INSTRUCTION_S(0, 0, 0x49);  // Header mode off
+    return 0;
+}
@@ -0,0 +1,33 @@
+#include <rocc.h>
+#include <stdint.h>
+
+#define NUM_ELEMENTS 11
+
+int main() {
+    int64_t c[NUM_ELEMENTS],status;
+    int64_t start = -5;
+    int64_t stride = 3;
+    ROCC_INSTRUCTION_S(0, NUM_ELEMENTS, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_S(0, &c, 0x41); // Send destination address
+    // Nothing is read from memory. Start and stride are passed by value.
+    ROCC_INSTRUCTION_DSS(0, status, start, stride, 0x24); // Wait for result
+
+    // Host-side index: start + i * stride
+    int64_t expected[NUM_ELEMENTS];
+    for(int i = 0; i < NUM_ELEMENTS; i++) {
+        expected[i] = start + i * stride;
+    }
+
+    int arrays_equal = 1;
+    if (status == 0) {
+        for(int i = 0; i < NUM_ELEMENTS; i++) {
+            if(c[i] != expected[i]) {
+                arrays_equal = 0;
+                return i+1;
+            }
+        }
+    }
+    else { return 10; }
+
+    return ((status == 0) && arrays_equal) ? 0 : 4;
+}
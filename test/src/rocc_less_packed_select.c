@@ -0,0 +1,54 @@
+#include <rocc.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+/* Compare two vectors with a packed-result comparison, then feed the packed
+ * flags straight into SELECT without unpacking them on the host.
+ * dest[i] = (a[i] < b[i]) ? a[i] : b[i], i.e. an element-wise minimum. */
+
+#define CEIL(x, y) ((((x) + (y)) - 1) / (y))
+
+#define NUM_ELEMENTS 150
+#define FLAG_WIDTH 64
+#define NUM_FLAGS CEIL(NUM_ELEMENTS, FLAG_WIDTH)
+
+int main() {
+    int64_t dest[NUM_ELEMENTS],status;
+    int64_t a[NUM_ELEMENTS], b[NUM_ELEMENTS];
+    int64_t flags[NUM_FLAGS];
+    for(int i = 0; i < NUM_ELEMENTS; i++) {
+        a[i] = (i * 37) % 101;
+        b[i] = (i * 53) % 97;
+    }
+
+    ROCC_INSTRUCTION_S(0, NUM_ELEMENTS, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_S(0, flags, 0x41); // Send destination address
+    ROCC_INSTRUCTION_DSS(0, status, a, b, 0x28); // LESS_PACKED_INT
+    if (status != 0) { return 10; }
+
+    for(int j = 0; j < NUM_FLAGS; j++) {
+        for(int i = FLAG_WIDTH * j; i < FLAG_WIDTH * (j+1) && i < NUM_ELEMENTS; i++) {
+            uint64_t bit = ((uint64_t)flags[j] >> (i % FLAG_WIDTH)) & 0x1;
+            if (bit != (a[i] < b[i])) {
+                printf("FAIL: flag %d is %" PRIu64 "\n", i, bit);
+                return 20;
+            }
+        }
+    }
+
+    ROCC_INSTRUCTION_S(0, NUM_ELEMENTS, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_S(0, dest, 0x41); // Send destination address
+    ROCC_INSTRUCTION_S(0, flags, 0x42); // Send flags
+    ROCC_INSTRUCTION_DSS(0, status, a, b, 0x16); // SELECT_INT
+    if (status != 0) { return 30; }
+
+    for(int i = 0; i < NUM_ELEMENTS; i++) {
+        int64_t expected = (a[i] < b[i]) ? a[i] : b[i];
+        if(dest[i] != expected) {
+            return 40;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include <rocc.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "encoding.h"
+
+/* A packed-result comparison on an accelerator with batches wider than a word
+ * of flags. Each batch writes several flag words, and the vector ends part
+ * way through a batch. Prints the cycles spent per element. */
+
+// Must match the batchSize the accelerator was built with.
+#ifndef BATCH_SIZE
+#define BATCH_SIZE 256
+#endif
+
+#define CEIL(x, y) ((((x) + (y)) - 1) / (y))
+
+#define NUM_ELEMENTS (2 * BATCH_SIZE + 100)
+#define FLAG_WIDTH 64
+#define NUM_FLAGS CEIL(NUM_ELEMENTS, FLAG_WIDTH)
+
+int64_t a[NUM_ELEMENTS], b[NUM_ELEMENTS];
+// One word past the end, to catch writes past the last flag word.
+uint64_t flags[NUM_FLAGS + 1];
+
+int main() {
+    int64_t status;
+    for(int i = 0; i < NUM_ELEMENTS; i++) {
+        a[i] = (i * 37) % 101;
+        b[i] = (i * 53) % 97;
+    }
+    flags[NUM_FLAGS] = 0xdeadbeef;
+
+    unsigned long cycles = -rdcycle();
+    ROCC_INSTRUCTION_S(0, NUM_ELEMENTS, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_S(0, flags, 0x41); // Send destination address
+    ROCC_INSTRUCTION_DSS(0, status, a, b, 0x28); // LESS_PACKED_INT
+    cycles += rdcycle();
+    if (status != 0) { return 10; }
+
+    printf("LESS_PACKED: %lu cycles, %lu.%02lu cycles per element\n", cycles,
+           cycles / NUM_ELEMENTS, (cycles * 100 / NUM_ELEMENTS) % 100);
+
+    for(int i = 0; i < NUM_ELEMENTS; i++) {
+        uint64_t bit = (flags[i / FLAG_WIDTH] >> (i % FLAG_WIDTH)) & 0x1;
+        if (bit != (a[i] < b[i])) {
+            return i+1;
+        }
+    }
+    if (flags[NUM_FLAGS] != 0xdeadbeef) { return 20; }
+
+    return 0;
+}
@@ -0,0 +1,30 @@
+#include <rocc.h>
+#include <stdint.h>
+
+int main() {
+    int64_t c[5],status;
+    int64_t a[5] = {-1, 0xdc32, -400, 7, -8};
+    int64_t b[5] = {3, -0x2cf1, -2, 7, -9};
+    ROCC_INSTRUCTION_S(0, 5, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_S(0, &c, 0x41); // Send destination address
+    // DSS used to block the main core.
+    ROCC_INSTRUCTION_DSS(0, status, &a, &b, 0x32); // Wait for result
+    // Host-side signed less: (a < b)
+    int64_t expected[5];
+    for(int i = 0; i < 5; i++) {
+        expected[i] = (a[i] < b[i]) ? 1 : 0;
+    }
+
+    int arrays_equal = 1;
+    if (status == 0) {
+        for(int i = 0; i < 5; i++) {
+            if(c[i] != expected[i]) {
+                arrays_equal = 0;
+                return i+1;
+            }
+        }
+    }
+    else { return 10; }
+
+    return ((status == 0) && arrays_equal) ? 0 : 4;
+}
@@ -0,0 +1,76 @@
+#include <rocc.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "encoding.h"
+
+/* Largest number of elements to sort. Throughput is compared against qsort
+ * at 1K elements, then at every 4x larger size up to this one, so building
+ * with -DNUM_ELEMENTS=1048576 compares 1K to 1M elements. It must be a power
+ * of 2 and at least BATCH_SIZE. */
+#ifndef NUM_ELEMENTS
+#define NUM_ELEMENTS 1024
+#endif
+// Must match the batchSize the accelerator was built with.
+#ifndef BATCH_SIZE
+#define BATCH_SIZE 2
+#endif
+
+int64_t keys[NUM_ELEMENTS], host[NUM_ELEMENTS], tmp[NUM_ELEMENTS];
+
+static int compare(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Sort n random keys with qsort and with the accelerator, and check they
+ * agree. Returns 0 on success, like main. */
+static int sort(int n) {
+    int64_t status;
+    uint64_t seed = 0x2545f4914f6cdd1d;
+    for(int i = 0; i < n; i++) {
+        seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+        keys[i] = host[i] = (int64_t)seed;
+    }
+
+    unsigned long host_cycles = -rdcycle();
+    qsort(host, n, sizeof(int64_t), compare);
+    host_cycles += rdcycle();
+
+    unsigned long rocc_cycles = -rdcycle();
+    int64_t *src = keys, *dst = tmp;
+    ROCC_INSTRUCTION_S(0, n, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_S(0, src, 0x41); // Sort the runs in place
+    ROCC_INSTRUCTION_DS(0, status, src, 0x64);
+    if (status != 0) { return 10; }
+    // Merge pairs of runs, doubling the run length each pass.
+    for(int run = BATCH_SIZE; run < n; run *= 2) {
+        ROCC_INSTRUCTION_S(0, run, 0x40);
+        for(int i = 0; i < n; i += 2 * run) {
+            ROCC_INSTRUCTION_S(0, &dst[i], 0x41);
+            ROCC_INSTRUCTION_DSS(0, status, &src[i], &src[i + run], 0x65);
+            if (status != 0) { return 10; }
+        }
+        int64_t *swap = src; src = dst; dst = swap;
+    }
+    rocc_cycles += rdcycle();
+
+    printf("%8d elements: qsort %lu cycles, accelerator %lu cycles, %lu.%02lux faster\n",
+           n, host_cycles, rocc_cycles, host_cycles / rocc_cycles,
+           host_cycles * 100 / rocc_cycles % 100);
+
+    for(int i = 0; i < n; i++) {
+        if(src[i] != host[i]) {
+            return i+1;
+        }
+    }
+    return 0;
+}
+
+int main() {
+    int n = NUM_ELEMENTS < 1024 ? NUM_ELEMENTS : 1024;
+    for(;; n *= 4) {
+        int ret = sort(n > NUM_ELEMENTS ? NUM_ELEMENTS : n);
+        if (ret != 0 || n >= NUM_ELEMENTS) { return ret; }
+    }
+}
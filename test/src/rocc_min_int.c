@@ -0,0 +1,30 @@
+#include <rocc.h>
+#include <stdint.h>
+
+int main() {
+    int64_t c[6],status;
+    int64_t a[6] = {-1, 0xdc32, -400, 7, -8, 0x7FFFFFFFFFFFFFFF};
+    int64_t b[6] = {3, -0x2cf1, -2, 7, -9, 0};
+    ROCC_INSTRUCTION_S(0, 6, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_S(0, &c, 0x41); // Send destination address
+    // DSS used to block the main core.
+    ROCC_INSTRUCTION_DSS(0, status, &a, &b, 0x36); // Wait for result
+    // Host-side signed min
+    int64_t expected[6];
+    for(int i = 0; i < 6; i++) {
+        expected[i] = (a[i] < b[i]) ? a[i] : b[i];
+    }
+
+    int arrays_equal = 1;
+    if (status == 0) {
+        for(int i = 0; i < 6; i++) {
+            if(c[i] != expected[i]) {
+                arrays_equal = 0;
+                return i+1;
+            }
+        }
+    }
+    else { return 10; }
+
+    return ((status == 0) && arrays_equal) ? 0 : 4;
+}
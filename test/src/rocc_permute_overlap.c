@@ -0,0 +1,46 @@
+#include <rocc.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define NUM_ELEMENTS 10
+
+/* A PERMUTE runs on its own lane, so an independent ADD issued right after it
+ * can run at the same time. A second ADD reads the permuted vector, so it must
+ * wait for the PERMUTE to finish. */
+int main() {
+    int64_t permuted[NUM_ELEMENTS], sum[NUM_ELEMENTS], dependent[NUM_ELEMENTS];
+    int64_t status1, status2, status3;
+    int64_t data[NUM_ELEMENTS]    = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    int64_t indices[NUM_ELEMENTS] = {6, 9, 4, 0, 3, 5, 2, 1, 7, 8};
+    int64_t ones[NUM_ELEMENTS]    = {1, 1, 1, 1, 1, 1, 1, 1, 1, 1};
+
+    ROCC_INSTRUCTION_S(0, NUM_ELEMENTS, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_S(0, &permuted, 0x41); // Send destination address
+    ROCC_INSTRUCTION_DSS(0, status1, &data, &indices, 35); // PERMUTE
+    ROCC_INSTRUCTION_S(0, &sum, 0x41);
+    ROCC_INSTRUCTION_DSS(0, status2, &data, &ones, 1); // Independent ADD
+    ROCC_INSTRUCTION_S(0, &dependent, 0x41);
+    ROCC_INSTRUCTION_DSS(0, status3, &permuted, &ones, 1); // Dependent ADD
+
+    int64_t expected[NUM_ELEMENTS];
+    for(int i = 0; i < NUM_ELEMENTS; i++) {
+        expected[indices[i]] = data[i];
+    }
+
+    for(int i = 0; i < NUM_ELEMENTS; i++) {
+        printf("i = %d, permuted = %x, sum = %x, dependent = %x\n",
+               i, permuted[i], sum[i], dependent[i]);
+    }
+
+    if (status1 == 0 && status2 == 0 && status3 == 0) {
+        for(int i = 0; i < NUM_ELEMENTS; i++) {
+            if(permuted[i] != expected[i] || sum[i] != data[i] + 1 ||
+               dependent[i] != expected[i] + 1) {
+                return i+1;
+            }
+        }
+    }
+    else { return 10; }
+
+    return 0;
+}
@@ -0,0 +1,56 @@
+#include <rocc.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* rocc_permute_overlap.c in header mode. Vector lengths are only known once
+ * their headers are read, so the accelerator must assume every vector runs to
+ * the top of memory, and the ADD reading the permuted vector must still wait
+ * for the PERMUTE to finish. */
+
+#define NUM_ELEMENTS 10
+
+struct vector {
+    int64_t length;
+    int64_t data[NUM_ELEMENTS];
+};
+
+struct vector data, indices, ones, permuted, dependent;
+
+int main() {
+    int64_t status1, status2;
+    data.length = NUM_ELEMENTS; indices.length = NUM_ELEMENTS; ones.length = NUM_ELEMENTS;
+    permuted.length = -1; dependent.length = -1;
+    int64_t order[NUM_ELEMENTS] = {6, 9, 4, 0, 3, 5, 2, 1, 7, 8};
+    for(int i = 0; i < NUM_ELEMENTS; i++) {
+        data.data[i] = i;
+        indices.data[i] = order[i];
+        ones.data[i] = 1;
+    }
+
+    ROCC_INSTRUCTION_S(0, 1, 0x49);  // Header mode on
+    ROCC_INSTRUCTION_S(0, &permuted, 0x41); // Send destination address
+    ROCC_INSTRUCTION_DSS(0, status1, &data, &indices, 35); // PERMUTE
+    ROCC_INSTRUCTION_S(0, &dependent, 0x41);
+    ROCC_INSTRUCTION_DSS(0, status2, &permuted, &ones, 1); // Dependent ADD
+    ROCC_INSTRUCTION_S(0, 0, 0x49);  // Header mode off
+
+    int64_t expected[NUM_ELEMENTS];
+    for(int i = 0; i < NUM_ELEMENTS; i++) {
+        expected[order[i]] = data.data[i];
+    }
+
+    for(int i = 0; i < NUM_ELEMENTS; i++) {
+        printf("i = %d, permuted = %x, dependent = %x\n",
+               i, permuted.data[i], dependent.data[i]);
+    }
+
+    if (status1 != 0 || status2 != 0) { return 10; }
+    if (permuted.length != NUM_ELEMENTS || dependent.length != NUM_ELEMENTS) { return 20; }
+    for(int i = 0; i < NUM_ELEMENTS; i++) {
+        if(permuted.data[i] != expected[i] || dependent.data[i] != expected[i] + 1) {
+            return i+1;
+        }
+    }
+
+    return 0;
+}
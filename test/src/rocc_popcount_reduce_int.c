@@ -0,0 +1,27 @@
+#include <rocc.h>
+#include <stdint.h>
+
+/* POPCOUNT_RED_INT counts the true flags of a packed boolean vector. The
+ * vector ends part way through its last word, and the bits past its end are
+ * set, so they would be counted if they were not masked off. */
+
+#define NUM_FLAGS (9 * 64 + 13)
+
+int main() {
+    int64_t rocc_computed,status;
+    uint64_t a[10] = { 1, 3, 7, 15, 0, 0xffffffffffffffff, 0x5555, 2, 4, 0xffffffffffffffff };
+    ROCC_INSTRUCTION_S(0, NUM_FLAGS, 0x40);  // Send "length" of vector, in flags
+    ROCC_INSTRUCTION_S(0, &rocc_computed, 0x41); // Send destination address
+    ROCC_INSTRUCTION_DS(0, status, &a, 0x61); // Wait for result
+
+    int64_t expected = 0;
+    for(int i = 0; i < NUM_FLAGS; i++){
+        expected += (a[i / 64] >> (i % 64)) & 1;
+    }
+
+    if (status == 0) {
+        return (expected == rocc_computed) ? 0 : 1;
+    } else {
+        return 2;
+    }
+}
@@ -0,0 +1,35 @@
+#include <rocc.h>
+#include <stdint.h>
+
+#define NUM_ELEMENTS 16
+// Signed keys are sorted by 16 passes over every 4-bit digit.
+#define DIGIT_BITS 4
+#define KEY_BITS 64
+
+int main() {
+    int64_t status;
+    int64_t keys[NUM_ELEMENTS] = {0x1234, 0x00ff, 0xbeef, 0x0001, 0x1234, 0x8000,
+                                  0x0f0f, 0x0010, 0xffff, 0x0000, 0x4321, 0x00fe,
+                                  -1, -0x1234, INT64_MIN, INT64_MAX};
+    int64_t tmp[NUM_ELEMENTS];
+    int64_t *src = keys, *dst = tmp;
+
+    ROCC_INSTRUCTION_S(0, NUM_ELEMENTS, 0x40);  // Send "length" of vector
+    for(int shift = 0; shift < KEY_BITS; shift += DIGIT_BITS) {
+        ROCC_INSTRUCTION_DSS(0, status, src, shift, 0x62); // Count digits
+        if (status != 0) { return 10; }
+        ROCC_INSTRUCTION_S(0, dst, 0x41); // Send destination address
+        ROCC_INSTRUCTION_DSS(0, status, src, shift, 0x63); // Scatter by digit
+        if (status != 0) { return 10; }
+        int64_t *swap = src; src = dst; dst = swap;
+    }
+
+    // An even number of passes leaves the sorted keys back in keys.
+    for(int i = 1; i < NUM_ELEMENTS; i++) {
+        if(src[i-1] > src[i]) {
+            return i;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,34 @@
+#include <rocc.h>
+#include <stdint.h>
+
+#define NUM_ELEMENTS 16
+#define BOUND 100
+
+int main() {
+    int64_t status;
+    int64_t first[NUM_ELEMENTS], again[NUM_ELEMENTS], next[NUM_ELEMENTS];
+
+    ROCC_INSTRUCTION_S(0, NUM_ELEMENTS, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_S(0, &first, 0x41); // Send destination address
+    ROCC_INSTRUCTION_DSS(0, status, 42, BOUND, 0x66); // Seed with 42
+    if (status != 0) { return 10; }
+    ROCC_INSTRUCTION_S(0, &next, 0x41);
+    ROCC_INSTRUCTION_DSS(0, status, 0, BOUND, 0x66); // Continue the sequences
+    if (status != 0) { return 10; }
+    ROCC_INSTRUCTION_S(0, &again, 0x41);
+    ROCC_INSTRUCTION_DSS(0, status, 42, BOUND, 0x66); // Restart with 42
+    if (status != 0) { return 10; }
+
+    int all_equal = 1, same_as_next = 1, reproduced = 1;
+    for(int i = 0; i < NUM_ELEMENTS; i++) {
+        if(first[i] < 0 || first[i] >= BOUND) {
+            return i+1;
+        }
+        // Re-seeding must reproduce the same vector.
+        reproduced &= (again[i] == first[i]);
+        all_equal &= (first[i] == first[0]);
+        same_as_next &= (first[i] == next[i]);
+    }
+
+    return (reproduced && !all_equal && !same_as_next) ? 0 : 4;
+}
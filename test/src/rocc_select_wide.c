@@ -0,0 +1,56 @@
+#include <rocc.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "encoding.h"
+
+/* SELECT on an accelerator with batches wider than a word of flags. Each batch
+ * reads several flag words, and the vector ends part way through a batch and
+ * part way through a flag word. Prints the cycles spent per element. */
+
+// Must match the batchSize the accelerator was built with.
+#ifndef BATCH_SIZE
+#define BATCH_SIZE 128
+#endif
+
+#define CEIL(x, y) ((((x) + (y)) - 1) / (y))
+
+#define NUM_ELEMENTS (3 * BATCH_SIZE + 37)
+#define FLAG_WIDTH 64
+#define NUM_FLAGS CEIL(NUM_ELEMENTS, FLAG_WIDTH)
+
+int64_t dest[NUM_ELEMENTS], a[NUM_ELEMENTS], b[NUM_ELEMENTS];
+uint64_t flags[NUM_FLAGS];
+
+int main() {
+    int64_t status;
+    for(int i = 0; i < NUM_FLAGS; i++) {
+        flags[i] = 0;
+    }
+    for(int i = 0; i < NUM_ELEMENTS; i++) {
+        a[i] = i;
+        b[i] = -i;
+        if ((i * 7) % 3 == 0) {
+            flags[i / FLAG_WIDTH] |= (uint64_t)1 << (i % FLAG_WIDTH);
+        }
+    }
+
+    unsigned long cycles = -rdcycle();
+    ROCC_INSTRUCTION_S(0, NUM_ELEMENTS, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_S(0, dest, 0x41); // Send destination address
+    ROCC_INSTRUCTION_S(0, flags, 0x42); // Send flags
+    ROCC_INSTRUCTION_DSS(0, status, a, b, 0x16); // SELECT_INT
+    cycles += rdcycle();
+    if (status != 0) { return 10; }
+
+    printf("SELECT: %lu cycles, %lu.%02lu cycles per element\n", cycles,
+           cycles / NUM_ELEMENTS, (cycles * 100 / NUM_ELEMENTS) % 100);
+
+    for(int i = 0; i < NUM_ELEMENTS; i++) {
+        int64_t expected = ((i * 7) % 3 == 0) ? a[i] : b[i];
+        if(dest[i] != expected) {
+            return i+1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include <rocc.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "encoding.h"
+
+/* Short-vector microbenchmark. VCODE programs are full of vectors of 3 to 20
+ * elements, so the fixed cost of every instruction matters more than
+ * throughput. Times an ADD and a MUL_REDUCE at each length, and prints the
+ * cycles each instruction took. */
+
+#define MIN_ELEMENTS 3
+#define MAX_ELEMENTS 20
+#define REPEATS 8
+
+int64_t a[MAX_ELEMENTS], b[MAX_ELEMENTS], dest[MAX_ELEMENTS];
+
+int main() {
+    int64_t status, product;
+    for(int i = 0; i < MAX_ELEMENTS; i++) {
+        a[i] = i - 7;
+        b[i] = 3 * i + 1;
+    }
+
+    printf("length\tadd\tmul_reduce\n");
+    for(int n = MIN_ELEMENTS; n <= MAX_ELEMENTS; n++) {
+        unsigned long add_cycles = -rdcycle();
+        for(int r = 0; r < REPEATS; r++) {
+            ROCC_INSTRUCTION_S(0, n, 0x40);  // Send "length" of vector
+            ROCC_INSTRUCTION_S(0, dest, 0x41); // Send destination address
+            ROCC_INSTRUCTION_DSS(0, status, a, b, 1); // PLUS_INT
+        }
+        add_cycles += rdcycle();
+        if (status != 0) { return 10; }
+        for(int i = 0; i < n; i++) {
+            if (dest[i] != a[i] + b[i]) {
+                return i+1;
+            }
+        }
+
+        unsigned long mul_cycles = -rdcycle();
+        for(int r = 0; r < REPEATS; r++) {
+            ROCC_INSTRUCTION_S(0, n, 0x40);  // Send "length" of vector
+            ROCC_INSTRUCTION_S(0, &product, 0x41); // Send destination address
+            ROCC_INSTRUCTION_DS(0, status, b, 29); // MUL_REDUCE_INT
+        }
+        mul_cycles += rdcycle();
+        if (status != 0) { return 10; }
+        int64_t expected = 1;
+        for(int i = 0; i < n; i++) {
+            expected *= b[i];
+        }
+        if (product != expected) { return 20; }
+
+        printf("%d\t%lu\t%lu\n", n, add_cycles / REPEATS, mul_cycles / REPEATS);
+    }
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include <rocc.h>
+#include <stdint.h>
+
+/* Runs operations in place on a matrix column, a field of an array of
+ * structures, and a 2-D block of a matrix, instead of gathering them into
+ * temporary vectors first. */
+
+#define N 8
+#define ROWS 3
+#define COLS 5
+
+struct particle {
+    int64_t x, y, z;
+};
+
+int64_t m[N][N], out[N][N], block[ROWS][COLS];
+struct particle p[N];
+
+int main() {
+    int64_t status, sum;
+    for(int i = 0; i < N; i++) {
+        for(int j = 0; j < N; j++) {
+            m[i][j] = i * N + j;
+            out[i][j] = -1;
+        }
+        p[i].x = i; p[i].y = 10 * i; p[i].z = 100 * i;
+    }
+
+    // out[.][2] = m[.][1] + p[.].y
+    ROCC_INSTRUCTION_SS(0, 0, N, 0x46);  // rs1 vector stride: a column
+    ROCC_INSTRUCTION_SS(0, 1, sizeof(struct particle) / sizeof(int64_t), 0x46);
+    ROCC_INSTRUCTION_SS(0, 2, N, 0x46);  // Destination stride: a column
+    ROCC_INSTRUCTION_S(0, N, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_S(0, &out[0][2], 0x41); // Send destination address
+    ROCC_INSTRUCTION_DSS(0, status, &m[0][1], &p[0].y, 1); // PLUS_INT
+    if (status != 0) { return 10; }
+    for(int i = 0; i < N; i++) {
+        if (out[i][2] != m[i][1] + p[i].y) { return i+1; }
+        if (out[i][1] != -1 || out[i][3] != -1) { return 20; }
+    }
+
+    // Sum of the z fields, read in place.
+    ROCC_INSTRUCTION_SS(0, 0, sizeof(struct particle) / sizeof(int64_t), 0x46);
+    ROCC_INSTRUCTION_S(0, &sum, 0x41);
+    ROCC_INSTRUCTION_DS(0, status, &p[0].z, 0x02); // PLUS_REDUCE_INT
+    if (status != 0) { return 10; }
+    if (sum != 100 * (N * (N - 1) / 2)) { return 30; }
+
+    // block = m[2..4][1..5] + m[4..6][3..7], with unit strides along the rows.
+    for(int k = 0; k < 3; k++) {
+        ROCC_INSTRUCTION_SS(0, k, 1, 0x46);
+    }
+    ROCC_INSTRUCTION_S(0, COLS, 0x48);  // Rows of COLS elements
+    ROCC_INSTRUCTION_SS(0, 0, N, 0x47); // Both sources are rows of m
+    ROCC_INSTRUCTION_SS(0, 1, N, 0x47);
+    ROCC_INSTRUCTION_SS(0, 2, COLS, 0x47); // The destination is compact
+    ROCC_INSTRUCTION_S(0, ROWS * COLS, 0x40);
+    ROCC_INSTRUCTION_S(0, &block[0][0], 0x41);
+    ROCC_INSTRUCTION_DSS(0, status, &m[2][1], &m[4][3], 1); // PLUS_INT
+    if (status != 0) { return 10; }
+    for(int i = 0; i < ROWS; i++) {
+        for(int j = 0; j < COLS; j++) {
+            if (block[i][j] != m[2 + i][1 + j] + m[4 + i][3 + j]) {
+                return 40 + i * COLS + j;
+            }
+        }
+    }
+
+    ROCC_INSTRUCTION_S(0, 0, 0x48);  // Back to 1-D vectors
+    return 0;
+}
@@ -0,0 +1,47 @@
+#include <rocc.h>
+#include <stdint.h>
+#include "trace.h"
+
+#define TRACE_ENTRIES 64
+#define EVENT(record) (((record) >> 24) & 0xFF)
+#define EV_STATE 1
+#define EV_OP_START 4
+#define EV_OP_END 5
+
+int main() {
+    int64_t c[3],status;
+    int64_t a[3] = {1, 0xcd9c, 4};
+    int64_t b[3] = {2, 0x1111, 4};
+    uint64_t trace[TRACE_ENTRIES];
+
+    // Throw away whatever was traced before.
+    drain_trace(trace, TRACE_ENTRIES);
+
+    ROCC_INSTRUCTION_S(0, 3, 0x40);  // Send "length" of vector
+    ROCC_INSTRUCTION_S(0, &c, 0x41); // Send destination address
+    ROCC_INSTRUCTION_DSS(0, status, &a, &b, 1); // c = a + b
+    if (status != 0) { return 10; }
+    for(int i = 0; i < 3; i++) {
+        if(c[i] != a[i] + b[i]) { return i+1; }
+    }
+
+    uint64_t n = drain_trace(trace, TRACE_ENTRIES);
+    if (n == 0 || n > TRACE_ENTRIES) { return 20; }
+    print_trace(trace, n);
+
+    // The add started, moved through the control states & ended.
+    int starts = 0, states = 0, ends = 0;
+    for(uint64_t i = 0; i < n; i++) {
+        starts += EVENT(trace[i]) == EV_OP_START;
+        states += EVENT(trace[i]) == EV_STATE;
+        ends += EVENT(trace[i]) == EV_OP_END;
+    }
+    if (starts < 3 || states == 0 || ends == 0) { return 30; }
+    // Words past the records written are 0.
+    if (n < TRACE_ENTRIES && trace[n] != 0) { return 40; }
+
+    /* Draining emptied the trace. All that is left is the end of that drain,
+     * and the start of the next one & its 2 set-up instructions. */
+    n = drain_trace(trace, TRACE_ENTRIES);
+    return n <= 5 ? 0 : 50;
+}
@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+"""Print a per-instruction timeline from a VCODE accelerator trace.
+
+Reads the output of a test program that used test/include/trace.h's
+print_trace, picks out its "TRACE <hex>" lines, and decodes each 64-bit
+record. See src/main/scala/TraceBuffer.scala for the record format.
+
+    $ ./decode_trace.py sim.log
+    $ make run-binary ... | ./decode_trace.py
+"""
+
+import argparse
+import os
+import re
+import sys
+
+SRC_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                       "..", "..", "src", "main", "scala")
+
+EV_STATE, EV_FETCH_START, EV_FETCH_DONE, EV_OP_START, EV_OP_END = 1, 2, 3, 4, 5
+LANES = ("main", "permute")
+
+
+def instruction_names(src_dir):
+    """Map funct7 codes to their Chisel symbols, read from Instructions.scala."""
+    names = {}
+    try:
+        with open(os.path.join(src_dir, "Instructions.scala")) as f:
+            for m in re.finditer(r'def (\w+) = BitPat\("b([01]{7})"\)', f.read()):
+                names.setdefault(int(m.group(2), 2), m.group(1))
+    except OSError:
+        pass
+    return names
+
+
+def state_names(src_dir):
+    """The control unit's states, in order, read from Ctrl.scala."""
+    try:
+        with open(os.path.join(src_dir, "Ctrl.scala")) as f:
+            m = re.search(r"object State extends ChiselEnum \{.*?val ([\w, ]+) = Value",
+                          f.read(), re.S)
+            if m:
+                return [s.strip() for s in m.group(1).split(",")]
+    except OSError:
+        pass
+    return []
+
+
+def read_records(lines):
+    """Yield (cycle, event, arg) for every record, with the 32-bit cycle
+    counter unwrapped so it keeps counting up."""
+    last, wraps = None, 0
+    for line in lines:
+        m = re.search(r"TRACE ([0-9a-fA-F]+)", line)
+        if not m:
+            continue
+        word = int(m.group(1), 16)
+        event, arg, cycle = (word >> 24) & 0xFF, word & 0xFFFFFF, word >> 32
+        if event == 0:
+            continue
+        if last is not None and cycle < last:
+            wraps += 1
+        last = cycle
+        yield cycle + (wraps << 32), event, arg
+
+
+class Op:
+    def __init__(self, start, lane, funct):
+        self.start, self.lane, self.funct = start, lane, funct
+        self.end = None
+        self.events = []
+
+
+def build_ops(records):
+    """Group records into the instructions they belong to. Instructions on the
+    two lanes can overlap, so every lane keeps its own open instruction."""
+    ops, open_ops = [], {}
+    for cycle, event, arg in records:
+        if event == EV_OP_START:
+            lane = (arg >> 8) & 1
+            op = Op(cycle, lane, arg & 0x7F)
+            ops.append(op)
+            open_ops[lane] = op
+            continue
+        lane = (arg >> 23) & 1 if event in (EV_FETCH_START, EV_FETCH_DONE) else (arg >> 8) & 1
+        op = open_ops.get(lane)
+        if op is None:
+            # The trace started part way through an instruction.
+            op = Op(cycle, lane, None)
+            ops.append(op)
+            open_ops[lane] = op
+        op.events.append((cycle, event, arg))
+        if event == EV_OP_END:
+            op.end = cycle
+            del open_ops[lane]
+    return ops
+
+
+def describe(event, arg, states):
+    if event == EV_STATE:
+        state = arg & 0xFF
+        return "-> " + (states[state] if state < len(states) else str(state))
+    if event in (EV_FETCH_START, EV_FETCH_DONE):
+        what = "write" if (arg >> 22) & 1 else "read"
+        when = "start" if event == EV_FETCH_START else "done"
+        return "%s %s, %d elements" % (what, when, arg & 0x3FFFFF)
+    if event == EV_OP_END:
+        return "end"
+    return "event %d arg 0x%x" % (event, arg)
+
+
+def print_timeline(ops, names, states, out):
+    for n, op in enumerate(ops):
+        if op.funct is None:
+            name = "(started before the trace)"
+        else:
+            name = names.get(op.funct, "funct7 0x%02x" % op.funct)
+        if op.end is not None:
+            span = "cycles %d-%d, %d cycles" % (op.start, op.end, op.end - op.start)
+        elif op.events:
+            span = "from cycle %d, still running" % op.start
+        else:
+            span = "cycle %d" % op.start
+        out.write("op %d: %s on %s lane, %s\n" % (n, name, LANES[op.lane], span))
+
+        # Cycles spent in each state, until the next state change.
+        in_state = {}
+        current, since = None, op.start
+        for cycle, event, arg in op.events:
+            out.write("  %+6d  %s\n" % (cycle - op.start, describe(event, arg, states)))
+            if event == EV_STATE:
+                if current is not None:
+                    in_state[current] = in_state.get(current, 0) + cycle - since
+                current, since = arg & 0xFF, cycle
+        if in_state:
+            summary = ", ".join("%s %d" % (states[s] if s < len(states) else s, c)
+                                for s, c in sorted(in_state.items()))
+            out.write("  cycles in state: %s\n" % summary)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log", nargs="?", type=argparse.FileType("r"), default=sys.stdin,
+                        help="program output holding TRACE lines (default: stdin)")
+    parser.add_argument("--src", default=SRC_DIR,
+                        help="accelerator source, for instruction & state names")
+    args = parser.parse_args()
+
+    ops = build_ops(read_records(args.log))
+    print_timeline(ops, instruction_names(args.src), state_names(args.src), sys.stdout)
+
+
+if __name__ == "__main__":
+    main()